@@ -26,6 +26,15 @@ void bmp_header_init_df(bmp_header *header, const int width, const int height)
 	header->biClrImportant = 0;
 }
 
+void bmp_header_init_gray(bmp_header *header, const int width, const int height)
+{
+	bmp_header_init_df(header, width, height);
+	header->bfOffBits = 54 + BMP_PALETTE_SIZE * 4;
+	header->bfSize = header->bfOffBits + (width + BMP_GET_PADDING_8(width)) * abs(height);
+	header->biBitCount = 8;
+	header->biClrUsed = BMP_PALETTE_SIZE;
+}
+
 enum bmp_error bmp_header_write(const bmp_header *header, FILE *img_file)
 {
 	if (header == NULL) {
@@ -146,6 +155,30 @@ enum bmp_error bmp_img_write(const bmp_img *img, const char *filename)
 	// Create the padding:
 	const unsigned char padding[3] = { '\0', '\0', '\0' };
 
+	if (img->img_header.biBitCount == 8) {
+		// Grayscale palette, then one byte per pixel
+		unsigned char entry[4] = { 0 };
+		unsigned char *row = malloc(img->img_header.biWidth);
+
+		if (!row) {
+			fclose(img_file);
+			return BMP_ERROR;
+		}
+		for (int i = 0; i < BMP_PALETTE_SIZE; i++) {
+			entry[0] = entry[1] = entry[2] = (unsigned char)i;
+			fwrite(entry, sizeof(entry), 1, img_file);
+		}
+		for (size_t y = 0; y < h; y++) {
+			for (int x = 0; x < img->img_header.biWidth; x++)
+				row[x] = img->img_pixels[offset - y][x].red;
+			fwrite(row, sizeof(unsigned char), img->img_header.biWidth, img_file);
+			fwrite(padding, sizeof(unsigned char), BMP_GET_PADDING_8(img->img_header.biWidth), img_file);
+		}
+		free(row);
+		fclose(img_file);
+		return BMP_OK;
+	}
+
 	// Write the content:
 	for (size_t y = 0; y < h; y++) {
 		// Write a whole row of pixels to the file:
@@ -160,6 +193,49 @@ enum bmp_error bmp_img_write(const bmp_img *img, const char *filename)
 	return BMP_OK;
 }
 
+/**
+ * Reads the palette and the 8 bits per pixel content of an image whose header was already read,
+ * expanding every index to its palette colour.
+ */
+static enum bmp_error bmp_img_read_8(bmp_img *img, FILE *img_file)
+{
+	unsigned char palette[BMP_PALETTE_SIZE][4] = { { 0 } };
+	unsigned int colors = img->img_header.biClrUsed ? img->img_header.biClrUsed : BMP_PALETTE_SIZE;
+	const size_t h = abs(img->img_header.biHeight);
+	const size_t offset = (img->img_header.biHeight > 0 ? h - 1 : 0);
+	const size_t width = img->img_header.biWidth;
+	unsigned char *row = NULL;
+	bmp_pixel *dst;
+
+	if (colors > BMP_PALETTE_SIZE)
+		return BMP_INVALID_FILE;
+
+	// The palette follows the info header, whose size depends on its version
+	fseek(img_file, BMP_FILE_HEADER_SIZE + img->img_header.biSize, SEEK_SET);
+	if (fread(palette, 4, colors, img_file) != colors)
+		return BMP_ERROR;
+
+	row = malloc(width + BMP_GET_PADDING_8(width));
+	if (!row)
+		return BMP_ERROR;
+
+	bmp_img_alloc(img);
+	fseek(img_file, img->img_header.bfOffBits, SEEK_SET);
+
+	for (size_t y = 0; y < h; y++) {
+		if (fread(row, 1, width + BMP_GET_PADDING_8(width), img_file) != width + BMP_GET_PADDING_8(width)) {
+			free(row);
+			return BMP_ERROR;
+		}
+		dst = img->img_pixels[offset - y];
+		for (size_t x = 0; x < width; x++)
+			dst[x] = BMP_PIXEL(palette[row[x]][2], palette[row[x]][1], palette[row[x]][0]);
+	}
+
+	free(row);
+	return BMP_OK;
+}
+
 enum bmp_error bmp_img_read(bmp_img *img, const char *filename)
 {
 	FILE *img_file = fopen(filename, "rb");
@@ -177,6 +253,18 @@ enum bmp_error bmp_img_read(bmp_img *img, const char *filename)
 		return err;
 	}
 
+	if (img->img_header.biCompression != 0 || (img->img_header.biBitCount != 24 && img->img_header.biBitCount != 8)) {
+		// ERROR: Only uncompressed 24 and 8 (palettised) bits per pixel are supported
+		fclose(img_file);
+		return BMP_INVALID_FILE;
+	}
+
+	if (img->img_header.biBitCount == 8) {
+		const enum bmp_error err8 = bmp_img_read_8(img, img_file);
+		fclose(img_file);
+		return err8;
+	}
+
 	bmp_img_alloc(img);
 
 	// Select the mode (bottom-up or top-down):
@@ -187,6 +275,8 @@ enum bmp_error bmp_img_read(bmp_img *img, const char *filename)
 	// Needed to compare the return value of fread
 	const size_t items = img->img_header.biWidth;
 
+	fseek(img_file, img->img_header.bfOffBits, SEEK_SET);
+
 	// Read the content:
 	for (size_t y = 0; y < h; y++) {
 		// Read a whole row of pixels from the file:
@@ -6,6 +6,10 @@
 #define BMP_MAGIC 19778
 
 #define BMP_GET_PADDING(a) ((a) % 4)
+// row padding of an 8 bits per pixel image
+#define BMP_GET_PADDING_8(a) ((4 - (a) % 4) % 4)
+#define BMP_PALETTE_SIZE 256
+#define BMP_FILE_HEADER_SIZE 14
 
 enum bmp_error
 {
@@ -55,6 +59,10 @@ typedef struct _bmp_img
 void            bmp_header_init_df             (bmp_header*,
                                                 const int,
                                                 const int);
+// 8 bits per pixel with a grayscale palette, pixels are written as their red channel
+void            bmp_header_init_gray           (bmp_header*,
+                                                const int,
+                                                const int);
 
 enum bmp_error  bmp_header_write               (const bmp_header*,
                                                 FILE*);
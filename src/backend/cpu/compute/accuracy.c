@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "accuracy.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include "utils/filters.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Applies the 2D Gaussian kernel as two 1D passes (vertical into a double line, then horizontal) with clamped borders.
+ * The kernel is the outer product of its middle row with itself, so the sum is the same as the 2D one, at O(size) per pixel.
+ */
+static int accuracy_convolve_separable(const bmp_img *input, bmp_img *output, const struct img_dim *dim, const struct filter *gauss)
+{
+	const double *g = gauss->filter_arr[gauss->size / 2];
+	int32_t radius = gauss->size / 2;
+	int32_t width = dim->width, height = dim->height;
+	int32_t x, y, t, c, xi;
+	const unsigned char *src;
+	unsigned char *dst;
+	double *line = NULL, acc;
+
+	line = malloc((size_t)width * 3 * sizeof(double));
+	if (!line) {
+		log_error("Failed to allocate accuracy reference line.");
+		return -1;
+	}
+
+	for (y = 0; y < height; y++) {
+		memset(line, 0, (size_t)width * 3 * sizeof(double));
+		for (t = -radius; t <= radius; t++) {
+			src = (const unsigned char *)input->img_pixels[min(max(y + t, 0), height - 1)];
+			for (x = 0; x < width * 3; x++)
+				line[x] += g[t + radius] * src[x];
+		}
+
+		dst = (unsigned char *)output->img_pixels[y];
+		for (x = 0; x < width; x++) {
+			for (c = 0; c < 3; c++) {
+				acc = 0.0;
+				for (t = -radius; t <= radius; t++) {
+					xi = min(max(x + t, 0), width - 1);
+					acc += g[t + radius] * line[xi * 3 + c];
+				}
+				dst[x * 3 + c] = (unsigned char)fmin(fmax(round(acc * gauss->factor + gauss->bias), 0.0), 255.0);
+			}
+		}
+	}
+
+	free(line);
+	return 0;
+}
+
+bmp_img *accuracy_build_reference(struct img_spec *img_spec, struct p_args *args)
+{
+	struct filter *gauss = NULL;
+	bmp_img *reference = NULL;
+	double sigma = args->compute_cfg.sigma;
+
+	if (strcmp(args->compute_cfg.filter_type, "rg") != 0 && strcmp(args->compute_cfg.filter_type, "pg") != 0) {
+		log_warn("Accuracy report is only available for parametric filters, '%s' skipped.", args->compute_cfg.filter_type);
+		return NULL;
+	}
+	if (sigma > ACCURACY_MAX_SIGMA) {
+		log_warn("Accuracy report skipped: sigma %.2f is above %.1f, direct reference would be too slow.", sigma, ACCURACY_MAX_SIGMA);
+		return NULL;
+	}
+
+	gauss = filter_create_gaussian(sigma);
+	if (!gauss)
+		return NULL;
+
+	reference = malloc(sizeof(bmp_img));
+	if (!reference) {
+		log_error("Failed to allocate accuracy reference.");
+		goto cleanup;
+	}
+	bmp_img_init_df(reference, img_spec->dim->width, img_spec->dim->height);
+
+	log_info("Computing direct %dx%d Gaussian reference (sigma=%.2f)...", gauss->size, gauss->size, sigma);
+	if (accuracy_convolve_separable(img_spec->input, reference, img_spec->dim, gauss) < 0) {
+		bmp_img_free(reference);
+		free(reference);
+		reference = NULL;
+	}
+
+cleanup:
+	free_filter(gauss);
+	return reference;
+}
+
+void accuracy_report(const bmp_img *reference, const bmp_img *result, struct p_args *args)
+{
+	uint32_t width = reference->img_header.biWidth;
+	uint32_t height = abs(reference->img_header.biHeight);
+	const unsigned char *ref_row, *res_row;
+	double sq_sum = 0.0, abs_sum = 0.0, mse, psnr;
+	uint64_t cnt = (uint64_t)width * height * 3;
+	int max_err = 0, err;
+	uint32_t x, y;
+	FILE *file = NULL;
+
+	for (y = 0; y < height; y++) {
+		ref_row = (const unsigned char *)reference->img_pixels[y];
+		res_row = (const unsigned char *)result->img_pixels[y];
+		for (x = 0; x < width * 3; x++) {
+			err = abs((int)ref_row[x] - (int)res_row[x]);
+			max_err = max(max_err, err);
+			abs_sum += err;
+			sq_sum += (double)err * err;
+		}
+	}
+
+	mse = sq_sum / cnt;
+	psnr = mse > 0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+
+	log_info("Accuracy vs direct convolution (%s, sigma=%.2f): max_err=%d mean_err=%.4f psnr=%.2f dB", args->compute_cfg.filter_type, args->compute_cfg.sigma,
+		 max_err, abs_sum / cnt, psnr);
+
+	ensure_log_dir_exists(ACCURACY_LOG_FILE_PATH);
+	file = fopen(ACCURACY_LOG_FILE_PATH, "a");
+	if (!file) {
+		log_error("Error: could not open accuracy results file '%s' for appending.\n", ACCURACY_LOG_FILE_PATH);
+		return;
+	}
+	// Filter Sigma Width Height MaxErr MeanErr PSNR
+	fprintf(file, "%s %.3f %u %u %d %.6f %.3f\n", args->compute_cfg.filter_type, args->compute_cfg.sigma, width, height, max_err, abs_sum / cnt, psnr);
+	fclose(file);
+}
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "libbmp/libbmp.h"
+#include "utils/threads-general.h"
+
+#define ACCURACY_MAX_SIGMA 64.0 // reference costs 2 * (2 * ceil(3 * sigma) + 1) taps per pixel, keep it affordable
+
+/**
+ * Computes the direct convolution reference for a parametric filter (--accuracy=1).
+ * Must be called before the filter itself runs, since in-place mode overwrites the input.
+ * Gaussian filters ("rg", "pg") have one: the full 2D Gaussian kernel with clamped borders, evaluated as two exact 1D passes.
+ *
+ * @param img_spec Image spec holding the (still untouched) input image.
+ * @param args Pointer to the p_args structure (filter type, sigma).
+ *
+ * @return Newly allocated reference image, or NULL if the filter has no reference, sigma is above ACCURACY_MAX_SIGMA or on error.
+ */
+bmp_img *accuracy_build_reference(struct img_spec *img_spec, struct p_args *args);
+
+/**
+ * Compares the filter output against the reference and appends max/mean absolute error and PSNR
+ * to ACCURACY_LOG_FILE_PATH.
+ *
+ * @param reference Reference image from accuracy_build_reference.
+ * @param result Filter output.
+ * @param args Pointer to the p_args structure (filter type, sigma).
+ */
+void accuracy_report(const bmp_img *reference, const bmp_img *result, struct p_args *args);
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bilateral.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum bilateral_phase { BL_PHASE_SPLAT, BL_PHASE_BLUR_Y, BL_PHASE_CNT };
+
+struct bilateral_ctx {
+	const struct img_spec *img;
+	struct bilateral_grid *grid;
+	int error;
+};
+
+static inline uint8_t bilateral_luma(bmp_pixel p)
+{
+	return (uint8_t)((77 * p.red + 150 * p.green + 29 * p.blue + 128) >> 8);
+}
+
+static inline size_t cell_index(const struct bilateral_grid *g, uint32_t x, uint32_t y, uint32_t z)
+{
+	return (((size_t)y * g->size_x + x) * g->size_z + z) * 4;
+}
+
+// nearest cell of a pixel coordinate or luminance
+static inline uint32_t nearest_cell(double v, double cell)
+{
+	return (uint32_t)(v / cell + 0.5) + BILATERAL_PAD;
+}
+
+// cells along an axis covering 0..max_v, as nearest_cell() plus the padding on both sides; double so it can't wrap
+static inline double grid_axis_size(double max_v, double cell)
+{
+	return floor(max_v / cell + 0.5) + 2 * BILATERAL_PAD + 1;
+}
+
+/**
+ * Blurs `n` cells spaced by `stride` floats with [1 4 6 4 1] / 16, cells outside the grid are zero.
+ * `tmp` holds n * 4 floats.
+ */
+static void blur_line(float *line, size_t stride, uint32_t n, float *tmp)
+{
+	uint32_t i, c;
+	float v;
+
+	for (i = 0; i < n; i++)
+		memcpy(tmp + (size_t)i * 4, line + i * stride, 4 * sizeof(float));
+
+	for (i = 0; i < n; i++) {
+		for (c = 0; c < 4; c++) {
+			v = 6.0f * tmp[(size_t)i * 4 + c];
+			if (i >= 1)
+				v += 4.0f * tmp[(size_t)(i - 1) * 4 + c];
+			if (i >= 2)
+				v += tmp[(size_t)(i - 2) * 4 + c];
+			if (i + 1 < n)
+				v += 4.0f * tmp[(size_t)(i + 1) * 4 + c];
+			if (i + 2 < n)
+				v += tmp[(size_t)(i + 2) * 4 + c];
+			line[i * stride + c] = v / 16.0f;
+		}
+	}
+}
+
+/**
+ * Splats the pixels that fall into grid rows [start, end) and blurs these rows along x and z.
+ * Each cell is owned by one thread and pixels are visited in raster order, so the sums don't depend on the thread count.
+ */
+static void bilateral_splat_rows(struct bilateral_ctx *ctx, uint32_t start, uint32_t end, float *tmp)
+{
+	struct bilateral_grid *g = ctx->grid;
+	const struct img_dim *dim = ctx->img->dim;
+	uint32_t x, y, gx, gy, gz;
+	const bmp_pixel *row;
+	float *cell;
+
+	for (y = 0; y < (uint32_t)dim->height; y++) {
+		gy = nearest_cell(y, g->cell_s);
+		if (gy < start || gy >= end)
+			continue;
+		row = ctx->img->input->img_pixels[y];
+		for (x = 0; x < (uint32_t)dim->width; x++) {
+			gx = nearest_cell(x, g->cell_s);
+			gz = nearest_cell(bilateral_luma(row[x]), g->cell_r);
+			cell = g->data + cell_index(g, gx, gy, gz);
+			cell[0] += row[x].red;
+			cell[1] += row[x].green;
+			cell[2] += row[x].blue;
+			cell[3] += 1.0f;
+		}
+	}
+
+	for (gy = start; gy < end; gy++) {
+		for (gz = 0; gz < g->size_z; gz++)
+			blur_line(g->data + cell_index(g, 0, gy, gz), (size_t)g->size_z * 4, g->size_x, tmp);
+		for (gx = 0; gx < g->size_x; gx++)
+			blur_line(g->data + cell_index(g, gx, gy, 0), 4, g->size_z, tmp);
+	}
+}
+
+static void bilateral_phase_run(void *arg, int phase, int tid, int nthreads)
+{
+	struct bilateral_ctx *ctx = (struct bilateral_ctx *)arg;
+	struct bilateral_grid *g = ctx->grid;
+	uint32_t lines = (phase == BL_PHASE_SPLAT) ? g->size_y : g->size_x;
+	uint32_t start = (uint32_t)((uint64_t)lines * tid / nthreads);
+	uint32_t end = (uint32_t)((uint64_t)lines * (tid + 1) / nthreads);
+	uint32_t gx, gz;
+	float *tmp = NULL;
+
+	if (__atomic_load_n(&ctx->error, __ATOMIC_ACQUIRE) || start >= end)
+		return;
+
+	tmp = malloc((size_t)max(max(g->size_x, g->size_y), g->size_z) * 4 * sizeof(float));
+	if (!tmp) {
+		log_error("Failed to allocate bilateral grid line buffer (thread %d).", tid);
+		__atomic_store_n(&ctx->error, 1, __ATOMIC_RELEASE);
+		return;
+	}
+
+	if (phase == BL_PHASE_SPLAT) {
+		bilateral_splat_rows(ctx, start, end, tmp);
+	} else {
+		for (gx = start; gx < end; gx++)
+			for (gz = 0; gz < g->size_z; gz++)
+				blur_line(g->data + cell_index(g, gx, 0, gz), (size_t)g->size_x * g->size_z * 4, g->size_y, tmp);
+	}
+
+	free(tmp);
+}
+
+int bilateral_grid_attach(int threadnum, struct img_spec *img_spec, const struct p_args *args)
+{
+	struct bilateral_ctx ctx = { 0 };
+	struct bilateral_grid *g = NULL;
+	const struct img_dim *dim = img_spec->dim;
+	double size_x, size_y, size_z;
+	int rc;
+
+	if (args->compute_cfg.sigma < BILATERAL_MIN_SIGMA || args->compute_cfg.sigma_r < BILATERAL_MIN_SIGMA) {
+		log_error("Bilateral filter requires sigma and sigma_r >= %.1f, got %.3f and %.3f", BILATERAL_MIN_SIGMA, args->compute_cfg.sigma,
+			  args->compute_cfg.sigma_r);
+		return -1;
+	}
+
+	size_x = grid_axis_size(dim->width - 1, args->compute_cfg.sigma);
+	size_y = grid_axis_size(dim->height - 1, args->compute_cfg.sigma);
+	size_z = grid_axis_size(255, args->compute_cfg.sigma_r);
+	// checked before narrowing, every axis is below the limit if the product is
+	if (size_x * size_y * size_z > BILATERAL_MAX_CELLS) {
+		log_error("Bilateral grid of %.0fx%.0fx%.0f cells exceeds %u cells, raise --sigma or --sigma-r.", size_x, size_y, size_z, BILATERAL_MAX_CELLS);
+		return -1;
+	}
+
+	g = calloc(1, sizeof(struct bilateral_grid));
+	if (!g) {
+		log_error("Failed to allocate bilateral grid.");
+		return -1;
+	}
+
+	g->cell_s = args->compute_cfg.sigma;
+	g->cell_r = args->compute_cfg.sigma_r;
+	g->size_x = (uint32_t)size_x;
+	g->size_y = (uint32_t)size_y;
+	g->size_z = (uint32_t)size_z;
+
+	g->data = calloc((size_t)g->size_y * g->size_x * g->size_z * 4, sizeof(float));
+	if (!g->data) {
+		log_error("Failed to allocate bilateral grid data (%ux%ux%u cells).", g->size_x, g->size_y, g->size_z);
+		free(g);
+		return -1;
+	}
+
+	log_debug("Bilateral grid %ux%ux%u cells (sigma=%.3f, sigma_r=%.3f)", g->size_x, g->size_y, g->size_z, g->cell_s, g->cell_r);
+
+	ctx.img = img_spec;
+	ctx.grid = g;
+	rc = run_phased_parallel(threadnum, BL_PHASE_CNT, bilateral_phase_run, &ctx);
+	if (!rc && ctx.error)
+		rc = -1;
+	if (rc) {
+		free(g->data);
+		free(g);
+		return -1;
+	}
+
+	img_spec->bilateral = g;
+	return 0;
+}
+
+void bilateral_grid_detach(struct img_spec *img_spec)
+{
+	if (!img_spec->bilateral)
+		return;
+
+	free(img_spec->bilateral->data);
+	free(img_spec->bilateral);
+	img_spec->bilateral = NULL;
+}
+
+void apply_bilateral(struct thread_spec *spec)
+{
+	const struct bilateral_grid *g = spec->img->bilateral;
+	bmp_pixel **input = spec->img->input->img_pixels;
+	bmp_pixel **output = spec->img->output->img_pixels;
+	double fx, fy, fz, wx, wy, wz, w, acc[4];
+	uint32_t x0, y0, z0, dx, dy, dz, c;
+	const float *cell;
+	bmp_pixel src;
+
+	log_trace("Slicing bilateral grid for region R[%u-%u) C[%u-%u)", spec->start_row, spec->end_row, spec->start_column, spec->end_column);
+
+	for (int32_t y = spec->start_row; y < (int32_t)spec->end_row; y++) {
+		fy = y / g->cell_s + BILATERAL_PAD;
+		y0 = (uint32_t)fy;
+		wy = fy - y0;
+
+		for (int32_t x = spec->start_column; x < (int32_t)spec->end_column; x++) {
+			src = input[y][x];
+			fx = x / g->cell_s + BILATERAL_PAD;
+			fz = bilateral_luma(src) / g->cell_r + BILATERAL_PAD;
+			x0 = (uint32_t)fx;
+			z0 = (uint32_t)fz;
+			wx = fx - x0;
+			wz = fz - z0;
+
+			acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+			for (dy = 0; dy < 2; dy++) {
+				for (dx = 0; dx < 2; dx++) {
+					for (dz = 0; dz < 2; dz++) {
+						w = (dy ? wy : 1.0 - wy) * (dx ? wx : 1.0 - wx) * (dz ? wz : 1.0 - wz);
+						cell = g->data + cell_index(g, x0 + dx, y0 + dy, z0 + dz);
+						for (c = 0; c < 4; c++)
+							acc[c] += w * cell[c];
+					}
+				}
+			}
+
+			// the pixel's own splat keeps the weight positive, the check only guards against underflow
+			if (acc[3] <= 0.0) {
+				output[y][x] = src;
+				continue;
+			}
+			output[y][x].red = (unsigned char)fmin(fmax(round(acc[0] / acc[3]), 0.0), 255.0);
+			output[y][x].green = (unsigned char)fmin(fmax(round(acc[1] / acc[3]), 0.0), 255.0);
+			output[y][x].blue = (unsigned char)fmin(fmax(round(acc[2] / acc[3]), 0.0), 255.0);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "libbmp/libbmp.h"
+#include "utils/args-parse.h"
+#include "utils/threads-general.h"
+
+#define BILATERAL_PAD 2 // zero cells around the data, enough for the 5-tap blur and the trilinear slice
+#define BILATERAL_MAX_CELLS (1u << 28) // 4 GiB of (R, G, B, weight) cells
+
+/**
+ * Bilateral grid of one image (Paris & Durand, "A Fast Approximation of the Bilateral Filter using a Signal Processing Approach", 2006).
+ * Cell (x, y, z) covers `cell_s` pixels in both directions and `cell_r` luminance levels;
+ * it holds the sums of R, G, B and of the weight of the pixels splatted into it.
+ */
+struct bilateral_grid {
+	uint32_t size_x;
+	uint32_t size_y;
+	uint32_t size_z;
+	double cell_s; // spatial sigma, in pixels
+	double cell_r; // range sigma, in luminance levels
+	float *data; // size_y * size_x * size_z cells of (R, G, B, weight), z varies fastest
+};
+
+/**
+ * Builds the bilateral grid of `img_spec->input` and attaches it to `img_spec->bilateral`:
+ * every pixel is splatted into its nearest cell, then the grid is blurred with a 5-tap binomial (sigma of one cell) along x, z and y.
+ * Grid rows are split into bands, one per thread, for the splat and the x/z blur; grid columns for the y blur.
+ * Cost is one pass over the image plus a pass over the grid, which shrinks as sigma grows.
+ * Fails if the grid would have more than BILATERAL_MAX_CELLS cells.
+ *
+ * @param threadnum Number of threads to use.
+ * @param img_spec Image spec.
+ * @param args Pointer to the p_args structure (--sigma, --sigma-r).
+ *
+ * @return 0 on success, -1 on error.
+ */
+int bilateral_grid_attach(int threadnum, struct img_spec *img_spec, const struct p_args *args);
+
+/**
+ * Frees the bilateral grid of `img_spec`, if any.
+ */
+void bilateral_grid_detach(struct img_spec *img_spec);
+
+/**
+ * Slices the grid attached by bilateral_grid_attach() for the region of `spec`: every output pixel is the trilinear
+ * interpolation of the blurred grid at (x, y, luminance) divided by the interpolated weight.
+ * Pixels are independent, so any partitioning of the image works unchanged.
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ */
+void apply_bilateral(struct thread_spec *spec);
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "decimate.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+
+static inline int32_t first_sample(int32_t start, uint8_t step)
+{
+	return (start + step - 1) / step * step;
+}
+
+void apply_filter_decimated(struct thread_spec *spec, struct filter cfilter, uint8_t step)
+{
+	struct img_dim *dim = spec->img->dim;
+	bmp_pixel **input = spec->img->input->img_pixels;
+	bmp_pixel **output = spec->img->output->img_pixels;
+	int32_t pad = cfilter.size / 2;
+	int32_t x, y, filterX, filterY, imageX;
+	double red_acc, green_acc, blue_acc, weight;
+	const bmp_pixel *src;
+	bmp_pixel *dst;
+
+	log_trace("Applying filter size %d decimated by %u to region R[%u-%u) C[%u-%u)", cfilter.size, step, spec->start_row, spec->end_row, spec->start_column,
+		  spec->end_column);
+
+	for (y = first_sample(spec->start_row, step); y < (int32_t)spec->end_row; y += step) {
+		dst = output[y / step];
+		for (x = first_sample(spec->start_column, step); x < (int32_t)spec->end_column; x += step) {
+			red_acc = 0.0;
+			green_acc = 0.0;
+			blue_acc = 0.0;
+
+			for (filterY = 0; filterY < cfilter.size; filterY++) {
+				src = input[min(max(y + filterY - pad, 0), (int32_t)dim->height - 1)];
+				for (filterX = 0; filterX < cfilter.size; filterX++) {
+					imageX = min(max(x + filterX - pad, 0), (int32_t)dim->width - 1);
+					weight = cfilter.filter_arr[filterY][filterX];
+
+					red_acc += src[imageX].red * weight;
+					green_acc += src[imageX].green * weight;
+					blue_acc += src[imageX].blue * weight;
+				}
+			}
+
+			dst[x / step].red = (unsigned char)fmin(fmax(round(red_acc * cfilter.factor + cfilter.bias), 0.0), 255.0);
+			dst[x / step].green = (unsigned char)fmin(fmax(round(green_acc * cfilter.factor + cfilter.bias), 0.0), 255.0);
+			dst[x / step].blue = (unsigned char)fmin(fmax(round(blue_acc * cfilter.factor + cfilter.bias), 0.0), 255.0);
+		}
+	}
+}
+
+void apply_median_filter_decimated(struct thread_spec *spec, uint16_t filter_size, uint8_t step)
+{
+	struct img_dim *dim = spec->img->dim;
+	int32_t half_size = filter_size / 2;
+	int32_t filter_area = filter_size * filter_size;
+	int32_t *red = NULL, *green = NULL, *blue = NULL;
+	int32_t x, y, n, filterX, filterY;
+	bmp_pixel orig_pixel;
+	bmp_pixel *dst;
+
+	red = malloc(filter_area * sizeof(*red));
+	green = malloc(filter_area * sizeof(*green));
+	blue = malloc(filter_area * sizeof(*blue));
+	if (!red || !green || !blue) {
+		log_error("Failed to allocate memory for median filter arrays.");
+		goto mem_err;
+	}
+
+	for (y = first_sample(spec->start_row, step); y < (int32_t)spec->end_row; y += step) {
+		dst = spec->img->output->img_pixels[y / step];
+		for (x = first_sample(spec->start_column, step); x < (int32_t)spec->end_column; x += step) {
+			n = 0;
+			for (filterY = -half_size; filterY <= half_size; filterY++) {
+				for (filterX = -half_size; filterX <= half_size; filterX++) {
+					orig_pixel = spec->img->input->img_pixels[(y + filterY + dim->height) % dim->height][(x + filterX + dim->width) % dim->width];
+					red[n] = orig_pixel.red;
+					green[n] = orig_pixel.green;
+					blue[n] = orig_pixel.blue;
+					n++;
+				}
+			}
+
+			dst[x / step].red = (unsigned char)selectKth(red, 0, filter_area, filter_area / 2);
+			dst[x / step].green = (unsigned char)selectKth(green, 0, filter_area, filter_area / 2);
+			dst[x / step].blue = (unsigned char)selectKth(blue, 0, filter_area, filter_area / 2);
+		}
+	}
+
+mem_err:
+	free(red);
+	free(green);
+	free(blue);
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "utils/filters.h"
+#include "utils/threads-general.h"
+
+// Number of samples kept from `size` pixels when every `step`-th one is computed (the first one included)
+#define DECIMATED_SIZE(size, step) (((size) + (step) - 1) / (step))
+
+/**
+ * Fused filter + downscale: computes apply_filter() only at input pixels whose row and column are multiples of `step`
+ * and stores pixel (y, x) of the input at (y / step, x / step) of the output, which is DECIMATED_SIZE() of the input in both directions.
+ * Region from `spec` is in input coordinates, so any partitioning of the full-size image works unchanged.
+ * Accumulation order matches apply_filter(), so the result equals a full-resolution pass followed by point sampling.
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ * @param cfilter The filter structure containing the kernel matrix, size, bias, and factor.
+ * @param step Decimation factor.
+ */
+void apply_filter_decimated(struct thread_spec *spec, struct filter cfilter, uint8_t step);
+
+/**
+ * Same as apply_filter_decimated() for apply_median_filter().
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ * @param filter_size The dimension of the square median window.
+ * @param step Decimation factor.
+ */
+void apply_median_filter_decimated(struct thread_spec *spec, uint16_t filter_size, uint8_t step);
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "gray.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t gray_supported(const struct p_args *args, struct filter_mix *filters)
+{
+	const char *filter_type = args->compute_cfg.filter_type;
+
+	if (!args->compute_cfg.gray || args->compute_cfg.decimate > 1 || args->compute_cfg.inplace)
+		return 0;
+	return strcmp(filter_type, "mm") == 0 || get_filter_by_name(filters, filter_type) != NULL;
+}
+
+uint8_t gray_image_detect(const bmp_img *img, uint32_t width, uint32_t height)
+{
+	const bmp_pixel *row;
+
+	for (uint32_t y = 0; y < height; y++) {
+		row = img->img_pixels[y];
+		for (uint32_t x = 0; x < width; x++)
+			if (row[x].red != row[x].green || row[x].red != row[x].blue)
+				return 0;
+	}
+	return 1;
+}
+
+int gray_attach(struct img_spec *img_spec)
+{
+	uint32_t width = img_spec->dim->width, height = img_spec->dim->height;
+	unsigned char *input = NULL, *dst;
+	const bmp_pixel *row;
+
+	input = malloc((size_t)width * height);
+	if (!input) {
+		log_error("Failed to allocate grayscale input plane.");
+		return -1;
+	}
+
+	// detection and copy in one pass
+	for (uint32_t y = 0; y < height; y++) {
+		row = img_spec->input->img_pixels[y];
+		dst = input + (size_t)y * width;
+		for (uint32_t x = 0; x < width; x++) {
+			if (row[x].red != row[x].green || row[x].red != row[x].blue) {
+				free(input);
+				return 0;
+			}
+			dst[x] = row[x].red;
+		}
+	}
+
+	img_spec->gray_output = malloc((size_t)width * height);
+	if (!img_spec->gray_output) {
+		log_error("Failed to allocate grayscale output plane.");
+		free(input);
+		return -1;
+	}
+	img_spec->gray_input = input;
+
+	log_debug("Grayscale input detected, using single-channel engines");
+	return 1;
+}
+
+void gray_detach(struct img_spec *img_spec)
+{
+	uint32_t width = img_spec->dim->width, height = img_spec->dim->height;
+	const unsigned char *src;
+	bmp_pixel *row;
+
+	if (!img_spec->gray_output)
+		return;
+
+	for (uint32_t y = 0; y < height; y++) {
+		src = img_spec->gray_output + (size_t)y * width;
+		row = img_spec->output->img_pixels[y];
+		for (uint32_t x = 0; x < width; x++)
+			row[x] = BMP_PIXEL(src[x], src[x], src[x]);
+	}
+
+	free(img_spec->gray_input);
+	free(img_spec->gray_output);
+	img_spec->gray_input = NULL;
+	img_spec->gray_output = NULL;
+}
+
+void gray_filter_buffer(const unsigned char *input, uint32_t in_first_row, unsigned char *output, uint32_t out_first_row, const struct img_dim *dim,
+			const struct filter *cfilter, uint32_t start_row, uint32_t end_row, uint32_t start_column, uint32_t end_column)
+{
+	const unsigned char *rows[cfilter->size];
+	int32_t cols[cfilter->size];
+	int32_t pad = cfilter->size / 2;
+	int32_t filterX, filterY;
+	unsigned char *dst;
+	double acc;
+
+	for (uint32_t y = start_row; y < end_row; y++) {
+		// clamped source rows of the window, as in apply_filter
+		for (filterY = 0; filterY < cfilter->size; filterY++)
+			rows[filterY] = input + (size_t)(min(max((int32_t)y + filterY - pad, 0), (int32_t)dim->height - 1) - in_first_row) * dim->width;
+		dst = output + (size_t)(y - out_first_row) * dim->width;
+
+		for (uint32_t x = start_column; x < end_column; x++) {
+			for (filterX = 0; filterX < cfilter->size; filterX++)
+				cols[filterX] = min(max((int32_t)x + filterX - pad, 0), (int32_t)dim->width - 1);
+
+			acc = 0.0;
+			for (filterY = 0; filterY < cfilter->size; filterY++)
+				for (filterX = 0; filterX < cfilter->size; filterX++)
+					acc += rows[filterY][cols[filterX]] * cfilter->filter_arr[filterY][filterX];
+
+			dst[x] = (unsigned char)fmin(fmax(round(acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+		}
+	}
+}
+
+void apply_filter_gray(struct thread_spec *spec, struct filter cfilter)
+{
+	log_trace("Applying single-channel filter size %d to region R[%u-%u) C[%u-%u)", cfilter.size, spec->start_row, spec->end_row, spec->start_column,
+		  spec->end_column);
+
+	gray_filter_buffer(spec->img->gray_input, 0, spec->img->gray_output, 0, spec->img->dim, &cfilter, spec->start_row, spec->end_row, spec->start_column,
+			   spec->end_column);
+}
+
+void apply_median_filter_gray(struct thread_spec *spec, uint16_t filter_size)
+{
+	struct img_dim *dim = spec->img->dim;
+	const unsigned char *input = spec->img->gray_input;
+	int32_t half_size = filter_size / 2;
+	int32_t filter_area = filter_size * filter_size;
+	int32_t *window = NULL;
+	int32_t filterX, filterY, n, imageY;
+	const unsigned char *src;
+
+	window = malloc(filter_area * sizeof(*window));
+	if (!window) {
+		log_error("Failed to allocate memory for median filter array.");
+		return;
+	}
+
+	for (int32_t y = spec->start_row; y < (int32_t)spec->end_row; y++) {
+		for (int32_t x = spec->start_column; x < (int32_t)spec->end_column; x++) {
+			n = 0;
+			for (filterY = -half_size; filterY <= half_size; filterY++) {
+				imageY = (y + filterY + dim->height) % dim->height;
+				src = input + (size_t)imageY * dim->width;
+				for (filterX = -half_size; filterX <= half_size; filterX++)
+					window[n++] = src[(x + filterX + dim->width) % dim->width];
+			}
+			spec->img->gray_output[(size_t)y * dim->width + x] = (unsigned char)selectKth(window, 0, filter_area, filter_area / 2);
+		}
+	}
+
+	free(window);
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "libbmp/libbmp.h"
+#include "utils/filters.h"
+#include "utils/threads-general.h"
+
+/**
+ * Tells whether the run can use the single-channel engines: --gray=1, a convolution or median filter,
+ * full-size output and a separate output image.
+ *
+ * @param args Pointer to the p_args structure.
+ * @param filters Pointer to the filter_mix structure.
+ */
+uint8_t gray_supported(const struct p_args *args, struct filter_mix *filters);
+
+/**
+ * Tells whether every pixel of the image has R = G = B (8-bit inputs with a grayscale palette included).
+ * Stops at the first colour pixel.
+ */
+uint8_t gray_image_detect(const bmp_img *img, uint32_t width, uint32_t height);
+
+/**
+ * Detects a grayscale input and, if it is one, attaches `width * height` single-channel input (copy of the red channel)
+ * and output planes to `img_spec`. From then on filter_part_computation runs the single-channel engines on the planes.
+ *
+ * @param img_spec Image spec.
+ *
+ * @return 1 if the planes were attached, 0 if the image has colour pixels, -1 on error.
+ */
+int gray_attach(struct img_spec *img_spec);
+
+/**
+ * Expands the output plane into the output image (R = G = B) and frees both planes.
+ * Does nothing if no planes are attached.
+ *
+ * @param img_spec Image spec.
+ */
+void gray_detach(struct img_spec *img_spec);
+
+/**
+ * Single-channel apply_filter() over row-major buffers of `dim->width` bytes per row, same clamping and accumulation order.
+ * Buffers may hold only a band of the image: `input` starts at global row `in_first_row`, `output` at `out_first_row`
+ * (both 0 for whole-image planes), so the MPI local buffers work too.
+ *
+ * @param input Input buffer.
+ * @param in_first_row Global index of the first row in `input`.
+ * @param output Output buffer.
+ * @param out_first_row Global index of the first row in `output`.
+ * @param dim Global image dimensions.
+ * @param cfilter The filter structure containing the kernel matrix, size, bias, and factor.
+ * @param start_row First global row to compute.
+ * @param end_row Row after the last one to compute.
+ * @param start_column First column to compute.
+ * @param end_column Column after the last one to compute.
+ */
+void gray_filter_buffer(const unsigned char *input, uint32_t in_first_row, unsigned char *output, uint32_t out_first_row, const struct img_dim *dim,
+			const struct filter *cfilter, uint32_t start_row, uint32_t end_row, uint32_t start_column, uint32_t end_column);
+
+/**
+ * Single-channel apply_filter() for the region of `spec`, on the planes attached by gray_attach().
+ */
+void apply_filter_gray(struct thread_spec *spec, struct filter cfilter);
+
+/**
+ * Single-channel apply_median_filter() (wrapped borders) for the region of `spec`, on the planes attached by gray_attach().
+ */
+void apply_median_filter_gray(struct thread_spec *spec, uint16_t filter_size);
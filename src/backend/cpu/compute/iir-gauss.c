@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "iir-gauss.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum iir_phase { IIR_PHASE_ROWS, IIR_PHASE_COLUMNS, IIR_PHASE_CNT };
+
+struct iir_ctx {
+	struct img_spec *img;
+	struct iir_gauss_coefs coefs;
+	float *tmp; // row pass result, width * height * 3 channels
+	int error;
+};
+
+void iir_gauss_get_coefs(double sigma, struct iir_gauss_coefs *coefs)
+{
+	double q, q2, q3, b0, b1, b2, b3;
+	double a1, a2, a3, scale;
+
+	if (sigma >= 2.5)
+		q = 0.98711 * sigma - 0.96330;
+	else
+		q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+
+	q2 = q * q;
+	q3 = q2 * q;
+	b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+	b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+	b2 = -(1.4281 * q2 + 1.26661 * q3);
+	b3 = 0.422205 * q3;
+
+	a1 = coefs->a1 = b1 / b0;
+	a2 = coefs->a2 = b2 / b0;
+	a3 = coefs->a3 = b3 / b0;
+	coefs->B = 1.0 - (a1 + a2 + a3);
+
+	scale = coefs->B / ((1.0 + a1 - a2 + a3) * (1.0 - a1 - a2 - a3) * (1.0 + a2 + (a1 - a3) * a3));
+	coefs->M[0] = scale * (-a3 * a1 + 1.0 - a3 * a3 - a2);
+	coefs->M[1] = scale * (a3 + a1) * (a2 + a3 * a1);
+	coefs->M[2] = scale * a3 * (a1 + a3 * a2);
+	coefs->M[3] = scale * (a1 + a3 * a2);
+	coefs->M[4] = -scale * (a2 - 1.0) * (a2 + a3 * a1);
+	coefs->M[5] = -scale * a3 * (a3 * a1 + a3 * a3 + a2 - 1.0);
+	coefs->M[6] = scale * (a3 * a1 + a2 + a1 * a1 - a2 * a2);
+	coefs->M[7] = scale * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3);
+	coefs->M[8] = scale * a3 * (a1 + a3 * a2);
+}
+
+/**
+ * Triggs & Sdika initial values of the anti-causal pass: returns y[N-1] in v[0] and the virtual y[N], y[N+1] in v[1], v[2].
+ * `w0`, `w1`, `w2` are the causal outputs at N-1, N-2, N-3 and `u` is the last input sample.
+ */
+static inline void iir_anticausal_init(const struct iir_gauss_coefs *c, double w0, double w1, double w2, double u, double *v)
+{
+	for (int i = 0; i < 3; i++)
+		v[i] = c->M[3 * i] * (w0 - u) + c->M[3 * i + 1] * (w1 - u) + c->M[3 * i + 2] * (w2 - u) + u;
+}
+
+static inline unsigned char iir_to_channel(double v)
+{
+	return (unsigned char)fmin(fmax(round(v), 0.0), 255.0);
+}
+
+/**
+ * Filters rows [start, end) in both directions and stores the result into ctx->tmp.
+ * `fwd` is a scratch line of width * 3 doubles for the causal pass.
+ */
+static void iir_rows(struct iir_ctx *ctx, uint32_t start, uint32_t end, double *fwd)
+{
+	const struct iir_gauss_coefs *c = &ctx->coefs;
+	uint32_t width = ctx->img->dim->width;
+	uint32_t n = width * 3;
+	int64_t i;
+	uint32_t y, ch;
+	const unsigned char *src;
+	float *dst;
+	double w1, w2, w3, w, v[3];
+
+	for (y = start; y < end; y++) {
+		src = (const unsigned char *)ctx->img->input->img_pixels[y];
+		dst = ctx->tmp + (size_t)y * n;
+
+		for (ch = 0; ch < 3; ch++) {
+			w1 = w2 = w3 = src[ch];
+			for (i = ch; i < n; i += 3) {
+				w = c->B * src[i] + c->a1 * w1 + c->a2 * w2 + c->a3 * w3;
+				fwd[i] = w;
+				w3 = w2;
+				w2 = w1;
+				w1 = w;
+			}
+
+			iir_anticausal_init(c, fwd[n - 3 + ch], fwd[n - 3 * min(width, 2) + ch], fwd[n - 3 * min(width, 3) + ch], src[n - 3 + ch], v);
+			dst[n - 3 + ch] = (float)v[0];
+			w1 = v[0];
+			w2 = v[1];
+			w3 = v[2];
+			for (i = (int64_t)n - 6 + ch; i >= 0; i -= 3) {
+				w = c->B * fwd[i] + c->a1 * w1 + c->a2 * w2 + c->a3 * w3;
+				dst[i] = (float)w;
+				w3 = w2;
+				w2 = w1;
+				w1 = w;
+			}
+		}
+	}
+}
+
+/**
+ * Filters channel columns [c0, c1) of ctx->tmp top-down, then bottom-up, writing the final pixels into the output.
+ * All columns of the sub-strip advance together one row at a time; `state` holds 4 * (c1 - c0) doubles.
+ */
+static void iir_columns(struct iir_ctx *ctx, uint32_t c0, uint32_t c1, double *state)
+{
+	const struct iir_gauss_coefs *c = &ctx->coefs;
+	uint32_t n = ctx->img->dim->width * 3;
+	uint32_t height = ctx->img->dim->height;
+	uint32_t cnt = c1 - c0;
+	double *w1 = state, *w2 = state + cnt, *w3 = state + 2 * cnt, *last = state + 3 * cnt;
+	double w, v[3];
+	int64_t y;
+	uint32_t i;
+	float *row, *row1, *row2;
+	unsigned char *out;
+
+	row = ctx->tmp + c0;
+	for (i = 0; i < cnt; i++)
+		w1[i] = w2[i] = w3[i] = row[i];
+
+	// last input row is overwritten by the causal pass, but the boundary init needs it
+	row = ctx->tmp + (size_t)(height - 1) * n + c0;
+	for (i = 0; i < cnt; i++)
+		last[i] = row[i];
+
+	// causal pass, result stays in tmp
+	for (y = 0; y < height; y++) {
+		row = ctx->tmp + (size_t)y * n + c0;
+		for (i = 0; i < cnt; i++) {
+			w = c->B * row[i] + c->a1 * w1[i] + c->a2 * w2[i] + c->a3 * w3[i];
+			row[i] = (float)w;
+			w3[i] = w2[i];
+			w2[i] = w1[i];
+			w1[i] = w;
+		}
+	}
+
+	row = ctx->tmp + (size_t)(height - 1) * n + c0;
+	row1 = ctx->tmp + (size_t)(height - min(height, 2)) * n + c0;
+	row2 = ctx->tmp + (size_t)(height - min(height, 3)) * n + c0;
+	out = (unsigned char *)ctx->img->output->img_pixels[height - 1] + c0;
+	for (i = 0; i < cnt; i++) {
+		iir_anticausal_init(c, row[i], row1[i], row2[i], last[i], v);
+		out[i] = iir_to_channel(v[0]);
+		w1[i] = v[0];
+		w2[i] = v[1];
+		w3[i] = v[2];
+	}
+
+	// anti-causal pass, straight into the output image
+	for (y = (int64_t)height - 2; y >= 0; y--) {
+		row = ctx->tmp + (size_t)y * n + c0;
+		out = (unsigned char *)ctx->img->output->img_pixels[y] + c0;
+		for (i = 0; i < cnt; i++) {
+			w = c->B * row[i] + c->a1 * w1[i] + c->a2 * w2[i] + c->a3 * w3[i];
+			out[i] = iir_to_channel(w);
+			w3[i] = w2[i];
+			w2[i] = w1[i];
+			w1[i] = w;
+		}
+	}
+}
+
+static void iir_phase_run(void *arg, int phase, int tid, int nthreads)
+{
+	struct iir_ctx *ctx = (struct iir_ctx *)arg;
+	uint32_t width = ctx->img->dim->width;
+	uint32_t height = ctx->img->dim->height;
+	uint32_t start, end, c;
+	double *buf = NULL;
+
+	if (__atomic_load_n(&ctx->error, __ATOMIC_ACQUIRE))
+		return;
+
+	if (phase == IIR_PHASE_ROWS) {
+		start = (uint32_t)((uint64_t)height * tid / nthreads);
+		end = (uint32_t)((uint64_t)height * (tid + 1) / nthreads);
+		if (start >= end)
+			return;
+
+		buf = malloc((size_t)width * 3 * sizeof(double));
+		if (!buf)
+			goto mem_err;
+		iir_rows(ctx, start, end, buf);
+	} else {
+		// strip borders are aligned to pixels, so a strip never splits channels of one pixel
+		start = (uint32_t)((uint64_t)width * tid / nthreads) * 3;
+		end = (uint32_t)((uint64_t)width * (tid + 1) / nthreads) * 3;
+		if (start >= end)
+			return;
+
+		buf = malloc((size_t)4 * IIR_GAUSS_COL_BLOCK * 3 * sizeof(double));
+		if (!buf)
+			goto mem_err;
+		for (c = start; c < end; c += IIR_GAUSS_COL_BLOCK * 3)
+			iir_columns(ctx, c, min(c + IIR_GAUSS_COL_BLOCK * 3, end), buf);
+	}
+
+	free(buf);
+	return;
+
+mem_err:
+	log_error("Failed to allocate IIR line buffer (thread %d).", tid);
+	__atomic_store_n(&ctx->error, 1, __ATOMIC_RELEASE);
+}
+
+int iir_gauss_apply(int threadnum, struct img_spec *img_spec, double sigma)
+{
+	struct iir_ctx ctx = { 0 };
+	struct img_dim *dim = img_spec->dim;
+	int rc;
+
+	if (sigma < IIR_GAUSS_MIN_SIGMA) {
+		log_error("Recursive Gaussian requires sigma >= %.1f, got %.3f", IIR_GAUSS_MIN_SIGMA, sigma);
+		return -1;
+	}
+
+	ctx.img = img_spec;
+	iir_gauss_get_coefs(sigma, &ctx.coefs);
+	ctx.tmp = malloc((size_t)dim->width * dim->height * 3 * sizeof(float));
+	if (!ctx.tmp) {
+		log_error("Failed to allocate IIR intermediate buffer (%ux%u).", dim->width, dim->height);
+		return -1;
+	}
+
+	log_debug("Recursive Gaussian sigma=%.3f: B=%.6f a1=%.6f a2=%.6f a3=%.6f", sigma, ctx.coefs.B, ctx.coefs.a1, ctx.coefs.a2, ctx.coefs.a3);
+
+	rc = run_phased_parallel(threadnum, IIR_PHASE_CNT, iir_phase_run, &ctx);
+	if (!rc && ctx.error)
+		rc = -1;
+
+	free(ctx.tmp);
+	return rc;
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "libbmp/libbmp.h"
+#include "utils/threads-general.h"
+
+#define IIR_GAUSS_MIN_SIGMA 0.5
+#define IIR_GAUSS_COL_BLOCK 256 // pixels per column sub-strip kept in flight during the vertical pass
+
+/**
+ * Recursive filter coefficients (Young & van Vliet, "Recursive implementation of the Gaussian filter", 1995).
+ * One causal or anti-causal pass is: w[n] = B * x[n] + a1 * w[n-1] + a2 * w[n-2] + a3 * w[n-3].
+ * `M` is the Triggs & Sdika (2006) boundary matrix (premultiplied by B), used to start the anti-causal pass
+ * exactly as if the signal were extended with its last value.
+ */
+struct iir_gauss_coefs {
+	double B;
+	double a1, a2, a3;
+	double M[9];
+};
+
+/**
+ * Computes 3rd order recursive Gaussian coefficients for the given standard deviation.
+ *
+ * @param sigma Gaussian standard deviation in pixels (>= IIR_GAUSS_MIN_SIGMA).
+ * @param coefs Output coefficients.
+ */
+void iir_gauss_get_coefs(double sigma, struct iir_gauss_coefs *coefs);
+
+/**
+ * Applies a Gaussian blur with arbitrary sigma to the whole image. Cost per pixel doesn't depend on sigma:
+ * a causal + anti-causal recursive pass runs along every row, then along every column.
+ * Borders are clamped (the signal is extended with its edge value), as in apply_filter.
+ *
+ * Row pass is split into row bands, column pass into column strips, one per thread. Inside a strip columns are
+ * walked in sub-strips of IIR_GAUSS_COL_BLOCK pixels, row by row, so memory is read along rows.
+ * Input and output may be the same image.
+ *
+ * @param threadnum Number of threads to use.
+ * @param img_spec Image spec (input, output and dimensions).
+ * @param sigma Gaussian standard deviation in pixels.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int iir_gauss_apply(int threadnum, struct img_spec *img_spec, double sigma);
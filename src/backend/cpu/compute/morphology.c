@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "morphology.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MORPH_INVERT 0xFF // xor mask turning max into min: min(a, b) = 255 - max(255 - a, 255 - b)
+
+/**
+ * Row-pointer view of an image part: rows[i][j] is the pixel at image row ybase + i, column xbase + j.
+ */
+struct morph_view {
+	bmp_pixel *const *rows;
+	int32_t ybase;
+	int32_t xbase;
+};
+
+struct morph_scratch {
+	unsigned char *ext; // clamped source line of the row pass
+	unsigned char *gx; // block prefix maxima of the row pass
+	unsigned char *tmp; // row pass result, one line of the strip per source row
+	unsigned char *gy; // block prefix maxima of the column pass
+	unsigned char *hy; // running suffix maximum of the column pass
+};
+
+static inline unsigned char umax(unsigned char a, unsigned char b)
+{
+	return a > b ? a : b;
+}
+
+static inline unsigned char *morph_pixel(const struct morph_view *v, int32_t y, int32_t x)
+{
+	return (unsigned char *)&v->rows[y - v->ybase][x - v->xbase];
+}
+
+int morph_get_reach(const char *filter_type, uint16_t radius)
+{
+	if (strcmp(filter_type, "di") == 0 || strcmp(filter_type, "er") == 0)
+		return radius;
+	if (strcmp(filter_type, "op") == 0 || strcmp(filter_type, "cl") == 0)
+		return 2 * radius;
+	return 0;
+}
+
+/**
+ * Row pass of one line: dst[i] = max(src[x0 + i - r .. x0 + i + r]) for i in [0, nx), columns clamped to the image.
+ * Values are xor-ed with `mask` on load, dst stays in the masked domain.
+ */
+static void morph_row(const struct morph_view *in, int32_t y, int32_t width, int32_t x0, int32_t nx, int32_t r, uint8_t mask, struct morph_scratch *s,
+		      unsigned char *dst)
+{
+	int32_t w = 2 * r + 1;
+	int32_t n = nx + 2 * r;
+	int32_t i, b, e, c;
+	unsigned char *ext = s->ext, *g = s->gx, h[3];
+	const unsigned char *src;
+
+	for (i = 0; i < n; i++) {
+		src = morph_pixel(in, y, min(max(x0 - r + i, 0), width - 1));
+		ext[i * 3 + 0] = src[0] ^ mask;
+		ext[i * 3 + 1] = src[1] ^ mask;
+		ext[i * 3 + 2] = src[2] ^ mask;
+	}
+
+	for (b = 0; b < n; b += w) {
+		e = min(b + w, n);
+		memcpy(g + b * 3, ext + b * 3, 3);
+		for (i = (b + 1) * 3; i < e * 3; i++)
+			g[i] = umax(g[i - 3], ext[i]);
+	}
+
+	for (b = (n - 1) / w * w; b >= 0; b -= w) {
+		e = min(b + w, n);
+		memcpy(h, ext + (e - 1) * 3, 3);
+		for (i = e - 1; i >= b; i--) {
+			for (c = 0; c < 3; c++) {
+				h[c] = umax(h[c], ext[i * 3 + c]);
+				if (i < nx)
+					dst[i * 3 + c] = umax(h[c], g[(i + 2 * r) * 3 + c]);
+			}
+		}
+	}
+}
+
+/**
+ * Column pass of the strip [sx0, sx0 + nx): out(y, x) = max over rows y - r .. y + r of the row pass result, rows clamped to the image.
+ * `s->tmp` holds the row pass result for image rows [lo, ...), one line of nx pixels each.
+ * Lines are processed whole, so memory is still walked along rows.
+ */
+static void morph_columns(const struct morph_view *out, int32_t height, int32_t y0, int32_t y1, int32_t sx0, int32_t nx, int32_t lo, int32_t r, uint8_t mask,
+			  struct morph_scratch *s)
+{
+	size_t len = (size_t)nx * 3;
+	int32_t w = 2 * r + 1;
+	int32_t n = y1 - y0 + 2 * r;
+	int32_t i, b, e;
+	size_t k;
+	const unsigned char *src, *g;
+	unsigned char *dst, *h = s->hy;
+
+#define MORPH_LINE(i) (s->tmp + (size_t)(min(max(y0 - r + (i), 0), height - 1) - lo) * len)
+
+	for (b = 0; b < n; b += w) {
+		e = min(b + w, n);
+		memcpy(s->gy + (size_t)b * len, MORPH_LINE(b), len);
+		for (i = b + 1; i < e; i++) {
+			src = MORPH_LINE(i);
+			g = s->gy + (size_t)(i - 1) * len;
+			dst = s->gy + (size_t)i * len;
+			for (k = 0; k < len; k++)
+				dst[k] = umax(g[k], src[k]);
+		}
+	}
+
+	for (b = (n - 1) / w * w; b >= 0; b -= w) {
+		e = min(b + w, n);
+		memcpy(h, MORPH_LINE(e - 1), len);
+		for (i = e - 1; i >= b; i--) {
+			src = MORPH_LINE(i);
+			for (k = 0; k < len; k++)
+				h[k] = umax(h[k], src[k]);
+			if (i >= y1 - y0)
+				continue;
+
+			g = s->gy + (size_t)(i + 2 * r) * len;
+			dst = morph_pixel(out, y0 + i, sx0);
+			for (k = 0; k < len; k++)
+				dst[k] = umax(h[k], g[k]) ^ mask;
+		}
+	}
+
+#undef MORPH_LINE
+}
+
+/**
+ * One dilation (mask 0) or erosion (MORPH_INVERT) of the region [y0, y1) x [x0, x1) from `in` into `out`.
+ * Reads image rows [y0 - r, y1 + r) and columns [x0 - r, x1 + r), clamped to the image.
+ */
+static int morph_pass(const struct morph_view *in, const struct morph_view *out, const struct img_dim *dim, int32_t y0, int32_t y1, int32_t x0, int32_t x1,
+		      int32_t r, uint8_t mask)
+{
+	struct morph_scratch s = { 0 };
+	int32_t lo = max(y0 - r, 0);
+	int32_t hi = min(y1 + r, (int32_t)dim->height);
+	int32_t strip_w = min(MORPH_STRIP_W, x1 - x0);
+	size_t len = (size_t)strip_w * 3;
+	int32_t sx, nx, y;
+	int rc = -1;
+
+	s.ext = malloc((size_t)(strip_w + 2 * r) * 3);
+	s.gx = malloc((size_t)(strip_w + 2 * r) * 3);
+	s.tmp = malloc((size_t)(hi - lo) * len);
+	s.gy = malloc((size_t)(y1 - y0 + 2 * r) * len);
+	s.hy = malloc(len);
+	if (!s.ext || !s.gx || !s.tmp || !s.gy || !s.hy) {
+		log_error("Failed to allocate morphology buffers (%dx%d region, radius %d).", x1 - x0, y1 - y0, r);
+		goto cleanup;
+	}
+
+	for (sx = x0; sx < x1; sx += strip_w) {
+		nx = min(strip_w, x1 - sx);
+		for (y = lo; y < hi; y++)
+			morph_row(in, y, dim->width, sx, nx, r, mask, &s, s.tmp + (size_t)(y - lo) * nx * 3);
+		morph_columns(out, dim->height, y0, y1, sx, nx, lo, r, mask, &s);
+	}
+	rc = 0;
+
+cleanup:
+	free(s.ext);
+	free(s.gx);
+	free(s.tmp);
+	free(s.gy);
+	free(s.hy);
+	return rc;
+}
+
+/**
+ * Runs the filter over [y0, y1) x [x0, x1). Open/close first compute their inner pass over the region grown by `radius`
+ * (clipped to the image) into a temporary buffer, then run the outer pass from it.
+ */
+static int morph_run(const struct morph_view *in, const struct morph_view *out, const struct img_dim *dim, int32_t y0, int32_t y1, int32_t x0, int32_t x1,
+		     const char *filter_type, int32_t r)
+{
+	struct morph_view mid;
+	bmp_pixel *buf = NULL, **rows = NULL;
+	int32_t iy0, iy1, ix0, ix1, i;
+	uint8_t inner, outer;
+	int rc = -1;
+
+	if (strcmp(filter_type, "di") == 0)
+		return morph_pass(in, out, dim, y0, y1, x0, x1, r, 0);
+	if (strcmp(filter_type, "er") == 0)
+		return morph_pass(in, out, dim, y0, y1, x0, x1, r, MORPH_INVERT);
+
+	if (strcmp(filter_type, "op") == 0) {
+		inner = MORPH_INVERT;
+		outer = 0;
+	} else if (strcmp(filter_type, "cl") == 0) {
+		inner = 0;
+		outer = MORPH_INVERT;
+	} else {
+		log_error("Unknown morphology filter '%s'.", filter_type);
+		return -1;
+	}
+
+	iy0 = max(y0 - r, 0);
+	iy1 = min(y1 + r, (int32_t)dim->height);
+	ix0 = max(x0 - r, 0);
+	ix1 = min(x1 + r, (int32_t)dim->width);
+
+	buf = malloc((size_t)(iy1 - iy0) * (ix1 - ix0) * sizeof(bmp_pixel));
+	rows = malloc((iy1 - iy0) * sizeof(bmp_pixel *));
+	if (!buf || !rows) {
+		log_error("Failed to allocate morphology intermediate buffer (%dx%d).", ix1 - ix0, iy1 - iy0);
+		goto cleanup;
+	}
+	for (i = 0; i < iy1 - iy0; i++)
+		rows[i] = buf + (size_t)i * (ix1 - ix0);
+
+	mid.rows = rows;
+	mid.ybase = iy0;
+	mid.xbase = ix0;
+
+	rc = morph_pass(in, &mid, dim, iy0, iy1, ix0, ix1, r, inner);
+	if (!rc)
+		rc = morph_pass(&mid, out, dim, y0, y1, x0, x1, r, outer);
+
+cleanup:
+	free(buf);
+	free(rows);
+	return rc;
+}
+
+void apply_morphology(struct thread_spec *spec, const char *filter_type, uint16_t radius)
+{
+	struct morph_view in, out;
+
+	if (spec->end_row <= spec->start_row || spec->end_column <= spec->start_column)
+		return;
+
+	in.rows = spec->img->input->img_pixels;
+	in.ybase = 0;
+	in.xbase = 0;
+	out.rows = spec->img->output->img_pixels;
+	out.ybase = 0;
+	out.xbase = 0;
+
+	log_trace("Applying morphology '%s' radius %u to region R[%u-%u) C[%u-%u)", filter_type, radius, spec->start_row, spec->end_row, spec->start_column,
+		  spec->end_column);
+
+	if (morph_run(&in, &out, spec->img->dim, spec->start_row, spec->end_row, spec->start_column, spec->end_column, filter_type, radius) < 0)
+		log_error("Morphology '%s' failed for region R[%u-%u) C[%u-%u)", filter_type, spec->start_row, spec->end_row, spec->start_column, spec->end_column);
+}
+
+int morph_apply_buffer(const unsigned char *input, uint32_t in_first_row, uint32_t in_rows, unsigned char *output, uint32_t out_first_row, uint32_t out_rows,
+		       size_t row_stride, const struct img_dim *dim, const char *filter_type, uint16_t radius)
+{
+	struct morph_view in, out;
+	bmp_pixel **in_tab = NULL, **out_tab = NULL;
+	uint32_t i;
+	int rc = -1;
+
+	if (out_rows == 0)
+		return 0;
+
+	in_tab = malloc(in_rows * sizeof(bmp_pixel *));
+	out_tab = malloc(out_rows * sizeof(bmp_pixel *));
+	if (!in_tab || !out_tab) {
+		log_error("Failed to allocate morphology row tables.");
+		goto cleanup;
+	}
+
+	for (i = 0; i < in_rows; i++)
+		in_tab[i] = (bmp_pixel *)(input + i * row_stride);
+	for (i = 0; i < out_rows; i++)
+		out_tab[i] = (bmp_pixel *)(output + i * row_stride);
+
+	in.rows = in_tab;
+	in.ybase = in_first_row;
+	in.xbase = 0;
+	out.rows = out_tab;
+	out.ybase = out_first_row;
+	out.xbase = 0;
+
+	rc = morph_run(&in, &out, dim, out_first_row, out_first_row + out_rows, 0, dim->width, filter_type, radius);
+
+cleanup:
+	free(in_tab);
+	free(out_tab);
+	return rc;
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utils/threads-general.h"
+
+#define MORPH_STRIP_W 256 // pixels per column strip of the vertical pass
+
+/**
+ * Returns how far (in pixels) a morphology filter reads around an output pixel:
+ * `radius` for dilate/erode, `2 * radius` for open/close (two chained passes).
+ *
+ * @param filter_type One of "di", "er", "op", "cl".
+ * @param radius Structuring element radius.
+ * @return Reach in pixels, or 0 for non-morphology filters.
+ */
+int morph_get_reach(const char *filter_type, uint16_t radius);
+
+/**
+ * Applies a grayscale morphology filter with a (2 * radius + 1) square structuring element to the region from `spec`:
+ * "di" - dilate (max), "er" - erode (min), "op" - open (erode, then dilate), "cl" - close (dilate, then erode).
+ * Channels are processed independently, borders are clamped as in apply_filter().
+ *
+ * Each pass is separable (rows, then columns) and every 1D pass uses the van Herk/Gil-Werman algorithm:
+ * the line is cut into blocks of the window length, prefix and suffix maxima are built per block,
+ * and every output is the max of one suffix and one prefix value - about 3 comparisons per pixel, whatever the radius.
+ * Erosion is computed as the dilation of the inverted image.
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ * @param filter_type Morphology filter identifier.
+ * @param radius Structuring element radius.
+ */
+void apply_morphology(struct thread_spec *spec, const char *filter_type, uint16_t radius);
+
+/**
+ * Same as apply_morphology() but for contiguous pixel buffers (MPI local chunks).
+ * Computes full-width rows [out_first_row, out_first_row + out_rows) of the image.
+ *
+ * @param input Input buffer, its first row is image row `in_first_row`.
+ * @param in_first_row Global index of the first input row.
+ * @param in_rows Number of rows in the input buffer (must include morph_get_reach() halo rows on each side, where present).
+ * @param output Output buffer, its first row is image row `out_first_row`.
+ * @param out_first_row Global index of the first output row.
+ * @param out_rows Number of rows to compute.
+ * @param row_stride Bytes between the starts of two consecutive rows in both buffers.
+ * @param dim Global image dimensions (used for border clamping).
+ * @param filter_type Morphology filter identifier.
+ * @param radius Structuring element radius.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int morph_apply_buffer(const unsigned char *input, uint32_t in_first_row, uint32_t in_rows, unsigned char *output, uint32_t out_first_row, uint32_t out_rows,
+		       size_t row_stride, const struct img_dim *dim, const char *filter_type, uint16_t radius);
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "pyramid.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PYR_REDUCE_TAPS 5
+#define PYR_EXPAND_ROWS 3
+
+static const float pyr_binomial[PYR_REDUCE_TAPS] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+
+/**
+ * One pyramid level, pixels stored as interleaved float channels. `data == NULL` stands for level 0, the image
+ * grown by `margin` pixels on every side (clamped reads): the input image when the level is read, the output image when it's written.
+ */
+struct pyr_plane {
+	float *data;
+	uint32_t w, h;
+};
+
+struct pyr_ctx {
+	struct img_spec *img;
+	int levels;
+	struct pyr_plane lv[PYR_MAX_LEVELS + 1];
+	struct pyr_plane res; // residual blur result at the coarsest level
+	uint32_t margin; // level 0 border, keeps the coarse levels' border handling away from visible pixels
+	float *kernel; // residual Gaussian, 2 * radius + 1 taps
+	int radius;
+	int error;
+};
+
+typedef void (*pyr_line_fn)(const struct pyr_ctx *ctx, const float *src, uint32_t src_w, float *dst, uint32_t dst_w);
+
+/**
+ * Per-thread cache of horizontally filtered source rows, `slots` lines keyed by the source row index.
+ * A destination row needs a few consecutive source rows, so consecutive destination rows mostly hit the cache.
+ */
+struct pyr_ring {
+	float *lines;
+	int64_t *tags;
+	float *conv; // scratch line for converting image rows to float
+	size_t len;
+	int slots;
+};
+
+static inline uint32_t clamp_idx(int64_t i, uint32_t n)
+{
+	return (uint32_t)(i < 0 ? 0 : (i >= n ? n - 1 : i));
+}
+
+int pyramid_get_levels(double sigma, uint32_t width, uint32_t height, double *sigma_res)
+{
+	double var = sigma * sigma;
+	double next, scale;
+	int levels = 0;
+
+	while (levels < PYR_MAX_LEVELS) {
+		next = pow(4.0, levels + 1);
+		// deeper level must still leave a residual of at least 0.5 pixels there
+		if (2.0 * (next - 1.0) / 3.0 + next * 0.25 > var)
+			break;
+		if (((width - 1) >> (levels + 1)) + 1 < PYR_MIN_SIDE || ((height - 1) >> (levels + 1)) + 1 < PYR_MIN_SIDE)
+			break;
+		levels++;
+	}
+
+	scale = pow(4.0, levels);
+	*sigma_res = sqrt(fmax(var - 2.0 * (scale - 1.0) / 3.0, 0.0) / scale);
+	return levels;
+}
+
+static void pyr_reduce_line(const struct pyr_ctx *ctx, const float *src, uint32_t src_w, float *dst, uint32_t dst_w)
+{
+	uint32_t x, c, idx[PYR_REDUCE_TAPS];
+	float acc;
+	int t;
+
+	(void)ctx;
+	for (x = 0; x < dst_w; x++) {
+		for (t = 0; t < PYR_REDUCE_TAPS; t++)
+			idx[t] = clamp_idx((int64_t)2 * x + t - 2, src_w) * 3;
+		for (c = 0; c < 3; c++) {
+			acc = 0.0f;
+			for (t = 0; t < PYR_REDUCE_TAPS; t++)
+				acc += pyr_binomial[t] * src[idx[t] + c];
+			dst[x * 3 + c] = acc;
+		}
+	}
+}
+
+static void pyr_expand_line(const struct pyr_ctx *ctx, const float *src, uint32_t src_w, float *dst, uint32_t dst_w)
+{
+	uint32_t x, c, m, l, r;
+
+	(void)ctx;
+	for (x = 0; x < dst_w; x++) {
+		m = x / 2;
+		r = clamp_idx((int64_t)m + 1, src_w) * 3;
+		if (x % 2 == 0) {
+			l = clamp_idx((int64_t)m - 1, src_w) * 3;
+			for (c = 0; c < 3; c++)
+				dst[x * 3 + c] = (src[l + c] + 6.0f * src[m * 3 + c] + src[r + c]) * 0.125f;
+		} else {
+			for (c = 0; c < 3; c++)
+				dst[x * 3 + c] = (src[m * 3 + c] + src[r + c]) * 0.5f;
+		}
+	}
+}
+
+static void pyr_blur_line(const struct pyr_ctx *ctx, const float *src, uint32_t src_w, float *dst, uint32_t dst_w)
+{
+	int32_t radius = ctx->radius;
+	uint32_t x, c, i;
+	int32_t t;
+	float acc[3];
+
+	for (x = 0; x < dst_w; x++) {
+		acc[0] = acc[1] = acc[2] = 0.0f;
+		for (t = -radius; t <= radius; t++) {
+			i = clamp_idx((int64_t)x + t, src_w) * 3;
+			for (c = 0; c < 3; c++)
+				acc[c] += ctx->kernel[t + radius] * src[i + c];
+		}
+		memcpy(dst + x * 3, acc, sizeof(acc));
+	}
+}
+
+static int pyr_ring_init(struct pyr_ring *ring, int slots, size_t len, uint32_t src_w)
+{
+	ring->slots = slots;
+	ring->len = len;
+	ring->lines = malloc(slots * len * sizeof(float));
+	ring->tags = malloc(slots * sizeof(int64_t));
+	ring->conv = malloc((size_t)src_w * 3 * sizeof(float));
+	if (!ring->lines || !ring->tags || !ring->conv)
+		return -1;
+
+	for (int i = 0; i < slots; i++)
+		ring->tags[i] = -1;
+	return 0;
+}
+
+static void pyr_ring_free(struct pyr_ring *ring)
+{
+	free(ring->lines);
+	free(ring->tags);
+	free(ring->conv);
+}
+
+/**
+ * Returns source row `row`, filtered by `fn` into `dst_w` pixels.
+ */
+static const float *pyr_ring_get(const struct pyr_ctx *ctx, struct pyr_ring *ring, const struct pyr_plane *src, uint32_t row, pyr_line_fn fn, uint32_t dst_w)
+{
+	int slot = row % ring->slots;
+	float *line = ring->lines + slot * ring->len;
+	const float *src_row;
+	const unsigned char *px;
+	uint32_t i;
+
+	if (ring->tags[slot] == row)
+		return line;
+
+	if (src->data) {
+		src_row = src->data + (size_t)row * src->w * 3;
+	} else {
+		px = (const unsigned char *)ctx->img->input->img_pixels[clamp_idx((int64_t)row - ctx->margin, ctx->img->dim->height)];
+		for (uint32_t x = 0; x < src->w; x++) {
+			i = clamp_idx((int64_t)x - ctx->margin, ctx->img->dim->width) * 3;
+			ring->conv[x * 3 + 0] = px[i + 0];
+			ring->conv[x * 3 + 1] = px[i + 1];
+			ring->conv[x * 3 + 2] = px[i + 2];
+		}
+		src_row = ring->conv;
+	}
+
+	fn(ctx, src_row, src->w, line, dst_w);
+	ring->tags[slot] = row;
+	return line;
+}
+
+/**
+ * Destination row to compute into: the plane row itself, or `scratch` if the plane is the output image (see pyr_commit_row).
+ */
+static float *pyr_dst_row(const struct pyr_plane *dst, uint32_t y, float *scratch)
+{
+	return dst->data ? dst->data + (size_t)y * dst->w * 3 : scratch;
+}
+
+static void pyr_commit_row(const struct pyr_ctx *ctx, const struct pyr_plane *dst, uint32_t y, const float *line)
+{
+	unsigned char *px;
+
+	if (dst->data)
+		return;
+
+	px = (unsigned char *)ctx->img->output->img_pixels[y - ctx->margin];
+	line += (size_t)ctx->margin * 3;
+	for (size_t i = 0; i < (size_t)ctx->img->dim->width * 3; i++)
+		px[i] = (unsigned char)fmin(fmax(round(line[i]), 0.0), 255.0);
+}
+
+static void pyr_reduce(const struct pyr_ctx *ctx, const struct pyr_plane *src, const struct pyr_plane *dst, uint32_t start, uint32_t end, struct pyr_ring *ring)
+{
+	const float *lines[PYR_REDUCE_TAPS];
+	size_t i, len = (size_t)dst->w * 3;
+	float *out;
+	uint32_t y;
+	int t;
+
+	for (y = start; y < end; y++) {
+		for (t = 0; t < PYR_REDUCE_TAPS; t++)
+			lines[t] = pyr_ring_get(ctx, ring, src, clamp_idx((int64_t)2 * y + t - 2, src->h), pyr_reduce_line, dst->w);
+
+		out = dst->data + (size_t)y * len;
+		for (i = 0; i < len; i++)
+			out[i] = pyr_binomial[0] * lines[0][i] + pyr_binomial[1] * lines[1][i] + pyr_binomial[2] * lines[2][i] + pyr_binomial[3] * lines[3][i] +
+				 pyr_binomial[4] * lines[4][i];
+	}
+}
+
+static void pyr_expand(const struct pyr_ctx *ctx, const struct pyr_plane *src, const struct pyr_plane *dst, uint32_t start, uint32_t end, struct pyr_ring *ring,
+		       float *scratch)
+{
+	const float *a, *b, *c;
+	size_t i, len = (size_t)dst->w * 3;
+	uint32_t y, m;
+	float *out;
+
+	for (y = start; y < end; y++) {
+		m = y / 2;
+		out = pyr_dst_row(dst, y, scratch);
+		b = pyr_ring_get(ctx, ring, src, m, pyr_expand_line, dst->w);
+		c = pyr_ring_get(ctx, ring, src, clamp_idx((int64_t)m + 1, src->h), pyr_expand_line, dst->w);
+		if (y % 2 == 0) {
+			a = pyr_ring_get(ctx, ring, src, clamp_idx((int64_t)m - 1, src->h), pyr_expand_line, dst->w);
+			for (i = 0; i < len; i++)
+				out[i] = (a[i] + 6.0f * b[i] + c[i]) * 0.125f;
+		} else {
+			for (i = 0; i < len; i++)
+				out[i] = (b[i] + c[i]) * 0.5f;
+		}
+		pyr_commit_row(ctx, dst, y, out);
+	}
+}
+
+static void pyr_blur(const struct pyr_ctx *ctx, const struct pyr_plane *src, const struct pyr_plane *dst, uint32_t start, uint32_t end, struct pyr_ring *ring)
+{
+	int32_t radius = ctx->radius;
+	size_t i, len = (size_t)dst->w * 3;
+	const float *line;
+	float *out;
+	uint32_t y;
+	int32_t t;
+
+	for (y = start; y < end; y++) {
+		out = dst->data + (size_t)y * len;
+		memset(out, 0, len * sizeof(float));
+		for (t = -radius; t <= radius; t++) {
+			line = pyr_ring_get(ctx, ring, src, clamp_idx((int64_t)y + t, src->h), pyr_blur_line, dst->w);
+			for (i = 0; i < len; i++)
+				out[i] += ctx->kernel[t + radius] * line[i];
+		}
+	}
+}
+
+static void pyr_phase_run(void *arg, int phase, int tid, int nthreads)
+{
+	struct pyr_ctx *ctx = (struct pyr_ctx *)arg;
+	const struct pyr_plane *src, *dst;
+	struct pyr_ring ring = { 0 };
+	float *scratch = NULL;
+	uint32_t start, end;
+	int levels = ctx->levels, k, slots;
+
+	if (__atomic_load_n(&ctx->error, __ATOMIC_ACQUIRE))
+		return;
+
+	if (phase < levels) {
+		src = &ctx->lv[phase];
+		dst = &ctx->lv[phase + 1];
+		slots = PYR_REDUCE_TAPS;
+	} else if (phase == levels) {
+		src = &ctx->lv[levels];
+		dst = &ctx->res;
+		slots = 2 * ctx->radius + 1;
+	} else {
+		// expand back to level k; without levels the residual is just stored into the output
+		k = levels ? 2 * levels - phase : 0;
+		src = (k + 1 >= levels) ? &ctx->res : &ctx->lv[k + 1];
+		dst = &ctx->lv[k];
+		slots = PYR_EXPAND_ROWS;
+	}
+
+	if (dst->data) {
+		start = (uint32_t)((uint64_t)dst->h * tid / nthreads);
+		end = (uint32_t)((uint64_t)dst->h * (tid + 1) / nthreads);
+	} else {
+		// only the visible rows of level 0 are written
+		start = ctx->margin + (uint32_t)((uint64_t)ctx->img->dim->height * tid / nthreads);
+		end = ctx->margin + (uint32_t)((uint64_t)ctx->img->dim->height * (tid + 1) / nthreads);
+	}
+	if (start >= end)
+		return;
+
+	if (!levels && phase > levels) {
+		// a 1x1 expand would still blur, copy the residual instead
+		for (uint32_t y = start; y < end; y++)
+			pyr_commit_row(ctx, dst, y, ctx->res.data + (size_t)y * dst->w * 3);
+		return;
+	}
+
+	scratch = malloc((size_t)dst->w * 3 * sizeof(float));
+	if (!scratch || pyr_ring_init(&ring, slots, (size_t)dst->w * 3, src->w) < 0) {
+		log_error("Failed to allocate pyramid line buffers (thread %d).", tid);
+		__atomic_store_n(&ctx->error, 1, __ATOMIC_RELEASE);
+		goto cleanup;
+	}
+
+	if (phase < levels)
+		pyr_reduce(ctx, src, dst, start, end, &ring);
+	else if (phase == levels)
+		pyr_blur(ctx, src, dst, start, end, &ring);
+	else
+		pyr_expand(ctx, src, dst, start, end, &ring, scratch);
+
+cleanup:
+	pyr_ring_free(&ring);
+	free(scratch);
+}
+
+static int pyr_init_kernel(struct pyr_ctx *ctx, double sigma_res)
+{
+	double sum = 0.0;
+	int i;
+
+	ctx->radius = sigma_res < 0.1 ? 0 : (int)ceil(3.0 * sigma_res);
+	ctx->kernel = malloc((2 * ctx->radius + 1) * sizeof(float));
+	if (!ctx->kernel)
+		return -1;
+
+	for (i = -ctx->radius; i <= ctx->radius; i++)
+		sum += ctx->radius ? exp(-(double)i * i / (2.0 * sigma_res * sigma_res)) : 1.0;
+	for (i = -ctx->radius; i <= ctx->radius; i++)
+		ctx->kernel[i + ctx->radius] = (float)((ctx->radius ? exp(-(double)i * i / (2.0 * sigma_res * sigma_res)) : 1.0) / sum);
+	return 0;
+}
+
+int pyramid_blur_apply(int threadnum, struct img_spec *img_spec, double sigma)
+{
+	struct pyr_ctx ctx = { 0 };
+	double sigma_res;
+	int k, phases, rc = -1;
+
+	ctx.img = img_spec;
+	ctx.levels = pyramid_get_levels(sigma, img_spec->dim->width, img_spec->dim->height, &sigma_res);
+	// 3 sigma of clamped border, rounded to the coarsest sampling step so the sample grid stays aligned to the image
+	if (ctx.levels)
+		ctx.margin = ((uint32_t)ceil(3.0 * sigma) + (1u << ctx.levels) - 1) >> ctx.levels << ctx.levels;
+	ctx.lv[0] = (struct pyr_plane){ NULL, img_spec->dim->width + 2 * ctx.margin, img_spec->dim->height + 2 * ctx.margin };
+
+	for (k = 1; k <= ctx.levels; k++) {
+		ctx.lv[k].w = (ctx.lv[k - 1].w + 1) / 2;
+		ctx.lv[k].h = (ctx.lv[k - 1].h + 1) / 2;
+		ctx.lv[k].data = malloc((size_t)ctx.lv[k].w * ctx.lv[k].h * 3 * sizeof(float));
+		if (!ctx.lv[k].data)
+			goto mem_err;
+	}
+
+	ctx.res.w = ctx.lv[ctx.levels].w;
+	ctx.res.h = ctx.lv[ctx.levels].h;
+	ctx.res.data = malloc((size_t)ctx.res.w * ctx.res.h * 3 * sizeof(float));
+	if (!ctx.res.data || pyr_init_kernel(&ctx, sigma_res) < 0)
+		goto mem_err;
+
+	log_debug("Pyramid blur sigma=%.3f: %d levels, margin %u, residual sigma=%.3f (radius %d) at %ux%u", sigma, ctx.levels, ctx.margin, sigma_res, ctx.radius,
+		  ctx.res.w, ctx.res.h);
+
+	// reduce to every level, residual blur, expand back (or store the residual if there are no levels)
+	phases = 2 * ctx.levels + 1 + (ctx.levels == 0);
+	rc = run_phased_parallel(threadnum, phases, pyr_phase_run, &ctx);
+	if (!rc && ctx.error)
+		rc = -1;
+	goto cleanup;
+
+mem_err:
+	log_error("Failed to allocate pyramid levels (%ux%u, %d levels).", img_spec->dim->width, img_spec->dim->height, ctx.levels);
+
+cleanup:
+	for (k = 1; k <= ctx.levels; k++)
+		free(ctx.lv[k].data);
+	free(ctx.res.data);
+	free(ctx.kernel);
+	return rc;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "libbmp/libbmp.h"
+#include "utils/threads-general.h"
+
+#define PYR_MAX_LEVELS 12
+#define PYR_MIN_SIDE 8 // coarsest level is never smaller than this in either direction
+
+/**
+ * Chooses the pyramid depth for a blur of the given sigma.
+ * Every REDUCE (5-tap binomial, then drop every second pixel) and every EXPAND step adds a blur of variance 4^k
+ * (in full resolution pixels) at level k, so L levels down and up give 2 * (4^L - 1) / 3.
+ * The deepest L leaving a non-negative residual is taken; the rest is applied as a small Gaussian at level L.
+ *
+ * @param sigma Target Gaussian standard deviation in pixels.
+ * @param width Image width.
+ * @param height Image height.
+ * @param sigma_res Output: residual Gaussian sigma, in level L pixels (below sqrt(3)).
+ *
+ * @return Number of levels L.
+ */
+int pyramid_get_levels(double sigma, uint32_t width, uint32_t height, double *sigma_res);
+
+/**
+ * Approximates a Gaussian blur with a large sigma through a Gaussian pyramid: the image is reduced L times,
+ * blurred with the residual kernel at the coarsest level and expanded back.
+ * Work is O(pixels) with a small constant, whatever the sigma. Levels are kept in float.
+ *
+ * Each level is one phase of run_phased_parallel(): rows of the destination level are split into bands, one per thread,
+ * and every thread keeps a small ring of horizontally filtered source rows. Input and output may be the same image.
+ *
+ * @param threadnum Number of threads to use.
+ * @param img_spec Image spec (input, output and dimensions).
+ * @param sigma Gaussian standard deviation in pixels.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int pyramid_blur_apply(int threadnum, struct img_spec *img_spec, double sigma);
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "tiled-conv.h"
+#include "logger/log.h"
+#include "utils/hw-info.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void tiled_get_tile_dims(int ksize, uint32_t *tile_w, uint32_t *tile_h)
+{
+	size_t l1 = hw_get_l1d_cache_size();
+	size_t l2 = hw_get_l2_cache_size();
+	size_t halo = ksize - 1;
+	size_t tw, th;
+
+	// half of the cache is left for the kernel, output rows and everything else
+	tw = l1 / 2 / (ksize * sizeof(bmp_pixel));
+	tw = (tw > halo + TILE_MIN_SIDE) ? tw - halo : TILE_MIN_SIDE;
+
+	th = l2 / 2 / ((tw + halo) * sizeof(bmp_pixel));
+	th = (th > halo + TILE_MIN_SIDE) ? th - halo : TILE_MIN_SIDE;
+
+	*tile_w = (uint32_t)tw;
+	*tile_h = (uint32_t)th;
+}
+
+/**
+ * Copies rows [y0 - pad, y1 + pad) and columns [x0 - pad, x1 + pad) of the input image into `stage`,
+ * replacing out-of-bounds pixels with the nearest border ones.
+ */
+static void stage_tile(bmp_pixel *stage, bmp_pixel **input, const struct img_dim *dim, int32_t y0, int32_t y1, int32_t x0, int32_t x1, int32_t pad)
+{
+	int32_t stage_w = x1 - x0 + 2 * pad;
+	int32_t src_x0 = max(x0 - pad, 0);
+	int32_t src_x1 = min(x1 + pad, (int32_t)dim->width);
+	int32_t left = src_x0 - (x0 - pad);
+	int32_t right = (x1 + pad) - src_x1;
+	int32_t sy, row, i;
+	bmp_pixel *dst;
+	const bmp_pixel *src;
+
+	for (sy = y0 - pad; sy < y1 + pad; sy++) {
+		row = min(max(sy, 0), (int32_t)dim->height - 1);
+		src = input[row];
+		dst = stage + (size_t)(sy - (y0 - pad)) * stage_w;
+
+		for (i = 0; i < left; i++)
+			dst[i] = src[0];
+		memcpy(dst + left, src + src_x0, (src_x1 - src_x0) * sizeof(bmp_pixel));
+		for (i = 0; i < right; i++)
+			dst[stage_w - right + i] = src[dim->width - 1];
+	}
+}
+
+static inline unsigned char finalize_channel(double acc, const struct filter *cfilter)
+{
+	return (unsigned char)fmin(fmax(round(acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+}
+
+static void convolve_tile(const bmp_pixel *stage, bmp_pixel **output, const double *weights, const struct filter *cfilter, int32_t y0, int32_t y1, int32_t x0,
+			  int32_t x1)
+{
+	int32_t ksize = cfilter->size;
+	int32_t stage_w = x1 - x0 + ksize - 1;
+	int32_t x, y, filterX, filterY;
+	double red_acc, green_acc, blue_acc;
+	const bmp_pixel *src;
+	const double *wrow;
+	bmp_pixel *dst;
+
+	for (y = 0; y < y1 - y0; y++) {
+		dst = output[y0 + y] + x0;
+		for (x = 0; x < x1 - x0; x++) {
+			red_acc = 0.0;
+			green_acc = 0.0;
+			blue_acc = 0.0;
+
+			for (filterY = 0; filterY < ksize; filterY++) {
+				src = stage + (size_t)(y + filterY) * stage_w + x;
+				wrow = weights + filterY * ksize;
+				for (filterX = 0; filterX < ksize; filterX++) {
+					red_acc += src[filterX].red * wrow[filterX];
+					green_acc += src[filterX].green * wrow[filterX];
+					blue_acc += src[filterX].blue * wrow[filterX];
+				}
+			}
+
+			dst[x].red = finalize_channel(red_acc, cfilter);
+			dst[x].green = finalize_channel(green_acc, cfilter);
+			dst[x].blue = finalize_channel(blue_acc, cfilter);
+		}
+	}
+}
+
+void apply_filter_tiled(struct thread_spec *spec, struct filter cfilter)
+{
+	struct img_dim *dim = spec->img->dim;
+	int32_t pad = cfilter.size / 2;
+	uint32_t tile_w, tile_h;
+	int32_t ty, tx, ty1, tx1;
+	bmp_pixel *stage = NULL;
+	double *weights = NULL;
+
+	if (spec->end_row <= spec->start_row || spec->end_column <= spec->start_column)
+		return;
+
+	tiled_get_tile_dims(cfilter.size, &tile_w, &tile_h);
+	tile_w = min(tile_w, (uint32_t)(spec->end_column - spec->start_column));
+	tile_h = min(tile_h, (uint32_t)(spec->end_row - spec->start_row));
+
+	stage = malloc((size_t)(tile_w + 2 * pad) * (tile_h + 2 * pad) * sizeof(bmp_pixel));
+	weights = malloc((size_t)cfilter.size * cfilter.size * sizeof(double));
+	if (!stage || !weights) {
+		log_error("Failed to allocate tile staging buffer, falling back to direct convolution.");
+		apply_filter(spec, cfilter);
+		goto cleanup;
+	}
+
+	for (int i = 0; i < cfilter.size; i++)
+		memcpy(weights + i * cfilter.size, cfilter.filter_arr[i], cfilter.size * sizeof(double));
+
+	log_trace("Applying tiled filter size %d (tile %ux%u) to region R[%u-%u) C[%u-%u)", cfilter.size, tile_w, tile_h, spec->start_row, spec->end_row,
+		  spec->start_column, spec->end_column);
+
+	for (ty = spec->start_row; ty < (int32_t)spec->end_row; ty += tile_h) {
+		ty1 = min(ty + (int32_t)tile_h, (int32_t)spec->end_row);
+		for (tx = spec->start_column; tx < (int32_t)spec->end_column; tx += tile_w) {
+			tx1 = min(tx + (int32_t)tile_w, (int32_t)spec->end_column);
+			stage_tile(stage, spec->img->input->img_pixels, dim, ty, ty1, tx, tx1, pad);
+			convolve_tile(stage, spec->img->output->img_pixels, weights, &cfilter, ty, ty1, tx, tx1);
+		}
+	}
+
+cleanup:
+	free(stage);
+	free(weights);
+}
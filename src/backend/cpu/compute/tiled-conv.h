@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "utils/threads-general.h"
+
+#define TILE_MIN_SIDE 16
+
+/**
+ * Computes the output tile size for a kernel of the given size.
+ * Tile width is chosen so that the `ksize` staged rows feeding one output row stay in half of L1d,
+ * tile height so that the whole staged tile (tile + halo) fits into half of L2.
+ *
+ * @param ksize Kernel side length.
+ * @param tile_w Output: tile width in pixels.
+ * @param tile_h Output: tile height in pixels.
+ */
+void tiled_get_tile_dims(int ksize, uint32_t *tile_w, uint32_t *tile_h);
+
+/**
+ * Cache-blocked variant of apply_filter().
+ * The region from `spec` is split into 2D tiles (see tiled_get_tile_dims), every tile together with its halo
+ * is copied into a contiguous buffer (border clamping is resolved during that copy) and the kernel is run on the buffer.
+ * Accumulation order matches apply_filter(), so the result is bit-identical to it.
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ * @param cfilter The filter structure containing the kernel matrix, size, bias, and factor.
+ */
+void apply_filter_tiled(struct thread_spec *spec, struct filter cfilter);
@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "uniform.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include "utils/stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint8_t same_pixel(bmp_pixel a, bmp_pixel b)
+{
+	return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+static uint8_t tile_is_flat(bmp_pixel **pixels, uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1)
+{
+	bmp_pixel colour = pixels[y0][x0];
+
+	for (uint32_t y = y0; y < y1; y++)
+		for (uint32_t x = x0; x < x1; x++)
+			if (!same_pixel(pixels[y][x], colour))
+				return 0;
+	return 1;
+}
+
+/**
+ * Splits the pixel range [lo, hi) of a line of `n` pixels into in-bounds tile index ranges: out-of-bounds pixels are clamped
+ * to the border or, with `wrap`, taken from the opposite side (like the filter itself resolves them).
+ *
+ * @return Number of [first, last] tile ranges stored in `ranges` (at most 3).
+ */
+static int halo_tile_ranges(int64_t lo, int64_t hi, uint32_t n, uint8_t wrap, uint32_t ranges[3][2])
+{
+	uint32_t last = (n - 1) / UNIFORM_TILE;
+	int cnt = 0;
+
+	if (!wrap || hi - lo >= n) {
+		if (wrap) {
+			lo = 0;
+			hi = n;
+		}
+		ranges[0][0] = (uint32_t)max(lo, 0) / UNIFORM_TILE;
+		ranges[0][1] = (uint32_t)min(hi - 1, (int64_t)n - 1) / UNIFORM_TILE;
+		return 1;
+	}
+
+	if (lo < 0) {
+		ranges[cnt][0] = (uint32_t)(lo + n) / UNIFORM_TILE;
+		ranges[cnt++][1] = last;
+		lo = 0;
+	}
+	if (hi > n) {
+		ranges[cnt][0] = 0;
+		ranges[cnt++][1] = (uint32_t)(hi - n - 1) / UNIFORM_TILE;
+		hi = n;
+	}
+	ranges[cnt][0] = (uint32_t)lo / UNIFORM_TILE;
+	ranges[cnt++][1] = (uint32_t)(hi - 1) / UNIFORM_TILE;
+	return cnt;
+}
+
+/**
+ * Result of the filter over a window of `colour` only. Convolution filters are evaluated tap by tap,
+ * in the same order as apply_filter(), so a skipped pixel is bit-identical to a computed one.
+ */
+static bmp_pixel uniform_value(const struct filter *cfilter, bmp_pixel colour)
+{
+	double red_acc = 0.0, green_acc = 0.0, blue_acc = 0.0, weight;
+	bmp_pixel res;
+
+	// median and min/max of a single colour are that colour
+	if (!cfilter)
+		return colour;
+
+	for (int filterY = 0; filterY < cfilter->size; filterY++) {
+		for (int filterX = 0; filterX < cfilter->size; filterX++) {
+			weight = cfilter->filter_arr[filterY][filterX];
+			red_acc += colour.red * weight;
+			green_acc += colour.green * weight;
+			blue_acc += colour.blue * weight;
+		}
+	}
+
+	res.red = (unsigned char)fmin(fmax(round(red_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+	res.green = (unsigned char)fmin(fmax(round(green_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+	res.blue = (unsigned char)fmin(fmax(round(blue_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+	return res;
+}
+
+/**
+ * Tells whether every tile of the halo-extended neighbourhood of tile (ty, tx) is flat with the colour of the tile itself.
+ */
+static uint8_t halo_is_uniform(const struct uniform_map *map, const uint8_t *flat, const bmp_pixel *colour, const struct img_dim *dim, uint32_t ty, uint32_t tx,
+			       int32_t pad, uint8_t wrap)
+{
+	uint32_t rows[3][2], cols[3][2];
+	int row_cnt, col_cnt, r, c;
+	bmp_pixel own = colour[ty * map->tiles_x + tx];
+	int64_t y0 = (int64_t)ty * UNIFORM_TILE, x0 = (int64_t)tx * UNIFORM_TILE;
+	size_t idx;
+
+	row_cnt = halo_tile_ranges(y0 - pad, min(y0 + UNIFORM_TILE, dim->height) + pad, dim->height, wrap, rows);
+	col_cnt = halo_tile_ranges(x0 - pad, min(x0 + UNIFORM_TILE, dim->width) + pad, dim->width, wrap, cols);
+
+	for (r = 0; r < row_cnt; r++) {
+		for (uint32_t y = rows[r][0]; y <= rows[r][1]; y++) {
+			for (c = 0; c < col_cnt; c++) {
+				for (uint32_t x = cols[c][0]; x <= cols[c][1]; x++) {
+					idx = (size_t)y * map->tiles_x + x;
+					if (!flat[idx] || !same_pixel(colour[idx], own))
+						return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int uniform_map_attach(struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters)
+{
+	const char *filter_type = args->compute_cfg.filter_type;
+	struct img_dim *dim = img_spec->dim;
+	bmp_pixel **pixels = img_spec->input->img_pixels;
+	struct uniform_map *map = NULL;
+	struct filter *cfilter = NULL;
+	uint8_t *flat = NULL;
+	bmp_pixel *colour = NULL;
+	uint8_t wrap = filter_wraps_borders(filter_type);
+	int32_t window = get_filter_window_size(filters, filter_type);
+	uint64_t skipped = 0;
+	size_t tiles, idx;
+	uint32_t tx, ty;
+
+	if (window == 0) {
+		log_error("Uniform skip: no window size for filter '%s'.", filter_type);
+		return -1;
+	}
+	cfilter = get_filter_by_name(filters, filter_type);
+
+	map = calloc(1, sizeof(*map));
+	if (!map) {
+		log_error("Failed to allocate uniform map.");
+		return -1;
+	}
+	map->tiles_x = (dim->width + UNIFORM_TILE - 1) / UNIFORM_TILE;
+	map->tiles_y = (dim->height + UNIFORM_TILE - 1) / UNIFORM_TILE;
+	tiles = (size_t)map->tiles_x * map->tiles_y;
+
+	map->skip = calloc(tiles, sizeof(*map->skip));
+	map->value = malloc(tiles * sizeof(*map->value));
+	flat = malloc(tiles * sizeof(*flat));
+	colour = malloc(tiles * sizeof(*colour));
+	if (!map->skip || !map->value || !flat || !colour) {
+		log_error("Failed to allocate uniform map.");
+		goto err;
+	}
+
+	for (ty = 0; ty < map->tiles_y; ty++) {
+		for (tx = 0; tx < map->tiles_x; tx++) {
+			idx = (size_t)ty * map->tiles_x + tx;
+			colour[idx] = pixels[ty * UNIFORM_TILE][tx * UNIFORM_TILE];
+			flat[idx] = tile_is_flat(pixels, ty * UNIFORM_TILE, min((ty + 1) * UNIFORM_TILE, dim->height), tx * UNIFORM_TILE,
+						 min((tx + 1) * UNIFORM_TILE, dim->width));
+		}
+	}
+
+	for (ty = 0; ty < map->tiles_y; ty++) {
+		for (tx = 0; tx < map->tiles_x; tx++) {
+			idx = (size_t)ty * map->tiles_x + tx;
+			if (!flat[idx] || !halo_is_uniform(map, flat, colour, dim, ty, tx, window / 2, wrap))
+				continue;
+			map->skip[idx] = 1;
+			map->value[idx] = uniform_value(cfilter, colour[idx]);
+			skipped += (uint64_t)(min((ty + 1) * UNIFORM_TILE, dim->height) - ty * UNIFORM_TILE) * (min((tx + 1) * UNIFORM_TILE, dim->width) - tx * UNIFORM_TILE);
+		}
+	}
+
+	log_debug("Uniform map %ux%u tiles: %llu of %llu pixels in skippable tiles", map->tiles_x, map->tiles_y, (unsigned long long)skipped,
+		  (unsigned long long)dim->width * dim->height);
+	stats_add(&run_stats.uniform_total_px, (uint64_t)dim->width * dim->height);
+
+	free(flat);
+	free(colour);
+	img_spec->uniform = map;
+	return 0;
+
+err:
+	free(flat);
+	free(colour);
+	free(map->skip);
+	free(map->value);
+	free(map);
+	return -1;
+}
+
+void uniform_map_detach(struct img_spec *img_spec)
+{
+	struct uniform_map *map = img_spec->uniform;
+
+	if (!map)
+		return;
+
+	free(map->skip);
+	free(map->value);
+	free(map);
+	img_spec->uniform = NULL;
+}
+
+static void fill_tile_part(struct thread_spec *spec, bmp_pixel value, uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1)
+{
+	bmp_pixel **output = spec->img->output->img_pixels;
+	unsigned char *gray = spec->img->gray_output;
+
+	if (gray) { // value of a gray tile is gray as well
+		for (uint32_t y = y0; y < y1; y++)
+			memset(gray + (size_t)y * spec->img->dim->width + x0, value.red, x1 - x0);
+		return;
+	}
+
+	for (uint32_t y = y0; y < y1; y++)
+		for (uint32_t x = x0; x < x1; x++)
+			output[y][x] = value;
+}
+
+static uint8_t region_has_skip(const struct uniform_map *map, const struct thread_spec *spec)
+{
+	uint32_t tx_first = spec->start_column / UNIFORM_TILE, tx_last = (spec->end_column - 1) / UNIFORM_TILE;
+
+	for (uint32_t ty = spec->start_row / UNIFORM_TILE; ty <= (uint32_t)(spec->end_row - 1) / UNIFORM_TILE; ty++)
+		for (uint32_t tx = tx_first; tx <= tx_last; tx++)
+			if (map->skip[(size_t)ty * map->tiles_x + tx])
+				return 1;
+	return 0;
+}
+
+void uniform_part_computation(struct thread_spec *spec, void (*compute)(struct thread_spec *spec))
+{
+	const struct uniform_map *map = spec->img->uniform;
+	struct thread_spec sub = *spec;
+	uint32_t y0, y1, x0, x1, ty, tx, run_start;
+	uint64_t skipped = 0;
+	size_t idx;
+
+	if (spec->start_row >= spec->end_row || spec->start_column >= spec->end_column)
+		return;
+
+	if (!region_has_skip(map, spec)) {
+		compute(spec);
+		return;
+	}
+
+	for (y0 = spec->start_row; y0 < spec->end_row; y0 = y1) {
+		ty = y0 / UNIFORM_TILE;
+		y1 = min((ty + 1) * UNIFORM_TILE, spec->end_row);
+		sub.start_row = y0;
+		sub.end_row = y1;
+		run_start = spec->start_column;
+
+		for (x0 = spec->start_column; x0 < spec->end_column; x0 = x1) {
+			tx = x0 / UNIFORM_TILE;
+			x1 = min((tx + 1) * UNIFORM_TILE, spec->end_column);
+			idx = (size_t)ty * map->tiles_x + tx;
+			if (!map->skip[idx])
+				continue;
+
+			if (run_start < x0) {
+				sub.start_column = run_start;
+				sub.end_column = x0;
+				compute(&sub);
+			}
+			fill_tile_part(spec, map->value[idx], y0, y1, x0, x1);
+			skipped += (uint64_t)(y1 - y0) * (x1 - x0);
+			run_start = x1;
+		}
+
+		if (run_start < spec->end_column) {
+			sub.start_column = run_start;
+			sub.end_column = spec->end_column;
+			compute(&sub);
+		}
+	}
+
+	stats_add(&run_stats.uniform_skipped_px, skipped);
+}
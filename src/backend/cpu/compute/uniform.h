@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "libbmp/libbmp.h"
+#include "utils/filters.h"
+#include "utils/threads-general.h"
+
+#define UNIFORM_TILE 32
+
+/**
+ * Per-tile map of the flat areas of one image (--uniform-skip=1).
+ * A tile is skipped if every pixel the filter reads for any of its pixels (tile + halo) has the same colour,
+ * its result is then that colour pushed through the filter once.
+ */
+struct uniform_map {
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+	uint8_t *skip; // tiles_y * tiles_x flags
+	bmp_pixel *value; // result of a skipped tile
+};
+
+/**
+ * Builds the uniform map of `img_spec->input` for the current filter and attaches it to `img_spec->uniform`.
+ * One pass over the image; a tile's scan stops at its first pixel that differs from the tile's first one.
+ *
+ * @param img_spec Image spec, its input must not be modified before the computation.
+ * @param args Pointer to the p_args structure (filter type).
+ * @param filters Pointer to the filter_mix structure.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int uniform_map_attach(struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters);
+
+/**
+ * Frees the uniform map of `img_spec`, if any.
+ */
+void uniform_map_detach(struct img_spec *img_spec);
+
+/**
+ * Computes the region of `spec`: skipped tiles are filled with their value, the rest is passed to `compute`
+ * as runs of consecutive non-skipped tiles, one tile row at a time. Regions without skipped tiles go to `compute` whole.
+ * Skipped pixels are counted in run_stats.
+ *
+ * @param spec Pointer to the thread_spec structure, `spec->img->uniform` must be set.
+ * @param compute Filter engine for the non-uniform parts.
+ */
+void uniform_part_computation(struct thread_spec *spec, void (*compute)(struct thread_spec *spec));
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "winograd.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * F(2x2, 3x3) with transforms scaled to integers:
+ *   Y = A^T [ (G' g G'^T) . (B^T d B) ] A / 4,   G' = 2G
+ *
+ *   B^T = | 1  0 -1  0 |    G' = | 2  0  0 |    A^T = | 1  1  1  0 |
+ *         | 0  1  1  0 |         | 1  1  1 |          | 0  1 -1 -1 |
+ *         | 0 -1  1  0 |         | 1 -1  1 |
+ *         | 0  1  0 -1 |         | 0  0  2 |
+ *
+ * `d` is the 4x4 input tile, `g` the kernel as stored in filter_arr (correlation, like apply_filter).
+ */
+
+#define WINOGRAD_TILE 2
+
+struct winograd_region {
+	bmp_pixel *const *in; // in[i] is image row in_base + i
+	int32_t in_base;
+	bmp_pixel *const *out; // out[i] is image row out_base + i
+	int32_t out_base;
+	int32_t width, height;
+	int32_t y0, y1, x0, x1;
+};
+
+uint8_t winograd_supported(const struct filter *cfilter)
+{
+	double w;
+
+	if (!cfilter || cfilter->size != 3 || !cfilter->filter_arr)
+		return 0;
+
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			w = cfilter->filter_arr[i][j];
+			if (w != nearbyint(w) || fabs(w) > WINOGRAD_MAX_WEIGHT)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Computes U' = G' g G'^T (4 * the classic kernel transform), row-major 4x4.
+ */
+static void winograd_transform_kernel(const struct filter *cfilter, int32_t *U)
+{
+	int32_t g[3][3], t[4][3];
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			g[i][j] = (int32_t)cfilter->filter_arr[i][j];
+
+	for (j = 0; j < 3; j++) {
+		t[0][j] = 2 * g[0][j];
+		t[1][j] = g[0][j] + g[1][j] + g[2][j];
+		t[2][j] = g[0][j] - g[1][j] + g[2][j];
+		t[3][j] = 2 * g[2][j];
+	}
+
+	for (i = 0; i < 4; i++) {
+		U[i * 4 + 0] = 2 * t[i][0];
+		U[i * 4 + 1] = t[i][0] + t[i][1] + t[i][2];
+		U[i * 4 + 2] = t[i][0] - t[i][1] + t[i][2];
+		U[i * 4 + 3] = 2 * t[i][2];
+	}
+}
+
+static inline unsigned char winograd_finalize(int32_t acc4, const struct filter *cfilter)
+{
+	// acc4 is exactly 4 * (sum of pixel * weight)
+	return (unsigned char)fmin(fmax(round((double)(acc4 / 4) * cfilter->factor + cfilter->bias), 0.0), 255.0);
+}
+
+static inline void winograd_store(struct winograd_region *r, int32_t y, int32_t x, int32_t ch, int32_t acc4, const struct filter *cfilter)
+{
+	if (y < r->y1 && x < r->x1)
+		((unsigned char *)&r->out[y - r->out_base][x])[ch] = winograd_finalize(acc4, cfilter);
+}
+
+/**
+ * Runs the tiles of one pair of output rows [y, y + 2).
+ * The vertical half of the input transform (B^T d) is computed once per staged column and shared by the two tiles overlapping it.
+ * `vt` holds 4 lines of `cols * 3` values.
+ */
+static void winograd_row_pair(struct winograd_region *r, int32_t y, const int32_t *U, const struct filter *cfilter, int32_t *vt, int32_t cols)
+{
+	const unsigned char *src[4];
+	int32_t *v0 = vt, *v1 = vt + cols * 3, *v2 = vt + 2 * cols * 3, *v3 = vt + 3 * cols * 3;
+	int32_t i, k, ch, sx, row, x, idx;
+	int32_t d0, d1, d2, d3, m[4][4], t0[4], t1[4];
+
+	for (k = 0; k < 4; k++) {
+		// rows past the region's last halo row are only read for outputs that are dropped, keep them inside it
+		row = min(max(y - 1 + k, 0), r->height - 1);
+		row = min(row, r->y1);
+		src[k] = (const unsigned char *)r->in[row - r->in_base];
+	}
+
+	for (i = 0; i < cols; i++) {
+		sx = min(max(r->x0 - 1 + i, 0), r->width - 1) * 3;
+		for (ch = 0; ch < 3; ch++) {
+			d0 = src[0][sx + ch];
+			d1 = src[1][sx + ch];
+			d2 = src[2][sx + ch];
+			d3 = src[3][sx + ch];
+			v0[i * 3 + ch] = d0 - d2;
+			v1[i * 3 + ch] = d1 + d2;
+			v2[i * 3 + ch] = d2 - d1;
+			v3[i * 3 + ch] = d1 - d3;
+		}
+	}
+
+	for (x = r->x0; x < r->x1; x += WINOGRAD_TILE) {
+		for (ch = 0; ch < 3; ch++) {
+			idx = (x - r->x0) * 3 + ch;
+			for (k = 0; k < 4; k++) {
+				const int32_t *v = vt + k * cols * 3 + idx;
+				const int32_t *u = U + k * 4;
+				m[k][0] = u[0] * (v[0] - v[6]);
+				m[k][1] = u[1] * (v[3] + v[6]);
+				m[k][2] = u[2] * (v[6] - v[3]);
+				m[k][3] = u[3] * (v[3] - v[9]);
+			}
+			for (k = 0; k < 4; k++) {
+				t0[k] = m[0][k] + m[1][k] + m[2][k];
+				t1[k] = m[1][k] - m[2][k] - m[3][k];
+			}
+
+			winograd_store(r, y, x, ch, t0[0] + t0[1] + t0[2], cfilter);
+			winograd_store(r, y, x + 1, ch, t0[1] - t0[2] - t0[3], cfilter);
+			winograd_store(r, y + 1, x, ch, t1[0] + t1[1] + t1[2], cfilter);
+			winograd_store(r, y + 1, x + 1, ch, t1[1] - t1[2] - t1[3], cfilter);
+		}
+	}
+}
+
+static int winograd_run(struct winograd_region *r, const struct filter *cfilter)
+{
+	int32_t U[16];
+	int32_t cols = (r->x1 - r->x0 + WINOGRAD_TILE - 1) / WINOGRAD_TILE * WINOGRAD_TILE + 2;
+	int32_t *vt = NULL;
+
+	vt = malloc((size_t)4 * cols * 3 * sizeof(int32_t));
+	if (!vt) {
+		log_error("Failed to allocate Winograd transform buffer.");
+		return -1;
+	}
+
+	winograd_transform_kernel(cfilter, U);
+	for (int32_t y = r->y0; y < r->y1; y += WINOGRAD_TILE)
+		winograd_row_pair(r, y, U, cfilter, vt, cols);
+
+	free(vt);
+	return 0;
+}
+
+void apply_filter_winograd(struct thread_spec *spec, struct filter cfilter)
+{
+	struct winograd_region r;
+
+	if (spec->end_row - spec->start_row < WINOGRAD_TILE || spec->end_column - spec->start_column < WINOGRAD_TILE || !winograd_supported(&cfilter)) {
+		apply_filter(spec, cfilter);
+		return;
+	}
+
+	r.in = spec->img->input->img_pixels;
+	r.in_base = 0;
+	r.out = spec->img->output->img_pixels;
+	r.out_base = 0;
+	r.width = spec->img->dim->width;
+	r.height = spec->img->dim->height;
+	r.y0 = spec->start_row;
+	r.y1 = spec->end_row;
+	r.x0 = spec->start_column;
+	r.x1 = spec->end_column;
+
+	log_trace("Applying Winograd F(2x2,3x3) to region R[%u-%u) C[%u-%u)", r.y0, r.y1, r.x0, r.x1);
+
+	if (winograd_run(&r, &cfilter) < 0)
+		apply_filter(spec, cfilter);
+}
+
+int winograd_apply_buffer(const unsigned char *input, uint32_t in_first_row, uint32_t in_rows, unsigned char *output, uint32_t out_first_row, uint32_t out_rows,
+			  size_t row_stride, const struct img_dim *dim, const struct filter *cfilter)
+{
+	struct winograd_region r;
+	bmp_pixel **in = NULL, **out = NULL;
+	uint32_t i;
+	int rc = -1;
+
+	if (!winograd_supported(cfilter) || out_rows == 0)
+		return -1;
+
+	in = malloc(in_rows * sizeof(bmp_pixel *));
+	out = malloc(out_rows * sizeof(bmp_pixel *));
+	if (!in || !out) {
+		log_error("Failed to allocate Winograd row tables.");
+		goto cleanup;
+	}
+
+	for (i = 0; i < in_rows; i++)
+		in[i] = (bmp_pixel *)(input + i * row_stride);
+	for (i = 0; i < out_rows; i++)
+		out[i] = (bmp_pixel *)(output + i * row_stride);
+
+	r.in = in;
+	r.in_base = in_first_row;
+	r.out = out;
+	r.out_base = out_first_row;
+	r.width = dim->width;
+	r.height = dim->height;
+	r.y0 = out_first_row;
+	r.y1 = out_first_row + out_rows;
+	r.x0 = 0;
+	r.x1 = dim->width;
+
+	rc = winograd_run(&r, cfilter);
+
+cleanup:
+	free(in);
+	free(out);
+	return rc;
+}
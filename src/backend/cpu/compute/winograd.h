@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utils/filters.h"
+#include "utils/threads-general.h"
+
+#define WINOGRAD_MAX_WEIGHT 1024 // keeps every intermediate of the integer transform inside int32
+
+/**
+ * Tells whether the filter can go through the Winograd engine: a 3x3 kernel with integer weights
+ * not exceeding WINOGRAD_MAX_WEIGHT in magnitude.
+ *
+ * @param cfilter Filter to check.
+ * @return 1 if supported, 0 otherwise.
+ */
+uint8_t winograd_supported(const struct filter *cfilter);
+
+/**
+ * Winograd F(2x2, 3x3) variant of apply_filter().
+ * The region is walked in 2x2 output tiles: each tile costs 16 multiplies per channel instead of 36.
+ * Transforms are scaled by 2 so that they only hold integers, and all arithmetic is done in int32,
+ * hence for 8-bit input the weighted sum is exact and the result is bit-identical to apply_filter().
+ * Regions thinner than a tile and unsupported kernels fall back to apply_filter().
+ *
+ * @param spec Pointer to the thread_spec structure containing image data and processing range.
+ * @param cfilter The filter structure containing the kernel matrix, size, bias, and factor.
+ */
+void apply_filter_winograd(struct thread_spec *spec, struct filter cfilter);
+
+/**
+ * Same as apply_filter_winograd() but for contiguous pixel buffers (MPI local chunks).
+ * Computes full-width rows [out_first_row, out_first_row + out_rows) of the image.
+ *
+ * @param input Input buffer, its first row is image row `in_first_row`.
+ * @param in_first_row Global index of the first input row.
+ * @param in_rows Number of rows in the input buffer (must cover the output rows plus one halo row on each side, where present).
+ * @param output Output buffer, its first row is image row `out_first_row`.
+ * @param out_first_row Global index of the first output row.
+ * @param out_rows Number of rows to compute.
+ * @param row_stride Bytes between the starts of two consecutive rows in both buffers.
+ * @param dim Global image dimensions (used for border clamping).
+ * @param cfilter The filter structure (must pass winograd_supported()).
+ *
+ * @return 0 on success, -1 on error (nothing written, the caller should use the direct path).
+ */
+int winograd_apply_buffer(const unsigned char *input, uint32_t in_first_row, uint32_t in_rows, unsigned char *output, uint32_t out_first_row, uint32_t out_rows,
+			  size_t row_stride, const struct img_dim *dim, const struct filter *cfilter);
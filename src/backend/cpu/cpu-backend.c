@@ -3,14 +3,24 @@
 #include "cpu-backend.h"
 #include "../compute-backend.h"
 #include "utils/threads-general.h"
+#include "utils/thread-pool.h"
+#include "utils/affinity.h"
 #include "logger/log.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 #include <mpi.h>
 #include "utils/utils.h"
 #include "st/st-exec.h"
 #include "mt/mt-exec.h"
+#include "mt/mt-tune.h"
+#include "inplace/inplace-exec.h"
+#include "compute/iir-gauss.h"
+#include "compute/accuracy.h"
+#include "compute/uniform.h"
+#include "compute/gray.h"
+#include "compute/bilateral.h"
 #include "qmt/qmt-exec.h"
 #include "qmt/qmt-threads.h"
 #include "mpi/mpi-exec.h"
@@ -29,10 +39,15 @@ union cpu_backend_data {
 
 int cpu_verify_args(struct p_args *args)
 {
-	if (!args->compute_cfg.filter_type || args->compute_cfg.block_size == 0) {
+	// --mode=auto picks the block size itself
+	if (!args->compute_cfg.filter_type || (args->compute_cfg.block_size == 0 && args->compute_cfg.compute_mode != CONV_COMPUTE_AUTO)) {
 		log_error("Error: Missing required arguments: --filter and --block must be set.\n");
 		return -1;
 	}
+	if (args->compute_cfg.compute_mode == CONV_COMPUTE_AUTO && (args->compute_cfg.queue == CONV_QUEUE_ENABLED || args->compute_cfg.mpi == CONV_MPI_ENABLED)) {
+		log_error("Error: --mode=auto isn't supported in queue or MPI mode.\n");
+		return -1;
+	}
 
 	if (args->compute_cfg.compute_mode < 1) {
 		log_warn("Warn: --mode is required for CPU backend mode, setting BY_ROW.\n");
@@ -42,6 +57,54 @@ int cpu_verify_args(struct p_args *args)
 		log_error("Error: Queue mode requires at least 3 input filename.\n");
 		return -1;
 	}
+	if (filter_is_whole_image(args->compute_cfg.filter_type) && args->compute_cfg.mpi == CONV_MPI_ENABLED) {
+		log_error("Error: Filter '%s' needs the whole image and isn't supported in MPI mode.\n", args->compute_cfg.filter_type);
+		return -1;
+	}
+	if (strcmp(args->compute_cfg.filter_type, "rg") == 0 && args->compute_cfg.sigma < IIR_GAUSS_MIN_SIGMA) {
+		log_error("Error: Recursive Gaussian requires --sigma >= %.1f.\n", IIR_GAUSS_MIN_SIGMA);
+		return -1;
+	}
+	if (filter_is_bilateral(args->compute_cfg.filter_type)) {
+		if (args->compute_cfg.mpi == CONV_MPI_ENABLED || args->compute_cfg.inplace || args->compute_cfg.decimate > 1 || args->compute_cfg.uniform_skip) {
+			log_error("Error: Bilateral filter isn't supported with MPI, --inplace, --decimate or --uniform-skip.\n");
+			return -1;
+		}
+	}
+	if (args->compute_cfg.decimate > 1) {
+		if (args->compute_cfg.mpi == CONV_MPI_ENABLED || args->compute_cfg.inplace) {
+			log_error("Error: --decimate isn't supported with MPI or --inplace.\n");
+			return -1;
+		}
+		if (filter_is_whole_image(args->compute_cfg.filter_type) || filter_is_morphology(args->compute_cfg.filter_type)) {
+			log_error("Error: --decimate supports convolution filters and the median only, got '%s'.\n", args->compute_cfg.filter_type);
+			return -1;
+		}
+	}
+	if (args->compute_cfg.affinity != CONV_AFFINITY_NONE && args->compute_cfg.mpi == CONV_MPI_ENABLED) {
+		log_error("Error: --affinity isn't supported in MPI mode, pin the ranks with the launcher instead.\n");
+		return -1;
+	}
+	if (args->compute_cfg.order != CONV_ORDER_RASTER) {
+		if (args->compute_cfg.compute_mode != CONV_COMPUTE_BY_GRID && args->compute_cfg.compute_mode != CONV_COMPUTE_AUTO) {
+			log_error("Error: --order applies to by_grid only, got '%s'.\n", compute_mode_to_str(args->compute_cfg.compute_mode));
+			return -1;
+		}
+		if (args->compute_cfg.mpi == CONV_MPI_ENABLED || args->compute_cfg.inplace) {
+			log_error("Error: --order isn't supported with MPI or --inplace.\n");
+			return -1;
+		}
+	}
+	if (args->compute_cfg.uniform_skip) {
+		if (args->compute_cfg.mpi == CONV_MPI_ENABLED || args->compute_cfg.decimate > 1) {
+			log_error("Error: --uniform-skip isn't supported with MPI or --decimate.\n");
+			return -1;
+		}
+		if (filter_is_whole_image(args->compute_cfg.filter_type)) {
+			log_error("Error: --uniform-skip supports windowed filters only, got '%s'.\n", args->compute_cfg.filter_type);
+			return -1;
+		}
+	}
 	if (args->compute_cfg.queue == CONV_QUEUE_DISABLED && args->files_cfg.file_cnt != 1) {
 		log_error("Error: Normal mode requires exactly one input filename.\n");
 		return -1;
@@ -53,14 +116,14 @@ int cpu_verify_args(struct p_args *args)
 static int cpu_init(struct compute_backend *backend, struct p_args *args)
 {
 	union cpu_backend_data *data = NULL;
-	int rc;
+	int rc, pool_size, queue_cnt = 0;
 
 	if (!backend || !args) {
 		log_error("Error: NULL parameter in cpu_init\n");
 		return -1;
 	}
 
-	data = malloc(sizeof(union cpu_backend_data));
+	data = calloc(1, sizeof(union cpu_backend_data));
 	if (!data) {
 		log_error("Error: Failed to allocate memory for cpu_backend_data\n");
 		return -1;
@@ -100,6 +163,21 @@ static int cpu_init(struct compute_backend *backend, struct p_args *args)
 		log_info("Set data->thread_count to the %d", data->thread_count);
 	}
 
+	// queue workers split every image into worker_cnt tasks, other paths into thread_count
+	if (args->compute_cfg.queue == CONV_QUEUE_ENABLED)
+		pool_size = args->compute_ctx.qm.threads_cfg.worker_cnt;
+	else if (args->compute_cfg.mpi == CONV_MPI_ENABLED)
+		pool_size = (data->mpi_mode.size > 1) ? 1 : args->compute_ctx.threadnum;
+	else
+		pool_size = data->thread_count;
+	if (args->compute_cfg.queue == CONV_QUEUE_ENABLED)
+		queue_cnt = args->compute_ctx.qm.threads_cfg.reader_cnt + args->compute_ctx.qm.threads_cfg.worker_cnt + args->compute_ctx.qm.threads_cfg.writer_cnt;
+	if (affinity_init(args->compute_cfg.affinity, pool_size, queue_cnt) < 0 || thread_pool_init(pool_size) < 0) {
+		affinity_free();
+		free(data);
+		return -1;
+	}
+
 	backend->backend_data = data;
 	if (backend->args->compute_cfg.mpi == CONV_MPI_ENABLED)
 		log_debug("CPU Backend: Initialized (MPI rank %d, size %d)\n", data->mpi_mode.rank, data->mpi_mode.size);
@@ -114,10 +192,11 @@ static double cpu_process_non_queue_mode(struct compute_backend *backend)
 	struct p_args *args = backend->args;
 	struct filter_mix *filters = backend->filters;
 	union cpu_backend_data *data = (union cpu_backend_data *)backend->backend_data;
-	int threadnum ;
+	int threadnum, requested_threadnum;
 	struct img_spec *img_spec = NULL;
+	bmp_img *reference = NULL;
 	char output_filepath[256];
-	double result_time = 0;
+	double result_time = 0, prepass_time = 0, postpass_time = 0;
 
 	if (backend->args->compute_cfg.mpi == CONV_MPI_ENABLED)
 		threadnum = (data->mpi_mode.size > 1) ? 1 : (args->compute_ctx.threadnum > 0 ? args->compute_ctx.threadnum : 1);
@@ -125,6 +204,7 @@ static double cpu_process_non_queue_mode(struct compute_backend *backend)
 		threadnum = data->thread_count;
 
 	assert(threadnum > 0);
+	requested_threadnum = threadnum; // names the default output file, even if auto-tuning settles on fewer threads
 
 	img_spec = setup_img_spec(args);
 	if (!img_spec)
@@ -137,7 +217,34 @@ static double cpu_process_non_queue_mode(struct compute_backend *backend)
 			goto cleanup; /* MPI path saves result and manages its own resources */
 	}
 
-	if (threadnum > 1) {
+	if (args->compute_cfg.accuracy)
+		reference = accuracy_build_reference(img_spec, args);
+
+	prepass_time = get_time_in_seconds();
+	if (args->compute_cfg.affinity != CONV_AFFINITY_NONE && affinity_first_touch(img_spec) < 0)
+		goto cleanup;
+	if (gray_supported(args, filters) && gray_attach(img_spec) < 0)
+		goto cleanup;
+	if (args->compute_cfg.uniform_skip && uniform_map_attach(img_spec, args, filters) < 0)
+		goto cleanup;
+	if (filter_is_bilateral(args->compute_cfg.filter_type) && bilateral_grid_attach(threadnum, img_spec, args) < 0)
+		goto cleanup;
+	prepass_time = get_time_in_seconds() - prepass_time;
+
+	// calibration picks the configuration, it isn't part of the computation's cost
+	if (args->compute_cfg.compute_mode == CONV_COMPUTE_AUTO) {
+		if (mt_autotune(img_spec, args, filters) < 0)
+			goto cleanup;
+		threadnum = args->compute_ctx.threadnum;
+	}
+
+	if (filter_is_whole_image(args->compute_cfg.filter_type)) {
+		log_info("Executing whole-image computation (%d threads)...", threadnum);
+		result_time = execute_whole_image_computation(threadnum, img_spec, args);
+	} else if (args->compute_cfg.inplace) {
+		log_info("Executing in-place computation (%d threads)...", threadnum);
+		result_time = execute_inplace_computation(threadnum, img_spec, args, filters);
+	} else if (threadnum > 1) {
 		log_info("Executing multi-threaded computation (%d threads)...", threadnum);
 		result_time = execute_mt_computation(threadnum, img_spec, args, filters);
 	} else {
@@ -149,15 +256,36 @@ static double cpu_process_non_queue_mode(struct compute_backend *backend)
 		log_error("Error: Computation execution failed or returned non-positive time (%.6f).\n", result_time);
 		goto cleanup;
 	}
+	// the uniform map, the bilateral grid and the grayscale planes are part of the computation's cost
+	postpass_time = get_time_in_seconds();
+	gray_detach(img_spec);
+	result_time += prepass_time + get_time_in_seconds() - postpass_time;
+
+	if (reference)
+		accuracy_report(reference, img_spec->output, args);
 
-	save_result_image(output_filepath, sizeof(output_filepath), threadnum, img_spec->output, args);
+	save_result_image(output_filepath, sizeof(output_filepath), requested_threadnum, img_spec->output, args);
 
 cleanup:
 	log_debug("Cleaning up non-queue mode resources...");
 
+	if (reference) {
+		bmp_img_free(reference);
+		free(reference);
+	}
+
 	if (img_spec) {
-		if (img_spec->output) bmp_img_free(img_spec->output);
-		if (img_spec->input) bmp_img_free(img_spec->input);
+		uniform_map_detach(img_spec);
+		bilateral_grid_detach(img_spec);
+		gray_detach(img_spec);
+		if (img_spec->output && img_spec->output != img_spec->input) {
+			bmp_img_free(img_spec->output);
+			free(img_spec->output);
+		}
+		if (img_spec->input) {
+			bmp_img_free(img_spec->input);
+			free(img_spec->input);
+		}
 		if (img_spec->dim) free(img_spec->dim);
 		free(img_spec);
 	}
@@ -215,6 +343,8 @@ static void cpu_cleanup(struct compute_backend *backend)
 	if (!backend)
 		return;
 
+	thread_pool_destroy();
+	affinity_free();
 	if (backend->backend_data) {
 		free(backend->backend_data);
 		backend->backend_data = NULL;
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "inplace-exec.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include "utils/thread-pool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// one band (row mode) or strip (column mode) of the image, owned by a single thread
+struct inplace_task {
+	struct img_spec *img_spec;
+	struct p_args *args;
+	struct filter_mix *filters;
+	int32_t start; // first row/column of the band
+	int32_t end; // exclusive
+	int32_t window;
+	uint8_t wrap;
+	uint8_t by_column;
+	bmp_pixel *halo; // 2 * (window / 2) original lines read from outside the band: the ones above/left go first
+	int8_t status;
+};
+
+static inline int32_t map_index(int32_t idx, int32_t n, uint8_t wrap)
+{
+	if (wrap)
+		return ((idx % n) + n) % n;
+	return min(max(idx, 0), n - 1);
+}
+
+static inline bmp_pixel *halo_line(const struct inplace_task *task, int32_t idx, int32_t line_len)
+{
+	int32_t pad = task->window / 2;
+
+	if (idx < task->start)
+		return task->halo + (size_t)(idx - (task->start - pad)) * line_len;
+	return task->halo + (size_t)(pad + idx - task->end) * line_len;
+}
+
+/**
+ * Copies the original lines that the band reads from outside of itself. Must be done for all bands
+ * before any thread starts overwriting the image.
+ */
+static int inplace_snapshot_halo(struct inplace_task *task)
+{
+	bmp_pixel **pixels = task->img_spec->input->img_pixels;
+	int32_t pad = task->window / 2;
+	int32_t line_len = task->by_column ? task->img_spec->dim->height : task->img_spec->dim->width;
+	int32_t line_cnt = task->by_column ? task->img_spec->dim->width : task->img_spec->dim->height;
+	int32_t i, y, idx, src;
+	bmp_pixel *line;
+
+	task->halo = malloc((size_t)2 * pad * line_len * sizeof(bmp_pixel));
+	if (!task->halo) {
+		log_error("Error: Failed to allocate in-place halo buffer.");
+		return -1;
+	}
+
+	for (i = 0; i < 2 * pad; i++) {
+		idx = (i < pad) ? task->start - pad + i : task->end + i - pad;
+		src = map_index(idx, line_cnt, task->wrap);
+		line = task->halo + (size_t)i * line_len;
+
+		if (!task->by_column) {
+			memcpy(line, pixels[src], line_len * sizeof(bmp_pixel));
+		} else {
+			for (y = 0; y < line_len; y++)
+				line[y] = pixels[y][src];
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Row mode. Filter engines read input through a row-pointer table, so every row of the window is redirected
+ * to an original copy (ring slot or halo line) and the usual filter_part_computation() writes row `y` of the image itself.
+ */
+static void inplace_process_rows(struct inplace_task *task)
+{
+	struct img_spec *img_spec = task->img_spec;
+	bmp_pixel **pixels = img_spec->input->img_pixels;
+	int32_t width = img_spec->dim->width;
+	int32_t height = img_spec->dim->height;
+	int32_t ksize = task->window;
+	int32_t pad = ksize / 2;
+	int32_t y, idx, next_load = task->start;
+	bmp_pixel *ring = NULL;
+	bmp_pixel **rows = NULL;
+	struct thread_spec *th_spec = NULL;
+	struct img_spec virt_spec;
+	bmp_img virt_input;
+
+	ring = malloc((size_t)ksize * width * sizeof(bmp_pixel));
+	rows = calloc(height, sizeof(bmp_pixel *));
+	th_spec = init_thread_spec(task->args, task->filters);
+	if (!ring || !rows || !th_spec) {
+		log_error("Error: Failed to allocate in-place row ring.");
+		task->status = -1;
+		goto cleanup;
+	}
+
+	virt_input = *img_spec->input;
+	virt_input.img_pixels = rows;
+	virt_spec.input = &virt_input;
+	virt_spec.output = img_spec->input;
+	virt_spec.dim = img_spec->dim;
+	virt_spec.uniform = img_spec->uniform; // built from the original input, still valid for it
+	virt_spec.gray_input = NULL; // --gray is off for in-place runs
+	virt_spec.gray_output = NULL;
+	virt_spec.bilateral = NULL; // "bl" is rejected with --inplace
+
+	th_spec->img = &virt_spec;
+	th_spec->start_column = 0;
+	th_spec->end_column = width;
+
+	for (y = task->start; y < task->end; y++) {
+		// rows below y weren't overwritten yet, so their originals are still in the image
+		for (; next_load < task->end && next_load <= y + pad; next_load++)
+			memcpy(ring + (size_t)(next_load % ksize) * width, pixels[next_load], width * sizeof(bmp_pixel));
+
+		for (idx = y - pad; idx <= y + pad; idx++) {
+			if (idx >= task->start && idx < task->end)
+				rows[map_index(idx, height, task->wrap)] = ring + (size_t)(idx % ksize) * width;
+			else
+				rows[map_index(idx, height, task->wrap)] = halo_line(task, idx, width);
+		}
+
+		th_spec->start_row = y;
+		th_spec->end_row = y + 1;
+		filter_part_computation(th_spec);
+	}
+
+cleanup:
+	if (th_spec)
+		free(th_spec->st_gen_info);
+	free(th_spec);
+	free(rows);
+	free(ring);
+}
+
+static void inplace_convolve_column(bmp_pixel **pixels, bmp_pixel **cols, int32_t x, int32_t height, const struct filter *cfilter)
+{
+	int32_t y, filterX, filterY, imageY;
+	int32_t pad = cfilter->size / 2;
+	double red_acc, green_acc, blue_acc, weight;
+	bmp_pixel orig_pixel;
+
+	for (y = 0; y < height; y++) {
+		red_acc = 0.0;
+		green_acc = 0.0;
+		blue_acc = 0.0;
+
+		for (filterY = 0; filterY < cfilter->size; filterY++) {
+			imageY = map_index(y + filterY - pad, height, 0);
+			for (filterX = 0; filterX < cfilter->size; filterX++) {
+				orig_pixel = cols[filterX][imageY];
+				weight = cfilter->filter_arr[filterY][filterX];
+
+				red_acc += orig_pixel.red * weight;
+				green_acc += orig_pixel.green * weight;
+				blue_acc += orig_pixel.blue * weight;
+			}
+		}
+
+		pixels[y][x].red = (unsigned char)fmin(fmax(round(red_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+		pixels[y][x].green = (unsigned char)fmin(fmax(round(green_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+		pixels[y][x].blue = (unsigned char)fmin(fmax(round(blue_acc * cfilter->factor + cfilter->bias), 0.0), 255.0);
+	}
+}
+
+static void inplace_median_column(bmp_pixel **pixels, bmp_pixel **cols, int32_t x, int32_t height, int32_t filter_size, int32_t *red, int32_t *green, int32_t *blue)
+{
+	int32_t half_size = filter_size / 2;
+	int32_t filter_area = filter_size * filter_size;
+	int32_t y, n, filterX, filterY, imageY;
+	bmp_pixel orig_pixel;
+
+	for (y = 0; y < height; y++) {
+		n = 0;
+		for (filterY = -half_size; filterY <= half_size; filterY++) {
+			imageY = (y + filterY + height) % height;
+			for (filterX = -half_size; filterX <= half_size; filterX++) {
+				orig_pixel = cols[filterX + half_size][imageY];
+				red[n] = orig_pixel.red;
+				green[n] = orig_pixel.green;
+				blue[n] = orig_pixel.blue;
+				n++;
+			}
+		}
+
+		pixels[y][x].red = (unsigned char)selectKth(red, 0, filter_area, filter_area / 2);
+		pixels[y][x].green = (unsigned char)selectKth(green, 0, filter_area, filter_area / 2);
+		pixels[y][x].blue = (unsigned char)selectKth(blue, 0, filter_area, filter_area / 2);
+	}
+}
+
+/**
+ * Column mode. Lines are columns here, which the row-pointer based engines can't address,
+ * so the window is evaluated directly over K column buffers (same accumulation order as apply_filter/apply_median_filter).
+ */
+static void inplace_process_columns(struct inplace_task *task)
+{
+	struct img_spec *img_spec = task->img_spec;
+	bmp_pixel **pixels = img_spec->input->img_pixels;
+	int32_t height = img_spec->dim->height;
+	int32_t ksize = task->window;
+	int32_t pad = ksize / 2;
+	int32_t x, y, k, idx, next_load = task->start;
+	struct filter *cfilter = NULL;
+	bmp_pixel *ring = NULL;
+	bmp_pixel **cols = NULL;
+	int32_t *red = NULL, *green = NULL, *blue = NULL;
+
+	if (!task->wrap) {
+		cfilter = get_filter_by_name(task->filters, task->args->compute_cfg.filter_type);
+		if (!cfilter) {
+			log_error("Error: Unknown filter '%s' in in-place column mode.", task->args->compute_cfg.filter_type);
+			task->status = -1;
+			return;
+		}
+	}
+
+	ring = malloc((size_t)ksize * height * sizeof(bmp_pixel));
+	cols = malloc(ksize * sizeof(bmp_pixel *));
+	red = malloc(ksize * ksize * sizeof(*red));
+	green = malloc(ksize * ksize * sizeof(*green));
+	blue = malloc(ksize * ksize * sizeof(*blue));
+	if (!ring || !cols || !red || !green || !blue) {
+		log_error("Error: Failed to allocate in-place column ring.");
+		task->status = -1;
+		goto cleanup;
+	}
+
+	for (x = task->start; x < task->end; x++) {
+		for (; next_load < task->end && next_load <= x + pad; next_load++) {
+			bmp_pixel *slot = ring + (size_t)(next_load % ksize) * height;
+			for (y = 0; y < height; y++)
+				slot[y] = pixels[y][next_load];
+		}
+
+		for (k = 0; k < ksize; k++) {
+			idx = x - pad + k;
+			if (idx >= task->start && idx < task->end)
+				cols[k] = ring + (size_t)(idx % ksize) * height;
+			else
+				cols[k] = halo_line(task, idx, height);
+		}
+
+		if (cfilter)
+			inplace_convolve_column(pixels, cols, x, height, cfilter);
+		else
+			inplace_median_column(pixels, cols, x, height, ksize, red, green, blue);
+	}
+
+cleanup:
+	free(ring);
+	free(cols);
+	free(red);
+	free(green);
+	free(blue);
+}
+
+static void inplace_task_run(void *ctx, int idx)
+{
+	struct inplace_task *task = (struct inplace_task *)ctx + idx;
+
+	if (task->by_column)
+		inplace_process_columns(task);
+	else
+		inplace_process_rows(task);
+}
+
+double execute_inplace_computation(int threadnum, struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters)
+{
+	enum conv_compute_mode mode = args->compute_cfg.compute_mode;
+	uint8_t by_column = (mode == CONV_COMPUTE_BY_COLUMN) && !filter_is_morphology(args->compute_cfg.filter_type);
+	int32_t line_cnt = by_column ? img_spec->dim->width : img_spec->dim->height;
+	int32_t window = get_filter_window_size(filters, args->compute_cfg.filter_type);
+	struct inplace_task *tasks = NULL;
+	double start_time, end_time;
+	int8_t failed = 0;
+	int bands, i;
+
+	if (img_spec->output != img_spec->input) {
+		log_error("Error: in-place computation requires output to alias the input image.");
+		return 0;
+	}
+	if (window <= 0) {
+		log_error("Error: Unknown filter '%s' for in-place computation.", args->compute_cfg.filter_type);
+		return 0;
+	}
+	if (mode == CONV_COMPUTE_BY_PIXEL || mode == CONV_COMPUTE_BY_GRID || mode == CONV_COMPUTE_WORK_STEAL || mode == CONV_COMPUTE_GUIDED || (mode == CONV_COMPUTE_BY_COLUMN && !by_column))
+		log_info("In-place computation splits the image into row bands, %s partitioning isn't used.", compute_mode_to_str(mode));
+
+	bands = min(threadnum, line_cnt);
+	tasks = calloc(bands, sizeof(struct inplace_task));
+	if (!tasks) {
+		log_error("Error: Memory allocation failed\n");
+		return 0;
+	}
+
+	start_time = get_time_in_seconds();
+
+	for (i = 0; i < bands; i++) {
+		tasks[i].img_spec = img_spec;
+		tasks[i].args = args;
+		tasks[i].filters = filters;
+		tasks[i].start = (int32_t)((int64_t)line_cnt * i / bands);
+		tasks[i].end = (int32_t)((int64_t)line_cnt * (i + 1) / bands);
+		tasks[i].window = window;
+		tasks[i].wrap = filter_wraps_borders(args->compute_cfg.filter_type);
+		tasks[i].by_column = by_column;
+		if (inplace_snapshot_halo(&tasks[i]) != 0) {
+			failed = 1;
+			goto cleanup;
+		}
+	}
+
+	thread_pool_run(bands, inplace_task_run, tasks);
+
+	for (i = 0; i < bands; i++) {
+		if (tasks[i].status != 0)
+			failed = 1;
+	}
+
+cleanup:
+	end_time = get_time_in_seconds();
+
+	for (i = 0; i < bands; i++)
+		free(tasks[i].halo);
+	free(tasks);
+
+	return failed ? 0 : end_time - start_time;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "libbmp/libbmp.h"
+#include "utils/threads-general.h"
+
+/**
+ * Applies the selected filter in place: the result overwrites `img_spec->input` (img_spec->output must point to the same image).
+ * The image is split into `threadnum` contiguous row bands (column strips in by_column mode).
+ * Before any thread starts, the halo lines each band reads from its neighbours are copied aside.
+ * Every thread then keeps a ring of K original rows (columns) of its own band, where K is the filter window size,
+ * and overwrites each line right after computing it. Extra memory per thread is O(K * line) instead of a second image.
+ *
+ * @param threadnum Number of threads (bands) to use.
+ * @param img_spec Image spec with output == input.
+ * @param args Pointer to the p_args structure (filter type, compute mode).
+ * @param filters Pointer to the filter_mix structure.
+ *
+ * @return Time spent (in seconds) for the computation, or 0 on error.
+ */
+double execute_inplace_computation(int threadnum, struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters);
@@ -126,17 +126,20 @@ int8_t mpi_phase_gather_data(const struct mpi_context *ctx, const struct img_com
 // Simply sents img dim to all the prcesses (from rank0)
 void mpi_broadcast_metadata(struct img_comm_data *comm_data)
 {
-	uint16_t mpi_width = comm_data->dim->width;
-	uint16_t mpi_height = comm_data->dim->height;
-	uint16_t mpi_row_stride = comm_data->row_stride_bytes;
+	uint32_t mpi_width = comm_data->dim->width;
+	uint32_t mpi_height = comm_data->dim->height;
+	uint64_t mpi_row_stride = comm_data->row_stride_bytes;
+	uint8_t mpi_bytes_per_pixel = comm_data->bytes_per_pixel;
 
-	MPI_Bcast(&mpi_width, 1, MPI_UINT16_T, 0, MPI_COMM_WORLD);
-	MPI_Bcast(&mpi_height, 1, MPI_UINT16_T, 0, MPI_COMM_WORLD);
-	MPI_Bcast(&mpi_row_stride, 1, MPI_UINT16_T, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&mpi_width, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&mpi_height, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&mpi_row_stride, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&mpi_bytes_per_pixel, 1, MPI_UINT8_T, 0, MPI_COMM_WORLD);
 
 	comm_data->dim->width = mpi_width;
 	comm_data->dim->height = mpi_height;
 	comm_data->row_stride_bytes = mpi_row_stride;
+	comm_data->bytes_per_pixel = mpi_bytes_per_pixel;
 
 	log_debug("Successfully broadcasted dim");
 }
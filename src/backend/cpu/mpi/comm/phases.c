@@ -6,12 +6,30 @@
 #include "data-transfer.h"
 #include "../compute/filter-comp.h"
 #include "rank0-proc.h"
+#include "backend/cpu/compute/gray.h"
 #include "utils/utils.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> // For memcpy
 
+/**
+ * Chooses how many bytes of every pixel are distributed: a grayscale image filtered by a convolution kernel is sent as its red channel only
+ * (ranks run the single-channel engine, rank 0 expands the result), anything else as full BGR pixels.
+ */
+static uint8_t mpi_select_bytes_per_pixel(const struct p_args *args, struct img_spec *img_data, const struct img_dim *dim)
+{
+	const char *filter_type = args->compute_cfg.filter_type;
+	uint8_t gray = args->compute_cfg.gray && strcmp(filter_type, "mm") != 0 && !filter_is_morphology(filter_type) && !filter_is_whole_image(filter_type) &&
+		       gray_image_detect(img_data->input, dim->width, dim->height);
+
+	if (gray) {
+		log_info("Rank 0: Grayscale input, distributing single-channel rows.");
+		return 1;
+	}
+	return BYTES_PER_PIXEL;
+}
+
 int8_t mpi_phase_initialize(const struct mpi_context *ctx, const struct p_args *args, struct img_spec *img_data, struct img_comm_data *comm_data, double *start_time)
 {
 	int8_t setup_status = 0;
@@ -30,16 +48,20 @@ int8_t mpi_phase_initialize(const struct mpi_context *ctx, const struct p_args *
 	comm_data->compute_mode = args->compute_cfg.compute_mode;
 
 	if (ctx->rank == 0) {
-		setup_status = mpi_rank0_initialize(img_data, comm_data, start_time, args->files_cfg.input_filename[0]);
+		if (args->compute_cfg.inplace && args->compute_cfg.compute_mode != CONV_COMPUTE_BY_ROW)
+			log_warn("Rank 0: In-place mode is only supported for by_row MPI distribution, allocating a separate result image.");
+		setup_status = mpi_rank0_initialize(img_data, comm_data, start_time, args->files_cfg.input_filename[0],
+						    args->compute_cfg.inplace && args->compute_cfg.compute_mode == CONV_COMPUTE_BY_ROW);
 		if (setup_status != 0)
 
 			return -1;
-		comm_data->row_stride_bytes = (size_t)(comm_data->dim->width * BYTES_PER_PIXEL);
+		comm_data->bytes_per_pixel = mpi_select_bytes_per_pixel(args, img_data, comm_data->dim);
+		comm_data->row_stride_bytes = (size_t)(comm_data->dim->width * comm_data->bytes_per_pixel);
 	}
 
 	mpi_broadcast_metadata(comm_data); // Idk if all the processes should call it
 	if (ctx->rank != 0) {
-		comm_data->row_stride_bytes = (size_t)(comm_data->dim->width * BYTES_PER_PIXEL);
+		comm_data->row_stride_bytes = (size_t)(comm_data->dim->width * comm_data->bytes_per_pixel);
 	}
 
 	if (comm_data->dim->width <= 0 || comm_data->dim->height <= 0) {
@@ -61,14 +83,14 @@ int8_t mpi_phase_prepare_comm(const struct mpi_context *ctx, const struct img_co
 	int8_t setup_status = 0;
 	int8_t pack_status = 0;
 	int8_t i = 0;
-	int16_t *displs_orig = NULL;
+	int *displs_orig = NULL;
 
 	*global_send_buffer = NULL;
 
 	log_trace("PREPARE COMM PHASE:\n");
 
 	if (ctx->rank == 0) {
-		displs_orig = malloc((size_t)ctx->size * sizeof(int16_t));
+		displs_orig = malloc((size_t)ctx->size * sizeof(int));
 		if (!displs_orig) {
 			log_error("Rank 0: Failed to allocate memory for orig displacement array.");
 			return -1;
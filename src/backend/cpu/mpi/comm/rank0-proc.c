@@ -11,7 +11,7 @@
 #include <string.h>
 #include <mpi.h>
 
-int8_t mpi_rank0_initialize(struct img_spec *img_data, struct img_comm_data *comm_data, double *start_time, const char *input_filename_base)
+int8_t mpi_rank0_initialize(struct img_spec *img_data, struct img_comm_data *comm_data, double *start_time, const char *input_filename_base, uint8_t inplace)
 {
 	char input_filepath[256] = { 0 };
 	int8_t read_status = -1;
@@ -35,8 +35,13 @@ int8_t mpi_rank0_initialize(struct img_spec *img_data, struct img_comm_data *com
 	}
 	bmp_print_header_data(&img_data->input->img_header);
 
-	bmp_img_init_df(img_data->output, comm_data->dim->width, comm_data->dim->height);
-	img_data->output->img_header = img_data->input->img_header;
+	if (inplace) {
+		// input rows are packed into the scatter buffer before anything is gathered, so they can be overwritten
+		img_data->output->img_pixels = img_data->input->img_pixels;
+	} else {
+		bmp_img_init_df(img_data->output, comm_data->dim->width, comm_data->dim->height);
+	}
+	init_output_header(&img_data->output->img_header, &img_data->input->img_header, comm_data->dim->width, comm_data->dim->height);
 
 	*start_time = MPI_Wtime();
 	log_info("Rank 0: Image '%s' (%ux%u) read successfully.", input_filepath, comm_data->dim->height, comm_data->dim->width);
@@ -67,13 +72,27 @@ double mpi_rank0_finalize_and_save(const struct mpi_context *ctx, double start_t
 		bmp_print_header_data(&img_data->input->img_header); // note that dims are swapped!
 		//		bmp_compare_images(img_data->input, img_data->output);
 
-		bmp_img_free(img_data->output);
+		if (img_data->output->img_pixels != img_data->input->img_pixels)
+			bmp_img_free(img_data->output);
 		bmp_img_free(img_data->input);
 	}
 
 	return total_time;
 }
 
+// keeps one channel of a grayscale row (R = G = B)
+static void pack_gray_row(unsigned char *dst, const bmp_pixel *row, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+		dst[x] = row[x].red;
+}
+
+static void unpack_gray_row(bmp_pixel *row, const unsigned char *src, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+		row[x] = BMP_PIXEL(src[x], src[x], src[x]);
+}
+
 int8_t mpi_rank0_pack_data_for_scatter(const struct img_spec *img_data, const struct img_comm_data *comm_data, const struct mpi_context *ctx, const int *sendcounts,
 				       const int *displs_original, unsigned char **packed_buffer)
 {
@@ -109,7 +128,7 @@ int8_t mpi_rank0_pack_data_for_scatter(const struct img_spec *img_data, const st
 			proc_send_rows = (uint32_t)(sendcounts[i] / comm_data->row_stride_bytes);
 
 			if (proc_start_row + proc_send_rows > comm_data->dim->height) {
-				log_error("Rank 0: Packing error - calculated rows exceed image height for rank %d. Height %d and end_row %lu", i, comm_data->dim->height,
+				log_error("Rank 0: Packing error - calculated rows exceed image height for rank %d. Height %u and end_row %lu", i, comm_data->dim->height,
 					  proc_start_row + proc_send_rows);
 				log_error("Rank 0: start %lu, count %lu", proc_start_row, proc_send_rows);
 
@@ -121,7 +140,10 @@ int8_t mpi_rank0_pack_data_for_scatter(const struct img_spec *img_data, const st
 			// copies proc_send_rows amount of rows into the packed_buffer
 			for (r = 0; r < proc_send_rows; ++r) {
 				if (img_data->input->img_pixels && img_data->input->img_pixels[proc_start_row + r]) {
-					memcpy(current_pack_ptr, img_data->input->img_pixels[proc_start_row + r], comm_data->row_stride_bytes);
+					if (comm_data->bytes_per_pixel == 1)
+						pack_gray_row(current_pack_ptr, img_data->input->img_pixels[proc_start_row + r], comm_data->dim->width);
+					else
+						memcpy(current_pack_ptr, img_data->input->img_pixels[proc_start_row + r], comm_data->row_stride_bytes);
 					current_pack_ptr += comm_data->row_stride_bytes;
 				} else {
 					log_error("Rank 0: Packing error - source row pointer is NULL for row %u.", proc_start_row + r);
@@ -167,7 +189,10 @@ int8_t mpi_rank0_unpack_data(const unsigned char *gathered_buffer, struct img_sp
 					log_error("Rank 0: Unpacking error - destination row %u is NULL.", proc_start_row + r);
 					return -1;
 				}
-				memcpy(img_data->output->img_pixels[proc_start_row + r], current_unpack_ptr, comm_data->row_stride_bytes);
+				if (comm_data->bytes_per_pixel == 1)
+					unpack_gray_row(img_data->output->img_pixels[proc_start_row + r], current_unpack_ptr, comm_data->dim->width);
+				else
+					memcpy(img_data->output->img_pixels[proc_start_row + r], current_unpack_ptr, comm_data->row_stride_bytes);
 				current_unpack_ptr += comm_data->row_stride_bytes;
 			}
 		}
@@ -217,7 +242,7 @@ int8_t mpi_rank0_transpose_img(struct img_comm_data *comm_data, struct img_spec
 	img_data->input->img_pixels = final_output_pixels;
 	img_data->input->img_header.biWidth = comm_data->dim->width = height;
 	img_data->input->img_header.biHeight = comm_data->dim->height = width;
-	comm_data->row_stride_bytes = (size_t)comm_data->dim->width * BYTES_PER_PIXEL;
+	comm_data->row_stride_bytes = (size_t)comm_data->dim->width * comm_data->bytes_per_pixel;
 	log_info("Rank 0: Swapped dimensions for transpose: %ux%u (orig %ux%u), new stride: %zu", comm_data->dim->height, comm_data->dim->width, height, width,
 		 comm_data->row_stride_bytes);
 
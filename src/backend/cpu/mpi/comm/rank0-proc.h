@@ -14,11 +14,12 @@
  * Starts the MPI timer.
  *
  * @param comm_data - pointer to root0 img_comm_data structure (made for saving the dimensions)
+ * @param inplace - if set, no result image is allocated: gathered rows are unpacked straight into the input pixel array
  * + other known params
  *
  * @return 0 on success, -1 on error
  */
-int8_t mpi_rank0_initialize(struct img_spec *img_data, struct img_comm_data *comm_data, double *start_time, const char *input_filename_base);
+int8_t mpi_rank0_initialize(struct img_spec *img_data, struct img_comm_data *comm_data, double *start_time, const char *input_filename_base, uint8_t inplace);
 
 /**
  * Finalises the computation by getting 'end_time', saving the image and freeing some allocated data.
@@ -4,6 +4,9 @@
 #include "logger/log.h"
 #include "utils/filters.h"
 #include "utils/threads-general.h"
+#include "backend/cpu/compute/winograd.h"
+#include "backend/cpu/compute/morphology.h"
+#include "backend/cpu/compute/gray.h"
 #include "../utils/mpi-types.h"
 #include <math.h>
 #include <stdint.h>
@@ -66,7 +69,7 @@ static void mpi_apply_filter(const struct mpi_local_data *local_data, const stru
 					potential_imageX_global = x + filterX - padding;
 					if (potential_imageX_global < 0) {
 						imageX_global = 0;
-					} else if (potential_imageX_global >= comm_data->dim->width) {
+					} else if (potential_imageX_global >= (int32_t)comm_data->dim->width) {
 						imageX_global = comm_data->dim->width - 1;
 					} else {
 						imageX_global = potential_imageX_global;
@@ -75,7 +78,7 @@ static void mpi_apply_filter(const struct mpi_local_data *local_data, const stru
 					potential_imageY_global = global_y + filterY - padding;
 					if (potential_imageY_global < 0) {
 						imageY_global = 0;
-					} else if (potential_imageY_global >= comm_data->dim->height) {
+					} else if (potential_imageY_global >= (int32_t)comm_data->dim->height) {
 						imageY_global = comm_data->dim->height - 1;
 					} else {
 						imageY_global = potential_imageY_global;
@@ -215,6 +218,25 @@ void mpi_compute_local_region(const struct mpi_local_data *local_data, const str
 	}
 
 	const char *filter_type = args->compute_cfg.filter_type;
+	struct filter *cfilter = get_filter_by_name((struct filter_mix *)filters, filter_type);
+
+	// grayscale rows hold one byte per pixel
+	if (comm_data->bytes_per_pixel == 1) {
+		if (!cfilter) {
+			log_error("Rank %u: Single-channel rows need a convolution filter, got '%s'.", ctx->rank, filter_type);
+			MPI_Abort(MPI_COMM_WORLD, 1);
+			return;
+		}
+		gray_filter_buffer(local_data->input_pixels, comm_data->send_start_rc, local_data->output_pixels, comm_data->my_start_rc, comm_data->dim, cfilter,
+				   comm_data->my_start_rc, comm_data->my_start_rc + comm_data->my_num_rc, 0, comm_data->dim->width);
+		return;
+	}
+
+	// 3x3 integer kernels go through the Winograd engine, the direct path below stays as a fallback
+	if (args->compute_cfg.winograd && cfilter && winograd_supported(cfilter) &&
+	    winograd_apply_buffer(local_data->input_pixels, comm_data->send_start_rc, comm_data->send_num_rc, local_data->output_pixels, comm_data->my_start_rc,
+				  comm_data->my_num_rc, comm_data->row_stride_bytes, comm_data->dim, cfilter) == 0)
+		return;
 
 	// Dispatch based on filter type AND mode (transposed or not)
 	if (strcmp(filter_type, "mb") == 0 && filters->motion_blur) {
@@ -238,6 +260,10 @@ void mpi_compute_local_region(const struct mpi_local_data *local_data, const str
 		mpi_apply_filter(local_data, comm_data, *filters->box_blur, ctx->rank);
 	} else if (strcmp(filter_type, "mg") == 0 && filters->med_gaus) {
 		mpi_apply_filter(local_data, comm_data, *filters->med_gaus, ctx->rank);
+	} else if (filter_is_morphology(filter_type)) {
+		if (morph_apply_buffer(local_data->input_pixels, comm_data->send_start_rc, comm_data->send_num_rc, local_data->output_pixels, comm_data->my_start_rc,
+				       comm_data->my_num_rc, comm_data->row_stride_bytes, comm_data->dim, filter_type, filters->morph_radius) < 0)
+			MPI_Abort(MPI_COMM_WORLD, 1);
 	} else {
 		log_error("Rank ?: Unknown or unsupported filter type '%s' in mpi_process_local_region.", filter_type);
 		MPI_Abort(MPI_COMM_WORLD, 1);
@@ -68,7 +68,7 @@ static double mpi_process_by_rows(int rank, int size, const struct p_args *args,
 
 	mpi_broadcast_metadata(&comm_data); // Broadcasts dims from rank 0
 	if (ctx.rank != 0) {
-		comm_data.row_stride_bytes = (size_t)comm_data.dim->width * BYTES_PER_PIXEL;
+		comm_data.row_stride_bytes = (size_t)comm_data.dim->width * comm_data.bytes_per_pixel;
 	}
 
 	mpi_calculate_row_distribution(&ctx, &comm_data);
@@ -261,6 +261,12 @@ double execute_mpi_computation(uint8_t size, uint8_t rank, struct p_args *comput
 			log_error("CONV_COMPUTE_BY_GRID mode is not implemented for MPI.");
 		MPI_Abort(MPI_COMM_WORLD, 1);
 		return -1.0;
+	case CONV_COMPUTE_WORK_STEAL:
+	case CONV_COMPUTE_GUIDED:
+		if (rank == 0)
+			log_error("%s mode is not implemented for MPI.", compute_mode_to_str(compute_args->compute_cfg.compute_mode));
+		MPI_Abort(MPI_COMM_WORLD, 1);
+		return -1.0;
 	case CONV_COMPUTE_BY_PIXEL:
 		if (rank == 0)
 			log_error("CONV_COMPUTE_BY_PIXEL mode is not practical for MPI static distribution.");
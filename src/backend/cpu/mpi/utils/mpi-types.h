@@ -30,6 +30,7 @@ struct mpi_context {
 struct img_comm_data {
 	uint8_t halo_size;
 	int8_t compute_mode;
+	uint8_t bytes_per_pixel; // BYTES_PER_PIXEL, or 1 when only the red channel of a grayscale image is sent (--gray)
 	size_t row_stride_bytes; // The number of bytes in a single row/column of the image data. Crucial for calculating memory offsets.
 	uint32_t my_start_rc;
 	uint32_t my_num_rc; // The number of rows/columns this process is responsible for computing and writing to the output.
@@ -4,6 +4,7 @@
 #include "logger/log.h"
 #include "libbmp/libbmp.h"
 #include "utils/threads-general.h"
+#include "backend/cpu/compute/morphology.h"
 #include "mpi-types.h"
 #include <stdint.h>
 #include <stdlib.h>
@@ -39,6 +40,8 @@ uint8_t get_halo_size(const char *filter_type, const struct filter_mix *filters)
 		filter_size = filters->box_blur->size;
 	} else if (strcmp(filter_type, "mg") == 0 && filters->med_gaus) {
 		filter_size = filters->med_gaus->size;
+	} else if (filter_is_morphology(filter_type)) {
+		filter_size = 2 * morph_get_reach(filter_type, filters->morph_radius) + 1;
 	} else {
 		log_warn("get_halo_size: Unknown or unsupported filter type '%s'. Returning halo size 0.", filter_type);
 		return 0;
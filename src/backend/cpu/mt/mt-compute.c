@@ -2,88 +2,451 @@
 
 #include "mt-compute.h"
 #include <stdlib.h>
-#include <pthread.h>
 #include <string.h>
 #include "logger/log.h"
 #include "utils/threads-general.h"
+#include "utils/hw-info.h"
 
-uint8_t process_by_row(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t block_size, pthread_mutex_t *x_block_mutex)
+static inline uint64_t claim_block(uint64_t *next_block)
+{
+	// blocks are independent, the join of the workers orders their results
+	return __atomic_fetch_add(next_block, 1, __ATOMIC_RELAXED);
+}
+
+uint8_t process_by_row(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size)
 {
 	struct img_dim *dim = th_spec->img->dim;
+	uint64_t start = claim_block(next_block) * block_size;
 
-	pthread_mutex_lock(x_block_mutex);
-	log_debug("next_block: %u, height: %d\n", *next_x_block, dim->height);
+	log_debug("next_block: %llu, height: %u\n", (unsigned long long)start, dim->height);
 
-	if (*next_x_block >= dim->height) {
-		pthread_mutex_unlock(x_block_mutex);
+	if (start >= (uint64_t)dim->height) {
 		th_spec->start_row = th_spec->end_row = 0;
 		return 1;
 	}
-	th_spec->start_row = *next_x_block;
-	*next_x_block += block_size;
-	pthread_mutex_unlock(x_block_mutex);
 
+	th_spec->start_row = start;
 	th_spec->start_column = 0;
-	th_spec->end_row = fmin(th_spec->start_row + block_size, dim->height);
+	th_spec->end_row = min(start + block_size, (uint64_t)dim->height);
 	th_spec->end_column = dim->width;
 
 	return 0;
 }
 
-uint8_t process_by_column(struct thread_spec *th_spec, uint16_t *next_y_block, uint16_t block_size, pthread_mutex_t *y_block_mutex)
+uint8_t process_by_column(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size)
 {
 	struct img_dim *dim = th_spec->img->dim;
-	pthread_mutex_lock(y_block_mutex);
-	log_debug("next_block: %d, width: %d\n", *next_y_block, dim->width);
+	uint64_t start = claim_block(next_block) * block_size;
+
+	log_debug("next_block: %llu, width: %u\n", (unsigned long long)start, dim->width);
 
-	if (*next_y_block >= dim->width) {
-		pthread_mutex_unlock(y_block_mutex);
+	if (start >= (uint64_t)dim->width) {
 		th_spec->start_column = th_spec->end_column = 0;
 		return 1;
 	}
 
-	th_spec->start_column = *next_y_block;
-	*next_y_block += block_size;
-	pthread_mutex_unlock(y_block_mutex);
-
+	th_spec->start_column = start;
 	th_spec->start_row = 0;
 	th_spec->end_row = dim->height;
-	th_spec->end_column = fmin(th_spec->start_column + block_size, dim->width);
+	th_spec->end_column = min(start + block_size, (uint64_t)dim->width);
 
 	return 0;
 }
 
-uint8_t process_by_grid(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t *next_y_block, uint16_t block_size, pthread_mutex_t *xy_block_mutex)
+static int32_t strip_tile_rows(int32_t stage_w, int32_t pad)
+{
+	// staged input and output share half of L2
+	int32_t rows = hw_get_l2_cache_size() / 2 / (2 * (size_t)stage_w * sizeof(bmp_pixel));
+
+	return max(rows - 2 * pad, STRIP_MIN_TILE_ROWS);
+}
+
+static uint8_t strip_can_stage(const struct thread_spec *th_spec)
+{
+	const struct img_spec *img = th_spec->img;
+	const struct compute_cfg *cfg = &th_spec->st_gen_info->args->compute_cfg;
+
+	return !img->uniform && !img->bilateral && !img->gray_input && img->output != img->input && cfg->decimate <= 1 && !cfg->tiled &&
+	       !filter_is_morphology(cfg->filter_type) && !filter_is_bilateral(cfg->filter_type);
+}
+
+static int strip_stage_reserve(struct strip_stage *stage, size_t px, size_t rows)
+{
+	bmp_pixel *in, *out, **in_rows, **out_rows;
+
+	if (px > stage->px_cap) {
+		in = realloc(stage->in, px * sizeof(bmp_pixel));
+		if (!in)
+			return -1;
+		stage->in = in;
+		out = realloc(stage->out, px * sizeof(bmp_pixel));
+		if (!out)
+			return -1;
+		stage->out = out;
+		stage->px_cap = px;
+	}
+	if (rows > stage->rows_cap) {
+		in_rows = realloc(stage->in_rows, rows * sizeof(bmp_pixel *));
+		if (!in_rows)
+			return -1;
+		stage->in_rows = in_rows;
+		out_rows = realloc(stage->out_rows, rows * sizeof(bmp_pixel *));
+		if (!out_rows)
+			return -1;
+		stage->out_rows = out_rows;
+		stage->rows_cap = rows;
+	}
+
+	return 0;
+}
+
+void strip_stage_free(struct strip_stage *stage)
+{
+	free(stage->in);
+	free(stage->out);
+	free(stage->in_rows);
+	free(stage->out_rows);
+	memset(stage, 0, sizeof(*stage));
+}
+
+static inline int32_t strip_border(int32_t i, int32_t len, uint8_t wrap)
+{
+	if (wrap)
+		return (i % len + len) % len;
+	return min(max(i, 0), len - 1);
+}
+
+// copies rows [y0 - pad, y1 + pad) and columns [x0 - pad, x1 + pad) of the input into the stage
+static void stage_strip_tile(struct strip_stage *stage, bmp_pixel **input, const struct img_dim *dim, int32_t y0, int32_t y1, int32_t x0, int32_t x1, int32_t pad,
+			     uint8_t wrap)
+{
+	int32_t stage_w = x1 - x0 + 2 * pad;
+	const bmp_pixel *src;
+	bmp_pixel *dst;
+
+	for (int32_t i = 0; i < y1 - y0 + 2 * pad; i++) {
+		src = input[strip_border(y0 - pad + i, dim->height, wrap)];
+		dst = stage->in + (size_t)i * stage_w;
+		stage->in_rows[i] = dst;
+		stage->out_rows[i] = stage->out + (size_t)i * stage_w;
+
+		if (x0 - pad >= 0 && x1 + pad <= (int32_t)dim->width) {
+			memcpy(dst, src + x0 - pad, stage_w * sizeof(bmp_pixel));
+			continue;
+		}
+		for (int32_t j = 0; j < stage_w; j++)
+			dst[j] = src[strip_border(x0 - pad + j, dim->width, wrap)];
+	}
+}
+
+// runs the filter on the staged copy of output rows [y0, y1) of the strip, then copies the result into the image
+static void strip_tile_staged(struct thread_spec *th_spec, struct strip_stage *stage, int32_t y0, int32_t y1, int32_t pad, uint8_t wrap)
+{
+	struct img_spec *img = th_spec->img;
+	int32_t x0 = th_spec->start_column, x1 = th_spec->end_column;
+	struct img_dim local_dim = { .height = y1 - y0 + 2 * pad, .width = x1 - x0 + 2 * pad };
+	bmp_img local_in = *img->input, local_out = *img->output;
+	struct img_spec local = { .input = &local_in, .output = &local_out, .dim = &local_dim };
+	struct thread_spec tile = *th_spec;
+
+	stage_strip_tile(stage, img->input->img_pixels, img->dim, y0, y1, x0, x1, pad, wrap);
+	local_in.img_pixels = stage->in_rows;
+	local_out.img_pixels = stage->out_rows;
+
+	// the halo holds every pixel the window reads, so the borders of the copy are never reached
+	tile.img = &local;
+	tile.start_row = pad;
+	tile.end_row = pad + y1 - y0;
+	tile.start_column = pad;
+	tile.end_column = pad + x1 - x0;
+	filter_part_computation(&tile);
+
+	for (int32_t y = y0; y < y1; y++)
+		memcpy(img->output->img_pixels[y] + x0, stage->out_rows[pad + y - y0] + pad, (x1 - x0) * sizeof(bmp_pixel));
+}
+
+void column_strip_computation(struct thread_spec *th_spec, struct strip_stage *stage)
+{
+	const char *filter_type = th_spec->st_gen_info->args->compute_cfg.filter_type;
+	int32_t pad = get_filter_window_size(th_spec->st_gen_info->filters, filter_type) / 2;
+	int32_t x0 = th_spec->start_column, x1 = th_spec->end_column;
+	int32_t y0 = th_spec->start_row, y1 = th_spec->end_row;
+	int32_t rows = strip_tile_rows(x1 - x0 + 2 * pad, pad);
+	uint8_t staged = strip_can_stage(th_spec);
+
+	if (staged && strip_stage_reserve(stage, (size_t)(min(rows, y1 - y0) + 2 * pad) * (x1 - x0 + 2 * pad), min(rows, y1 - y0) + 2 * pad) < 0) {
+		log_warn("Warn: Failed to allocate the column strip stage, computing the strip in place.");
+		staged = 0;
+	}
+
+	for (int32_t y = y0; y < y1; y += rows) {
+		if (staged) {
+			strip_tile_staged(th_spec, stage, y, min(y + rows, y1), pad, filter_wraps_borders(filter_type));
+			continue;
+		}
+		th_spec->start_row = y;
+		th_spec->end_row = min(y + rows, y1);
+		filter_part_computation(th_spec);
+	}
+	th_spec->start_row = y0;
+	th_spec->end_row = y1;
+}
+
+// sets th_spec to `cnt` grid blocks starting at `idx`, all of them in one row of blocks
+static uint8_t set_grid_blocks(struct thread_spec *th_spec, uint64_t idx, uint64_t cnt, uint64_t blocks_x, uint32_t block_size)
 {
 	struct img_dim *dim = th_spec->img->dim;
+	uint64_t start_row = idx / blocks_x * block_size;
+	uint64_t start_column = idx % blocks_x * block_size;
+
+	if (start_row >= (uint64_t)dim->height) {
+		th_spec->start_row = th_spec->end_row = 0;
+		th_spec->start_column = th_spec->end_column = 0;
+		return 1;
+	}
 
-	pthread_mutex_lock(xy_block_mutex);
+	th_spec->start_row = start_row;
+	th_spec->start_column = start_column;
+	th_spec->end_row = min(start_row + block_size, (uint64_t)dim->height);
+	th_spec->end_column = min(start_column + cnt * block_size, (uint64_t)dim->width);
+	log_debug("Row: st: %u, end: %u, Column: st: %u, end: %u \n", th_spec->start_row, th_spec->end_row, th_spec->start_column, th_spec->end_column);
+
+	return 0;
+}
+
+uint8_t process_by_grid(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size)
+{
+	uint64_t blocks_x = ((uint64_t)th_spec->img->dim->width + block_size - 1) / block_size;
+
+	return set_grid_blocks(th_spec, claim_block(next_block), 1, blocks_x, block_size);
+}
 
-	if (*next_x_block >= dim->height || *next_y_block >= dim->width) {
-		pthread_mutex_unlock(xy_block_mutex);
+// interleaves the bits of x (even) and y (odd)
+static uint64_t morton_index(uint32_t x, uint32_t y)
+{
+	uint64_t d = 0;
+
+	for (int bit = 0; bit < 32; bit++)
+		d |= (uint64_t)(x >> bit & 1) << (2 * bit) | (uint64_t)(y >> bit & 1) << (2 * bit + 1);
+	return d;
+}
+
+// position of (x, y) along the Hilbert curve filling the n x n square, n a power of two
+static uint64_t hilbert_index(uint32_t n, uint32_t x, uint32_t y)
+{
+	uint64_t d = 0;
+	uint32_t rx, ry, tmp;
+
+	for (uint32_t s = n / 2; s > 0; s /= 2) {
+		rx = (x & s) > 0;
+		ry = (y & s) > 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so the curve enters it at its origin
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			tmp = x;
+			x = y;
+			y = tmp;
+		}
+	}
+	return d;
+}
+
+struct order_key {
+	uint64_t key;
+	uint32_t tile;
+};
+
+static int cmp_order_key(const void *a, const void *b)
+{
+	const struct order_key *x = a, *y = b;
+
+	return (x->key > y->key) - (x->key < y->key);
+}
+
+int grid_order_init(struct grid_order *order, const struct img_dim *dim, uint32_t block_size, enum conv_tile_order policy)
+{
+	uint64_t tiles_x = ((uint64_t)dim->width + block_size - 1) / block_size;
+	uint64_t tiles_y = ((uint64_t)dim->height + block_size - 1) / block_size;
+	struct order_key *keys = NULL;
+	uint32_t side = 1, x, y;
+
+	memset(order, 0, sizeof(*order));
+	if (policy == CONV_ORDER_RASTER)
+		return 0;
+	if (tiles_x * tiles_y > UINT32_MAX) {
+		log_error("Error: Too many tiles (%llu) for --order, use a bigger block.", (unsigned long long)(tiles_x * tiles_y));
+		return -1;
+	}
+
+	order->tiles_x = tiles_x;
+	order->tile_cnt = tiles_x * tiles_y;
+	order->tiles = malloc(order->tile_cnt * sizeof(uint32_t));
+	keys = malloc(order->tile_cnt * sizeof(struct order_key));
+	if (!order->tiles || !keys) {
+		log_error("Error: Failed to allocate the tile order.");
+		free(keys);
+		grid_order_free(order);
+		return -1;
+	}
+
+	while (side < tiles_x || side < tiles_y)
+		side *= 2;
+	for (uint32_t i = 0; i < order->tile_cnt; i++) {
+		x = i % tiles_x;
+		y = i / tiles_x;
+		keys[i].key = policy == CONV_ORDER_HILBERT ? hilbert_index(side, x, y) : morton_index(x, y);
+		keys[i].tile = i;
+	}
+	qsort(keys, order->tile_cnt, sizeof(struct order_key), cmp_order_key);
+	for (uint32_t i = 0; i < order->tile_cnt; i++)
+		order->tiles[i] = keys[i].tile;
+	free(keys);
+
+	return 0;
+}
+
+void grid_order_free(struct grid_order *order)
+{
+	free(order->tiles);
+	order->tiles = NULL;
+}
+
+uint8_t process_by_grid_order(struct thread_spec *th_spec, uint64_t *next_block, const struct grid_order *order, uint32_t block_size)
+{
+	uint64_t idx = claim_block(next_block);
+
+	if (idx >= order->tile_cnt) {
 		th_spec->start_row = th_spec->end_row = 0;
 		th_spec->start_column = th_spec->end_column = 0;
 		return 1;
 	}
+	return set_grid_blocks(th_spec, order->tiles[idx], 1, order->tiles_x, block_size);
+}
+
+uint8_t process_by_pixel(struct thread_spec *th_spec, uint64_t *next_block)
+{
+	return process_by_grid(th_spec, next_block, 1);
+}
+
+uint8_t process_by_guided(struct thread_spec *th_spec, uint64_t *next_block, uint32_t threadnum, uint32_t block_size)
+{
+	struct img_dim *dim = th_spec->img->dim;
+	uint64_t blocks_x = ((uint64_t)dim->width + block_size - 1) / block_size;
+	uint64_t block_cnt = blocks_x * (((uint64_t)dim->height + block_size - 1) / block_size);
+	uint64_t idx = __atomic_load_n(next_block, __ATOMIC_RELAXED);
+	uint64_t cnt;
+
+	do {
+		if (idx >= block_cnt) {
+			th_spec->start_row = th_spec->end_row = 0;
+			th_spec->start_column = th_spec->end_column = 0;
+			return 1;
+		}
+		cnt = max((block_cnt - idx) / (GUIDED_CHUNK_DIV * (uint64_t)threadnum), 1);
+		// a chunk doesn't cross a row of blocks, so it stays one rectangle
+		cnt = min(cnt, blocks_x - idx % blocks_x);
+	} while (!__atomic_compare_exchange_n(next_block, &idx, idx + cnt, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return set_grid_blocks(th_spec, idx, cnt, blocks_x, block_size);
+}
+
+static inline uint64_t pack_range(uint32_t begin, uint32_t end)
+{
+	return (uint64_t)begin << 32 | end;
+}
 
-	th_spec->start_row = *next_x_block;
-	th_spec->start_column = *next_y_block;
-	*next_y_block += block_size;
+int steal_sched_init(struct steal_sched *sched, const struct img_dim *dim, uint32_t block_size, uint32_t threadnum)
+{
+	uint64_t tiles_x = ((uint64_t)dim->width + block_size - 1) / block_size;
+	uint64_t tiles_y = ((uint64_t)dim->height + block_size - 1) / block_size;
+	uint32_t i;
+
+	if (tiles_x * tiles_y > UINT32_MAX) {
+		log_error("Error: %llu tiles don't fit the work-stealing deques, increase --block.", (unsigned long long)(tiles_x * tiles_y));
+		return -1;
+	}
 
-	if (*next_y_block >= dim->width) {
-		*next_y_block = 0;
-		*next_x_block += block_size;
+	sched->deques = calloc(threadnum, sizeof(*sched->deques));
+	if (!sched->deques) {
+		log_error("Error: Failed to allocate work-stealing deques.");
+		return -1;
 	}
-	pthread_mutex_unlock(xy_block_mutex);
+	sched->threadnum = threadnum;
+	sched->tiles_x = tiles_x;
+	sched->tile_cnt = tiles_x * tiles_y;
 
-	th_spec->end_row = fmin(th_spec->start_row + block_size, dim->height);
-	th_spec->end_column = fmin(th_spec->start_column + block_size, dim->width);
-	log_debug("Row: st: %d, end: %d, Column: st: %d, end: %d \n", th_spec->start_row, th_spec->end_row, th_spec->start_column, th_spec->end_column);
+	for (i = 0; i < threadnum; i++)
+		sched->deques[i].range = pack_range((uint64_t)sched->tile_cnt * i / threadnum, (uint64_t)sched->tile_cnt * (i + 1) / threadnum);
 
 	return 0;
 }
 
-uint8_t process_by_pixel(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t *next_y_block, pthread_mutex_t *xy_block_mutex)
+void steal_sched_free(struct steal_sched *sched)
+{
+	free(sched->deques);
+	sched->deques = NULL;
+}
+
+// takes the back half of the largest range left into the (empty) deque of `tid`, returns 0 once every range is empty
+static int steal_half(struct steal_sched *sched, uint32_t tid)
+{
+	uint64_t range, best_range;
+	uint32_t begin, end, take, best_cnt, k, victim, best;
+
+	while (1) {
+		best_cnt = 0;
+		best = best_range = 0;
+		for (k = 1; k < sched->threadnum; k++) {
+			victim = (tid + k) % sched->threadnum;
+			range = __atomic_load_n(&sched->deques[victim].range, __ATOMIC_RELAXED);
+			begin = range >> 32;
+			end = (uint32_t)range;
+			if (end > begin && end - begin > best_cnt) {
+				best_cnt = end - begin;
+				best = victim;
+				best_range = range;
+			}
+		}
+		if (best_cnt == 0)
+			return 0;
+
+		// the packed word is the whole state of a deque, so a CAS that matches an old value is still right
+		begin = best_range >> 32;
+		end = (uint32_t)best_range;
+		take = (best_cnt + 1) / 2;
+		if (__atomic_compare_exchange_n(&sched->deques[best].range, &best_range, pack_range(begin, end - take), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			// nobody steals from an empty deque, a plain store is enough
+			__atomic_store_n(&sched->deques[tid].range, pack_range(end - take, end), __ATOMIC_RELAXED);
+			log_debug("Thread %u stole tiles [%u, %u) from thread %u", tid, end - take, end, best);
+			return 1;
+		}
+	}
+}
+
+uint8_t process_by_steal(struct thread_spec *th_spec, struct steal_sched *sched, uint32_t tid, uint32_t block_size)
 {
-	return process_by_grid(th_spec, next_x_block, next_y_block, 1, xy_block_mutex);
+	struct steal_deque *own = &sched->deques[tid];
+	uint64_t range;
+	uint32_t begin, end;
+
+	do {
+		range = __atomic_load_n(&own->range, __ATOMIC_RELAXED);
+		while (1) {
+			begin = range >> 32;
+			end = (uint32_t)range;
+			if (begin >= end)
+				break;
+			// tiles are independent, the join of the workers orders their results
+			if (__atomic_compare_exchange_n(&own->range, &range, pack_range(begin + 1, end), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				return set_grid_blocks(th_spec, begin, 1, sched->tiles_x, block_size);
+		}
+	} while (steal_half(sched, tid));
+
+	th_spec->start_row = th_spec->end_row = 0;
+	th_spec->start_column = th_spec->end_column = 0;
+	return 1;
 }
@@ -6,19 +6,135 @@
 #include "utils/utils.h"
 #include "utils/threads-general.h"
 #include <math.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 /**
  * Functions to process the image by a specific distribution type.
+ * Each call claims the next block with one atomic fetch-add on `next_block`, a linear block index
+ * (row/column band, grid block in row-major order, or pixel) shared by all the threads of one computation, and sets the borders of `th_spec` to it.
+ * No locks are taken, so any number of computations can run at once as long as each has its own counter.
  *
  * @param th_spec - thread_spec structure with start/end row/columns - borders of the thread execution
- * @param next_*_block - pointer to the uint16_t denoting the next calc start
- * @param mutext - you already know who it is. its ya boi ....
- * @return
- */
-uint8_t process_by_row(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t block_size, pthread_mutex_t *x_block_mutex);
-uint8_t process_by_column(struct thread_spec *th_spec, uint16_t *next_y_block, uint16_t block_size, pthread_mutex_t *y_block_mutex);
-uint8_t process_by_grid(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t *next_y_block, uint16_t block_size, pthread_mutex_t *xy_block_mutex);
-uint8_t process_by_pixel(struct thread_spec *th_spec, uint16_t *next_x_block, uint16_t *next_y_block, pthread_mutex_t *xy_block_mutex);
+ * @param next_block - counter of claimed blocks, starts at 0
+ * @param block_size - band width or grid block side
+ * @return 0 if a block was claimed, 1 if the image is exhausted
+ */
+uint8_t process_by_row(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size);
+uint8_t process_by_column(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size);
+uint8_t process_by_grid(struct thread_spec *th_spec, uint64_t *next_block, uint32_t block_size);
+uint8_t process_by_pixel(struct thread_spec *th_spec, uint64_t *next_block);
+
+/**
+ * Claim order of the by_grid tiles along a space-filling curve (--order), so the successive tiles of a thread are neighbours
+ * in both directions and share their halo rows while they are still cached. Raster order has no table.
+ */
+struct grid_order {
+	uint32_t *tiles; // row-major tile index of the i-th claim
+	uint32_t tiles_x;
+	uint32_t tile_cnt;
+};
+
+/**
+ * Builds the claim order of the tiles: Morton (Z-order) or Hilbert index of (column, row) of a tile on the smallest
+ * power-of-two square covering the grid, tiles sorted by it (cells outside of the grid are skipped).
+ *
+ * @param order - order to initialize, left empty for CONV_ORDER_RASTER
+ * @param dim - image dimensions
+ * @param block_size - tile side
+ * @param policy - curve
+ * @return 0 on success, -1 on error
+ */
+int grid_order_init(struct grid_order *order, const struct img_dim *dim, uint32_t block_size, enum conv_tile_order policy);
+void grid_order_free(struct grid_order *order);
+
+/**
+ * by_grid with the claim order of `order`: claim i (one atomic fetch-add on `next_block`) gets tile order->tiles[i].
+ *
+ * @return 0 if a tile was claimed, 1 if the image is exhausted
+ */
+uint8_t process_by_grid_order(struct thread_spec *th_spec, uint64_t *next_block, const struct grid_order *order, uint32_t block_size);
+
+#define STRIP_MIN_TILE_ROWS 16
+
+// per-worker buffers of column_strip_computation(), grown on demand and reused for every strip
+struct strip_stage {
+	bmp_pixel *in; // sub-tile with its halo, contiguous
+	bmp_pixel *out;
+	bmp_pixel **in_rows;
+	bmp_pixel **out_rows;
+	size_t px_cap;
+	size_t rows_cap;
+};
+
+/**
+ * Computes the column strip claimed by process_by_column() in height-blocked sub-tiles instead of one pass over the whole height.
+ * Every sub-tile and its halo is copied into `stage` (border pixels resolved as the filter does: clamped, or wrapped for the median),
+ * the filter runs on the contiguous copy and the result rows are copied back, so the engines walk a few pages instead of a short segment of every image row.
+ * Sub-tiles are sized so the staged input and output fit into half of L2.
+ * Images with prepass data addressed in image coordinates (grayscale planes, uniform map, bilateral grid), decimated output, morphology
+ * and the tiled engine (which stages by itself) are computed in place, still sub-tile by sub-tile. Results are identical to filter_part_computation().
+ *
+ * @param th_spec - thread_spec with the strip borders
+ * @param stage - buffers of the calling worker, zero-initialized before the first call
+ */
+void column_strip_computation(struct thread_spec *th_spec, struct strip_stage *stage);
+void strip_stage_free(struct strip_stage *stage);
+
+#define GUIDED_CHUNK_DIV 2 // a guided chunk is 1 / (GUIDED_CHUNK_DIV * threadnum) of the blocks left
+
+/**
+ * Guided scheduling over the grid blocks of by_grid (by_pixel with `block_size` 1).
+ * Claims a run of blocks in row-major order, sized remaining / (GUIDED_CHUNK_DIV * threadnum) and cut at the end of the row of blocks,
+ * so chunks start large (few claims) and shrink to a single block towards the end (no stragglers).
+ * The claim is a CAS on `next_block`, which counts claimed blocks.
+ *
+ * @param th_spec - thread_spec whose borders are set to the claimed run
+ * @param next_block - counter of claimed blocks, starts at 0
+ * @param threadnum - number of threads sharing `next_block`
+ * @param block_size - grid block side, the smallest chunk
+ * @return 0 if a chunk was claimed, 1 if the image is exhausted
+ */
+uint8_t process_by_guided(struct thread_spec *th_spec, uint64_t *next_block, uint32_t threadnum, uint32_t block_size);
+
+// one deque per thread, padded to a cache line so owners popping their own deque don't share lines
+struct steal_deque {
+	uint64_t range; // unclaimed tiles [begin, end), begin in the high 32 bits
+	char pad[56];
+};
+
+/**
+ * Work-stealing scheduler over the tiles of by_grid (row-major index, `block_size` sided).
+ * Every thread starts with a contiguous range of tiles, so its consecutive tiles are neighbours in the image.
+ * Owner takes tiles from the front of its range; a thread whose range is empty takes the back half of the largest range left.
+ * A range is one 64-bit word changed only by CAS, so every tile is claimed exactly once without locks.
+ */
+struct steal_sched {
+	struct steal_deque *deques;
+	uint32_t threadnum;
+	uint32_t tiles_x;
+	uint32_t tile_cnt;
+};
+
+/**
+ * Splits the tiles of the image into `threadnum` equal contiguous ranges.
+ *
+ * @param sched - scheduler to initialize
+ * @param dim - image dimensions
+ * @param block_size - tile side
+ * @param threadnum - number of deques
+ * @return 0 on success, -1 on error
+ */
+int steal_sched_init(struct steal_sched *sched, const struct img_dim *dim, uint32_t block_size, uint32_t threadnum);
+void steal_sched_free(struct steal_sched *sched);
+
+/**
+ * Claims the next tile for thread `tid`, stealing half of another range when its own one is empty.
+ *
+ * @param th_spec - thread_spec whose borders are set to the claimed tile
+ * @param sched - scheduler shared by all the threads of one computation
+ * @param tid - index of the caller's deque
+ * @param block_size - tile side, same as passed to steal_sched_init()
+ * @return 0 if a tile was claimed, 1 if all the deques are empty
+ */
+uint8_t process_by_steal(struct thread_spec *th_spec, struct steal_sched *sched, uint32_t tid, uint32_t block_size);
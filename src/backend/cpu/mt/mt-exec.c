@@ -2,34 +2,58 @@
 
 #include "mt-exec.h"
 #include <stdlib.h>
-#include <pthread.h>
 #include <string.h>
 #include "logger/log.h"
 #include "utils/threads-general.h"
+#include "utils/thread-pool.h"
+#include "utils/stats.h"
 #include "mt-compute.h"
 
-uint16_t st_next_x_block = 0;
-uint16_t st_next_y_block = 0;
-pthread_mutex_t st_xy_block_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static void *sthread_function(void *arg)
+// one worker of a computation, all workers share the block counter (or the work-stealing deques)
+struct mt_worker {
+	struct thread_spec *th_spec;
+	uint64_t *next_block;
+	struct steal_sched *steal;
+	struct grid_order *order; // by_grid claim order, no table for raster
+	struct strip_stage stage; // by_column sub-tile buffers
+	uint32_t id;
+	uint32_t threadnum;
+	uint64_t claims; // blocks (chunks in guided mode) taken by this worker, each one is a synchronization point
+};
+
+static void mt_task(void *ctx, int idx)
 {
-	struct thread_spec *th_spec = (struct thread_spec *)arg;
+	struct mt_worker *worker = (struct mt_worker *)ctx + idx;
+	struct thread_spec *th_spec = worker->th_spec;
 	int8_t result = 0;
 
+	if (!th_spec || !th_spec->st_gen_info || !th_spec->st_gen_info->args || !th_spec->st_gen_info->args->compute_cfg.filter_type || !th_spec->st_gen_info->filters) {
+		log_error("Error: Invalid state before filter_part_computation.\n");
+		return;
+	}
+
 	while (1) {
 		switch ((enum conv_compute_mode)th_spec->st_gen_info->args->compute_cfg.compute_mode) {
 		case CONV_COMPUTE_BY_ROW:
-			result = process_by_row(th_spec, &st_next_x_block, th_spec->st_gen_info->args->compute_cfg.block_size, &st_xy_block_mutex);
+			result = process_by_row(th_spec, worker->next_block, th_spec->st_gen_info->args->compute_cfg.block_size);
 			break;
 		case CONV_COMPUTE_BY_COLUMN:
-			result = process_by_column(th_spec, &st_next_y_block, th_spec->st_gen_info->args->compute_cfg.block_size, &st_xy_block_mutex);
+			result = process_by_column(th_spec, worker->next_block, th_spec->st_gen_info->args->compute_cfg.block_size);
 			break;
 		case CONV_COMPUTE_BY_PIXEL:
-			result = process_by_pixel(th_spec, &st_next_x_block, &st_next_y_block, &st_xy_block_mutex);
+			result = process_by_pixel(th_spec, worker->next_block);
 			break;
 		case CONV_COMPUTE_BY_GRID:
-			result = process_by_grid(th_spec, &st_next_x_block, &st_next_y_block, th_spec->st_gen_info->args->compute_cfg.block_size, &st_xy_block_mutex);
+			if (worker->order->tiles)
+				result = process_by_grid_order(th_spec, worker->next_block, worker->order, th_spec->st_gen_info->args->compute_cfg.block_size);
+			else
+				result = process_by_grid(th_spec, worker->next_block, th_spec->st_gen_info->args->compute_cfg.block_size);
+			break;
+		case CONV_COMPUTE_WORK_STEAL:
+			result = process_by_steal(th_spec, worker->steal, worker->id, th_spec->st_gen_info->args->compute_cfg.block_size);
+			break;
+		case CONV_COMPUTE_GUIDED:
+			result = process_by_guided(th_spec, worker->next_block, worker->threadnum, th_spec->st_gen_info->args->compute_cfg.block_size);
 			break;
 		default:
 			log_error("Error: Invalid mode %d in thread function.\n", th_spec->st_gen_info->args->compute_cfg.compute_mode);
@@ -38,85 +62,93 @@ static void *sthread_function(void *arg)
 		}
 
 		if (result != 0)
-			goto exit;
+			return;
+		worker->claims++;
 
-		if (!th_spec || !th_spec->st_gen_info->args || !th_spec->st_gen_info->args->compute_cfg.filter_type || !th_spec->st_gen_info->filters) {
-			log_error("Error: Invalid state before filter_part_computation.\n");
-			return NULL;
-		}
-		filter_part_computation(th_spec);
+		if (th_spec->st_gen_info->args->compute_cfg.compute_mode == CONV_COMPUTE_BY_COLUMN)
+			column_strip_computation(th_spec, &worker->stage);
+		else
+			filter_part_computation(th_spec);
 	}
+}
 
-exit:
-	return NULL;
+static void report_claims(const struct mt_worker *workers, int threadnum)
+{
+	uint64_t total = 0, max_claims = 0;
+	int i;
+
+	for (i = 0; i < threadnum; i++) {
+		log_debug("Thread %d claimed %llu blocks", i, (unsigned long long)workers[i].claims);
+		total += workers[i].claims;
+		max_claims = max(max_claims, workers[i].claims);
+	}
+	stats_add(&run_stats.mt_claims, total);
+	stats_add(&run_stats.mt_threads, threadnum);
+	stats_max(&run_stats.mt_claims_max, max_claims);
 }
 
 double execute_mt_computation(int threadnum, struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters)
 {
-	pthread_t *th = NULL;
 	double start_time = 0, end_time = 0;
-	int8_t create_error = 0;
 	size_t i = 0;
 	struct thread_spec *th_spec[threadnum];
+	struct mt_worker workers[threadnum];
+	uint64_t next_block = 0;
+	struct steal_sched steal = { 0 };
+	struct grid_order order = { 0 };
 
-	th = malloc(threadnum * sizeof(pthread_t));
-	if (!th) {
-		goto mem_err;
+	if (args->compute_cfg.compute_mode == CONV_COMPUTE_WORK_STEAL && steal_sched_init(&steal, img_spec->dim, args->compute_cfg.block_size, threadnum) < 0)
+		return 0;
+	if (args->compute_cfg.compute_mode == CONV_COMPUTE_BY_GRID && grid_order_init(&order, img_spec->dim, args->compute_cfg.block_size, args->compute_cfg.order) < 0) {
+		steal_sched_free(&steal);
+		return 0;
 	}
 
-	// setup thread-locals details before thread creation
+	// setup task-local details before submitting to the pool
 	for (i = 0; i < (size_t)threadnum; i++) {
 		th_spec[i] = init_thread_spec(args, filters);
 		if (!th_spec[i]) {
-			create_error = -1;
 			log_error("Memory allocation error for thread_spec %d\n", i);
 			threadnum = i;
-			break;
+			goto mem_th_err;
 		}
 
 		th_spec[i]->img = img_spec;
+		workers[i].th_spec = th_spec[i];
+		workers[i].next_block = &next_block;
+		workers[i].steal = &steal;
+		workers[i].order = &order;
+		workers[i].id = i;
+		workers[i].threadnum = threadnum;
+		workers[i].claims = 0;
+		memset(&workers[i].stage, 0, sizeof(workers[i].stage));
 	}
-	if (create_error < 0)
-		goto mem_th_err;
 
 	start_time = get_time_in_seconds();
-	for (i = 0; i < (size_t)threadnum; i++) {
-		if (pthread_create(&th[i], NULL, sthread_function, th_spec[i]) != 0) {
-			log_error("Failed to create a thread");
-			free(th_spec[i]->st_gen_info);
-			free(th_spec[i]);
-			create_error = 1;
-			threadnum = i;
-			break;
-		}
-	}
+	// pinned pool: task i stays on thread i, which first-touched band i (affinity_first_touch)
+	if (args->compute_cfg.affinity != CONV_AFFINITY_NONE && args->compute_cfg.queue == CONV_QUEUE_DISABLED)
+		thread_pool_run_bound(threadnum, mt_task, workers);
+	else
+		thread_pool_run(threadnum, mt_task, workers);
+	end_time = get_time_in_seconds();
 
 	for (i = 0; i < (size_t)threadnum; i++) {
-		if (pthread_join(th[i], NULL)) {
-			log_error("Failed to join a thread");
-			break;
-		}
 		free(th_spec[i]->st_gen_info);
 		free(th_spec[i]);
+		strip_stage_free(&workers[i].stage);
 	}
+	steal_sched_free(&steal);
+	grid_order_free(&order);
+	report_claims(workers, threadnum);
 
-	end_time = get_time_in_seconds();
-
-	if (create_error) {
-		free(th);
-		return 0;
-	}
-
-	free(th);
 	return end_time - start_time;
 
-mem_err:
-	log_error("Error: Memory allocation failed\n");
-	return 0;
-
 mem_th_err:
 	for (i = 0; i < (size_t)threadnum; i++) {
+		free(th_spec[i]->st_gen_info);
 		free(th_spec[i]);
 	}
+	steal_sched_free(&steal);
+	grid_order_free(&order);
 	return 0;
 }
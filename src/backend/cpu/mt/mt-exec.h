@@ -5,5 +5,10 @@
 #include "libbmp/libbmp.h"
 #include "utils/threads-general.h"
 
-// mmmm its intuitively clear, too late to add doc
+/**
+ * Splits the image by the compute mode into `threadnum` tasks on the shared thread pool (see thread_pool_run()).
+ * Every task claims blocks until the image is exhausted, so tasks of several images can share the pool.
+ *
+ * @return Time spent (in seconds) for the computation, or 0 on error.
+ */
 double execute_mt_computation(int threadnum, struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters);
@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "mt-tune.h"
+#include "mt-exec.h"
+#include "logger/log.h"
+#include "utils/hw-info.h"
+#include "utils/stats.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TUNE_MIN_BAND_ROWS 128
+#define TUNE_BAND_FRACTION 16 // the band is 1/16 of the image, but at least TUNE_MIN_BAND_ROWS
+#define TUNE_THREADS_GAIN 0.95 // fewer threads are taken only if at least 5% faster
+#define TUNE_DEFAULT_BLOCK 32
+#define TUNE_KEY_LEN 384
+
+// by_pixel is left out, it ignores the block size and always loses to the others
+static const enum conv_compute_mode tune_modes[] = { CONV_COMPUTE_BY_ROW, CONV_COMPUTE_BY_COLUMN, CONV_COMPUTE_BY_GRID, CONV_COMPUTE_WORK_STEAL, CONV_COMPUTE_GUIDED };
+static const uint32_t tune_blocks[] = { 8, 32, 128 };
+
+struct tune_choice {
+	enum conv_compute_mode mode;
+	uint32_t block;
+	int threads;
+	double time; // on the calibration band
+};
+
+static void tune_key(char *key, size_t len, const struct img_spec *img_spec, const struct p_args *args)
+{
+	char cpu[128];
+	const struct compute_cfg *cfg = &args->compute_cfg;
+
+	hw_get_cpu_model(cpu, sizeof(cpu));
+	for (char *c = cpu; *c; c++) {
+		if (*c == '\t')
+			*c = ' ';
+	}
+	// CPU, dimensions, filter with everything that changes its cost, --threadnum (the upper bound of the search), --affinity
+	// (pinning changes the timings compared) and a fixed --block
+	snprintf(key, len, "%s\t%ux%u\t%s s%g sr%g r%u d%u%s%s%s%s o%s\t%d a%s b%u", cpu, img_spec->dim->width, img_spec->dim->height, cfg->filter_type, cfg->sigma,
+		 cfg->sigma_r, cfg->radius, cfg->decimate, cfg->tiled ? " +tile" : "", cfg->winograd ? " +winograd" : "", cfg->gray ? " +gray" : "",
+		 cfg->uniform_skip ? " +uniform" : "", valid_orders[cfg->order], args->compute_ctx.threadnum, valid_affinities[cfg->affinity], cfg->block_size);
+}
+
+static int mode_from_str(const char *str, enum conv_compute_mode *mode)
+{
+	for (size_t i = 0; i < sizeof(tune_modes) / sizeof(tune_modes[0]); i++) {
+		if (strcmp(str, compute_mode_to_str(tune_modes[i])) == 0) {
+			*mode = tune_modes[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// the last entry of the key wins, so a recalibration simply appends
+static int cache_lookup(const char *key, struct tune_choice *choice)
+{
+	char line[TUNE_KEY_LEN + 64], mode_str[32];
+	size_t key_len = strlen(key);
+	struct tune_choice entry;
+	FILE *file = fopen(TUNE_CACHE_FILE_PATH, "r");
+	int found = -1;
+
+	if (!file)
+		return -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, key, key_len) != 0 || line[key_len] != '\t')
+			continue;
+		if (sscanf(line + key_len + 1, "%31s %u %d %lf", mode_str, &entry.block, &entry.threads, &entry.time) != 4 || mode_from_str(mode_str, &entry.mode) < 0 ||
+		    entry.block == 0 || entry.threads <= 0 || entry.threads > INT8_MAX) {
+			log_warn("Warn: Skipping malformed entry in tuning cache '%s'.", TUNE_CACHE_FILE_PATH);
+			continue;
+		}
+		*choice = entry;
+		found = 0;
+	}
+	fclose(file);
+
+	return found;
+}
+
+static void cache_store(const char *key, const struct tune_choice *choice)
+{
+	FILE *file = fopen(TUNE_CACHE_FILE_PATH, "a");
+
+	if (!file) {
+		log_warn("Warn: Could not open tuning cache '%s' for appending, the calibration will be repeated next time.", TUNE_CACHE_FILE_PATH);
+		return;
+	}
+	// CPU Dimensions Filter Threadnum Mode Block Threads BandTime
+	fprintf(file, "%s\t%s %u %d %.6f\n", key, compute_mode_to_str(choice->mode), choice->block, choice->threads, choice->time);
+	fclose(file);
+}
+
+// one run of a candidate on the band, 0 on error
+static double time_candidate(struct img_spec *band, struct p_args *args, struct filter_mix *filters, const struct tune_choice *candidate)
+{
+	double time;
+
+	args->compute_cfg.compute_mode = candidate->mode;
+	args->compute_cfg.block_size = candidate->block;
+	time = execute_mt_computation(candidate->threads, band, args, filters);
+	log_debug("Auto-tune: %s block=%u threads=%d: %.6f s", compute_mode_to_str(candidate->mode), candidate->block, candidate->threads, time);
+
+	return time;
+}
+
+static int calibrate(struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters, uint32_t user_block, struct tune_choice *best)
+{
+	struct img_dim band_dim = *img_spec->dim;
+	struct img_spec band = *img_spec;
+	struct tune_choice candidate;
+	struct run_stats saved_stats = run_stats;
+	size_t block_cnt = user_block ? 1 : sizeof(tune_blocks) / sizeof(tune_blocks[0]);
+	int threadnum = args->compute_ctx.threadnum;
+
+	// the top rows keep every row pointer and prepass structure valid as they are
+	band_dim.height = min(img_spec->dim->height, max(TUNE_MIN_BAND_ROWS, img_spec->dim->height / TUNE_BAND_FRACTION));
+	band.dim = &band_dim;
+	best->time = 0;
+
+	// warm-up, so the first candidate doesn't pay for cold caches and page faults
+	candidate.mode = tune_modes[0];
+	candidate.block = user_block ? user_block : tune_blocks[0];
+	candidate.threads = threadnum;
+	if (time_candidate(&band, args, filters, &candidate) <= 0)
+		goto err;
+
+	for (size_t m = 0; m < sizeof(tune_modes) / sizeof(tune_modes[0]); m++) {
+		for (size_t b = 0; b < block_cnt; b++) {
+			candidate.mode = tune_modes[m];
+			candidate.block = user_block ? user_block : tune_blocks[b];
+			candidate.threads = threadnum;
+			candidate.time = time_candidate(&band, args, filters, &candidate);
+			if (candidate.time <= 0)
+				goto err;
+			if (best->time == 0 || candidate.time < best->time)
+				*best = candidate;
+		}
+	}
+
+	// memory-bound filters may not scale to every thread
+	candidate = *best;
+	for (candidate.threads = threadnum / 2; candidate.threads >= 1; candidate.threads /= 2) {
+		candidate.time = time_candidate(&band, args, filters, &candidate);
+		if (candidate.time <= 0)
+			goto err;
+		if (candidate.time < best->time * TUNE_THREADS_GAIN)
+			*best = candidate;
+	}
+
+	// calibration runs aren't part of the reported claim statistics
+	run_stats = saved_stats;
+	return 0;
+
+err:
+	run_stats = saved_stats;
+	log_error("Error: Auto-tune calibration run failed.");
+	return -1;
+}
+
+static void apply_choice(struct p_args *args, const struct tune_choice *choice)
+{
+	args->compute_cfg.compute_mode = choice->mode;
+	args->compute_cfg.block_size = choice->block;
+	args->compute_ctx.threadnum = choice->threads;
+	args->compute_cfg.threadnum = choice->threads > 1 ? CONV_THREAD_MULTI : CONV_THREAD_SINGLE;
+}
+
+int mt_autotune(struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters)
+{
+	struct tune_choice choice = { 0 };
+	char key[TUNE_KEY_LEN];
+	uint32_t user_block = args->compute_cfg.block_size;
+	double start_time;
+
+	if (args->compute_ctx.threadnum <= 1 || filter_is_whole_image(args->compute_cfg.filter_type) || args->compute_cfg.inplace) {
+		choice.mode = CONV_COMPUTE_BY_ROW;
+		choice.block = user_block ? user_block : TUNE_DEFAULT_BLOCK;
+		choice.threads = args->compute_ctx.threadnum;
+		apply_choice(args, &choice);
+		log_info("Auto-tune: this run doesn't use the MT partitioning, using by_row.");
+		return 0;
+	}
+
+	tune_key(key, sizeof(key), img_spec, args);
+	if (cache_lookup(key, &choice) == 0) {
+		apply_choice(args, &choice);
+		log_info("Auto-tune (cached): mode=%s block=%u threads=%d", compute_mode_to_str(choice.mode), choice.block, choice.threads);
+		return 0;
+	}
+
+	start_time = get_time_in_seconds();
+	if (calibrate(img_spec, args, filters, user_block, &choice) < 0)
+		return -1;
+	apply_choice(args, &choice);
+	cache_store(key, &choice);
+	log_info("Auto-tune: mode=%s block=%u threads=%d, calibrated in %.3f s", compute_mode_to_str(choice.mode), choice.block, choice.threads,
+		 get_time_in_seconds() - start_time);
+
+	return 0;
+}
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "utils/threads-general.h"
+
+#define TUNE_CACHE_FILE_PATH ".bmp-conv-tune.dat"
+
+/**
+ * Resolves --mode=auto into a compute mode, block size and thread count for this image and filter.
+ * The first run calibrates: every candidate mode/block pair is timed with execute_mt_computation() on a band of the top rows of the image
+ * (results land in the output and are overwritten by the real computation), then halved thread counts are tried with the winner.
+ * The choice is appended to TUNE_CACHE_FILE_PATH, keyed by CPU model, image dimensions, filter (with the engine options), --threadnum and --block,
+ * so later runs with the same key skip the calibration. A --block given on the command line is kept and only the mode and thread count are tuned.
+ * Runs that don't use the MT partitioning (single thread, whole-image filters, --inplace) get by_row without calibrating.
+ *
+ * @param img_spec Image spec of the run, with the prepass data (grayscale planes, uniform map, bilateral grid) already attached.
+ * @param args Arguments, compute_mode, block_size and compute_ctx.threadnum are replaced with the choice.
+ * @param filters Filters of the run.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int mt_autotune(struct img_spec *img_spec, struct p_args *args, struct filter_mix *filters);
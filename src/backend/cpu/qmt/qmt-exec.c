@@ -5,6 +5,9 @@
 #include "logger/log.h"
 #include "utils/qmt-queue.h"
 #include "qmt-threads.h"
+#include "qmt-rebalance.h"
+#include "utils/affinity.h"
+#include "utils/stats.h"
 #include <pthread.h>
 #include <string.h>
 #include <stdatomic.h>
@@ -20,6 +23,7 @@
 int allocate_qthread_resources(struct qthreads_gen_info *qt_info, struct p_args *args_ptr, struct img_queue *input_queue, struct img_queue *output_queue)
 {
 	size_t q_mem_limit = 0;
+	uint16_t thread_budget = args_ptr->compute_ctx.qm.threads_cfg.reader_cnt + args_ptr->compute_ctx.qm.threads_cfg.worker_cnt + args_ptr->compute_ctx.qm.threads_cfg.writer_cnt;
 
 	qt_info->ret_info = malloc(sizeof(struct threads_info));
 	qt_info->wrt_info = malloc(sizeof(struct threads_info));
@@ -38,6 +42,7 @@ int allocate_qthread_resources(struct qthreads_gen_info *qt_info, struct p_args
 	qt_info->ret_info->threads = NULL;
 	qt_info->wrt_info->threads = NULL;
 	qt_info->wot_info->threads = NULL;
+	qt_info->role_threads = NULL;
 
 	if (args_ptr->compute_ctx.qm.threads_cfg.worker_cnt > 0) {
 		qt_info->wot_info->threads = malloc(args_ptr->compute_ctx.qm.threads_cfg.worker_cnt * sizeof(pthread_t));
@@ -54,24 +59,36 @@ int allocate_qthread_resources(struct qthreads_gen_info *qt_info, struct p_args
 		if (!qt_info->wrt_info->threads)
 			goto mem_err_cleanup;
 	}
+	if (args_ptr->compute_ctx.qm.rebalance_ms > 0) {
+		qt_info->role_threads = calloc(thread_budget, sizeof(struct qt_role_thread));
+		if (!qt_info->role_threads)
+			goto mem_err_cleanup;
+	}
 
 	q_mem_limit = args_ptr->compute_ctx.qm.tq_memory_limit_mb > 0 ? args_ptr->compute_ctx.qm.tq_memory_limit_mb : DEFAULT_QUEUE_MEM_LIMIT;
-	queue_init(input_queue, args_ptr->compute_ctx.qm.tq_capacity, q_mem_limit);
-	queue_init(output_queue, args_ptr->compute_ctx.qm.tq_capacity, q_mem_limit);
+	// one budget for the images read, computed and waiting to be written, so the limit is the real footprint
+	mem_budget_init(&qt_info->budget, q_mem_limit * 1024 * 1024);
+	queue_init(input_queue, args_ptr->compute_ctx.qm.tq_capacity, args_ptr->compute_ctx.qm.policy);
+	queue_init(output_queue, args_ptr->compute_ctx.qm.tq_capacity, args_ptr->compute_ctx.qm.policy);
 
 	qt_info->pargs = args_ptr;
 	qt_info->input_q = input_queue;
 	qt_info->output_q = output_queue;
 
-#ifdef __APPLE__
-	qt_info->reader_barrier = malloc(1); // Dummy allocation
-#else
-	qt_info->reader_barrier = malloc(sizeof(pthread_barrier_t));
-#endif
+	qt_info->readers_busy = 0;
+	qt_info->workers_busy = 0;
+	memset(qt_info->stats, 0, sizeof(qt_info->stats));
+	qt_info->role_thread_cnt = 0;
+	qt_info->role_threads_left = thread_budget;
+	qt_info->rebalancer_started = 0;
+	if (qt_info->role_threads)
+		ec_init(&qt_info->rebalance_ec);
 
 	return 0;
 
 mem_err_cleanup: // Cleanup if thread arrays failed after info structs succeeded
+	free(qt_info->role_threads);
+	qt_info->role_threads = NULL;
 	free(qt_info->ret_info->threads);
 	free(qt_info->wot_info->threads);
 	free(qt_info->wrt_info->threads);
@@ -87,52 +104,83 @@ mem_err: // General memory error entry point
 	return -1;
 }
 
+// with --rebalance every queue thread is a role thread starting in `role`
+static int launch_qthread(struct qthreads_gen_info *qt_info, pthread_t *thread, enum qt_role role, void *(*start_routine)(void *))
+{
+	struct qt_role_thread *th;
+	int ret;
+
+	if (!qt_info->role_threads)
+		return pthread_create(thread, NULL, start_routine, qt_info);
+
+	th = &qt_info->role_threads[qt_info->role_thread_cnt];
+	th->qt_info = qt_info;
+	th->role = role;
+	th->moved = 0;
+	ret = pthread_create(thread, NULL, role_thread, th);
+	if (ret == 0)
+		qt_info->role_thread_cnt++;
+	return ret;
+}
+
 void create_qthreads(struct qthreads_gen_info *qt_info)
 {
+	const struct threads_cfg *threads_cfg = &qt_info->pargs->compute_ctx.qm.threads_cfg;
 	size_t i = 0;
-	int ret = 0;
+	int ret = 0, queue_idx = 0;
 
-	log_info("Creating %hhu readers, %hhu workers, %hhu writers", qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt, qt_info->pargs->compute_ctx.qm.threads_cfg.worker_cnt, qt_info->pargs->compute_ctx.qm.threads_cfg.writer_cnt);
+	qt_order_files(qt_info);
 
-	if (qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt > 0) {
-#ifdef __APPLE__
-		// pthread_barrier_init(qt_info->reader_barrier, NULL, qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt);
-#else
-		ret = pthread_barrier_init(qt_info->reader_barrier, NULL, qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt);
-		if (ret != 0) {
-			log_error("Failed to initialize reader barrier: %s", strerror(ret));
-			return; // Cannot proceed without barrier if readers exist
-		}
-#endif
-	}
+	log_info("Creating %hhu readers, %hhu workers, %hhu writers", qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt, qt_info->pargs->compute_ctx.qm.threads_cfg.worker_cnt, qt_info->pargs->compute_ctx.qm.threads_cfg.writer_cnt);
 
 	for (i = 0; i < qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt; i++) {
-		ret = pthread_create(&qt_info->ret_info->threads[i], NULL, reader_thread, qt_info);
+		ret = launch_qthread(qt_info, &qt_info->ret_info->threads[i], QT_ROLE_READER, reader_thread);
 		if (ret != 0) {
 			log_error("Failed to create reader thread %zu: %s", i, strerror(ret));
 			break; // Stop creating more threads on failure
 		}
+		affinity_pin_queue(qt_info->ret_info->threads[i], queue_idx++);
 		qt_info->ret_info->used_threads++;
 	}
+	// nothing will be read, let the workers drain the empty queue
+	if (qt_info->ret_info->used_threads == 0)
+		queue_close(qt_info->input_q);
 
 	for (i = 0; i < qt_info->pargs->compute_ctx.qm.threads_cfg.worker_cnt; i++) {
-		ret = pthread_create(&qt_info->wot_info->threads[i], NULL, worker_thread, qt_info);
+		ret = launch_qthread(qt_info, &qt_info->wot_info->threads[i], QT_ROLE_WORKER, worker_thread);
 		if (ret != 0) {
 			log_error("Failed to create worker thread %zu: %s", i, strerror(ret));
 			break;
 		}
+		affinity_pin_queue(qt_info->wot_info->threads[i], queue_idx++);
 		qt_info->wot_info->used_threads++;
 	}
+	// role threads that were readers become workers by themselves
+	if (qt_info->wot_info->used_threads == 0 && !qt_info->role_threads)
+		queue_close(qt_info->output_q);
 
 	for (i = 0; i < qt_info->pargs->compute_ctx.qm.threads_cfg.writer_cnt; i++) {
-		ret = pthread_create(&qt_info->wrt_info->threads[i], NULL, writer_thread, qt_info);
+		ret = launch_qthread(qt_info, &qt_info->wrt_info->threads[i], QT_ROLE_WRITER, writer_thread);
 		if (ret != 0) {
 			log_error("Failed to create writer thread %zu: %s", i, strerror(ret));
 			break;
 		}
+		affinity_pin_queue(qt_info->wrt_info->threads[i], queue_idx++);
 		qt_info->wrt_info->used_threads++;
 	}
 	log_info("Launched %zu readers, %zu workers, %zu writers", qt_info->ret_info->used_threads, qt_info->wot_info->used_threads, qt_info->wrt_info->used_threads);
+
+	if (!qt_info->role_threads)
+		return;
+	// the rebalancer exits once the count reaches 0, so the threads that never started are taken off it first
+	__atomic_sub_fetch(&qt_info->role_threads_left, threads_cfg->reader_cnt + threads_cfg->worker_cnt + threads_cfg->writer_cnt - qt_info->role_thread_cnt, __ATOMIC_ACQ_REL);
+	ret = pthread_create(&qt_info->rebalancer, NULL, rebalance_thread, qt_info);
+	if (ret != 0) {
+		log_error("Failed to create rebalancer thread: %s, the roles stay as launched", strerror(ret));
+		return;
+	}
+	qt_info->rebalancer_started = 1;
+	log_info("Rebalancing %u queue threads every %u ms", qt_info->role_thread_cnt, qt_info->pargs->compute_ctx.qm.rebalance_ms);
 }
 
 void join_qthreads(struct qthreads_gen_info *qt_info)
@@ -148,17 +196,6 @@ void join_qthreads(struct qthreads_gen_info *qt_info)
 		}
 	}
 
-	if (qt_info->pargs->compute_ctx.qm.threads_cfg.reader_cnt > 0) {
-#ifdef __APPLE__
-		// pthread_barrier_destroy(qt_info->reader_barrier);
-#else
-		ret = pthread_barrier_destroy(qt_info->reader_barrier);
-		if (ret != 0) {
-			log_error("Failed to destroy reader barrier: %s", strerror(ret));
-		}
-#endif
-	}
-
 	log_debug("Joining %zu worker threads...", qt_info->wot_info->used_threads);
 	for (i = 0; i < qt_info->wot_info->used_threads; i++) {
 		ret = pthread_join(qt_info->wot_info->threads[i], NULL);
@@ -174,6 +211,11 @@ void join_qthreads(struct qthreads_gen_info *qt_info)
 			log_error("Failed to join writer thread %zu: %s", i, strerror(ret));
 		}
 	}
+	if (qt_info->rebalancer_started) {
+		ret = pthread_join(qt_info->rebalancer, NULL);
+		if (ret != 0)
+			log_error("Failed to join rebalancer thread: %s", strerror(ret));
+	}
 	log_info("All threads joined.");
 }
 
@@ -197,11 +239,14 @@ void free_qthread_resources(struct qthreads_gen_info *qt_info)
 	queue_destroy(qt_info->input_q);
 	queue_destroy(qt_info->output_q);
 
-#ifdef __APPLE__
-	// pthread_barrier_destroy(qt_info->reader_barrier);
-#else
-	pthread_barrier_destroy(qt_info->reader_barrier);
-#endif
+	stats_max(&run_stats.queue_mem_peak, qt_info->budget.peak);
+	run_stats.queue_mem_budget = qt_info->budget.limit;
+	mem_budget_destroy(&qt_info->budget);
+
+	if (qt_info->role_threads) {
+		ec_destroy(&qt_info->rebalance_ec);
+		free(qt_info->role_threads);
+	}
 
 	free(qt_info);
 }
@@ -26,7 +26,7 @@ int allocate_qthread_resources(struct qthreads_gen_info *qt_info, struct p_args
 
 /**
  * Waits for all created reader, worker, and writer threads to complete execution
- * by joining them. Destroys the reader synchronization barrier after readers finish.
+ * by joining them. The threads exit by themselves once the queues they pop from are closed and drained.
  *
  * @param qt_info A pointer to the qthreads_gen_info structure containing the thread IDs and the count of actually created threads.
  * @return void. Errors during join are logged.
@@ -35,10 +35,10 @@ void join_qthreads(struct qthreads_gen_info *qt_info);
 
 /**
  * Creates and launches reader, worker, and writer threads based on the counts
- * specified in program arguments. Initializes a barrier for reader synchronization.
- * Stores thread IDs in the provided qt_info structure. Handles thread creation errors.
+ * specified in program arguments. Stores thread IDs in the provided qt_info structure.
+ * Threads that fail to launch are taken off the readers/workers left counters, so the queues still get closed.
  *
- * @param qt_info A pointer to the initialized qthreads_gen_info structure containing thread arrays, arguments, queues, and the barrier.
+ * @param qt_info A pointer to the initialized qthreads_gen_info structure containing thread arrays, arguments and queues.
  * @param args_ptr A pointer to the parsed program arguments (potentially redundant).
  * @return void. Errors during thread creation are logged.
  */
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "qmt-rebalance.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+#include <errno.h>
+#include <time.h>
+
+#define REBALANCE_EWMA_WEIGHT 0.5 // weight of the last interval in the service time estimate
+
+struct rebalance_state {
+	struct qt_stage_stats last[QT_ROLE_CNT];
+	double service[QT_ROLE_CNT]; // estimated seconds per item, 0 until the stage has finished one
+	double start_time;
+	uint32_t moves;
+};
+
+static void count_roles(struct qthreads_gen_info *qt_info, uint16_t *counts)
+{
+	uint8_t role;
+
+	for (int r = 0; r < QT_ROLE_CNT; r++)
+		counts[r] = 0;
+	for (uint16_t i = 0; i < qt_info->role_thread_cnt; i++) {
+		role = __atomic_load_n(&qt_info->role_threads[i].role, __ATOMIC_ACQUIRE);
+		if (role < QT_ROLE_CNT)
+			counts[role]++;
+	}
+}
+
+static void sample_service_times(struct qthreads_gen_info *qt_info, struct rebalance_state *st)
+{
+	struct qt_stage_stats now;
+	double mean;
+
+	for (int r = 0; r < QT_ROLE_CNT; r++) {
+		now.busy_ns = __atomic_load_n(&qt_info->stats[r].busy_ns, __ATOMIC_RELAXED);
+		now.done = __atomic_load_n(&qt_info->stats[r].done, __ATOMIC_RELAXED);
+		if (now.done > st->last[r].done) {
+			mean = (double)(now.busy_ns - st->last[r].busy_ns) * 1e-9 / (double)(now.done - st->last[r].done);
+			st->service[r] = st->service[r] > 0 ? (1 - REBALANCE_EWMA_WEIGHT) * st->service[r] + REBALANCE_EWMA_WEIGHT * mean : mean;
+		}
+		st->last[r] = now;
+	}
+}
+
+// moves a thread of role `from` to `to`, 0 on success
+static int move_thread(struct qthreads_gen_info *qt_info, enum qt_role from, enum qt_role to)
+{
+	struct qt_role_thread *th;
+	uint8_t expected;
+
+	for (uint16_t i = qt_info->role_thread_cnt; i-- > 0;) {
+		th = &qt_info->role_threads[i];
+		expected = from;
+		// a CAS, the thread may be moving on to the next stage by itself
+		if (!__atomic_compare_exchange_n(&th->role, &expected, to, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			continue;
+		__atomic_store_n(&th->moved, 1, __ATOMIC_SEQ_CST);
+		queue_interrupt(qt_info->input_q);
+		queue_interrupt(qt_info->output_q);
+		return 0;
+	}
+	return -1;
+}
+
+static void rebalance_step(struct qthreads_gen_info *qt_info, struct rebalance_state *st)
+{
+	uint16_t counts[QT_ROLE_CNT];
+	uint8_t live[QT_ROLE_CNT], can_grow[QT_ROLE_CNT];
+	double service[QT_ROLE_CNT];
+	uint32_t in_size = queue_size(qt_info->input_q), out_size = queue_size(qt_info->output_q);
+	double target, deficit, surplus, best_deficit = 0, best_surplus = 0, service_sum = 0;
+	uint32_t budget = 0;
+	int src = -1, dst = -1;
+
+	sample_service_times(qt_info, st);
+	count_roles(qt_info, counts);
+
+	live[QT_ROLE_READER] = __atomic_load_n(&read_files, __ATOMIC_RELAXED) < qt_info->pargs->files_cfg.file_cnt;
+	live[QT_ROLE_WORKER] = !queue_is_drained(qt_info->input_q);
+	live[QT_ROLE_WRITER] = !queue_is_drained(qt_info->output_q);
+	// a stage gets more threads only if it has work waiting and room to put the results
+	can_grow[QT_ROLE_READER] = in_size < qt_info->input_q->capacity;
+	can_grow[QT_ROLE_WORKER] = in_size > 0 && out_size < qt_info->output_q->capacity;
+	can_grow[QT_ROLE_WRITER] = out_size > 0;
+
+	for (int r = 0; r < QT_ROLE_CNT; r++) {
+		service[r] = st->service[r];
+		// a stage with work waiting that hasn't finished an item in the whole run takes at least that long per item
+		if (live[r] && service[r] == 0 && can_grow[r])
+			service[r] = get_time_in_seconds() - st->start_time;
+		if (!live[r] || service[r] == 0) {
+			live[r] = 0;
+			continue;
+		}
+		service_sum += service[r];
+		budget += counts[r];
+	}
+	if (service_sum == 0)
+		return;
+
+	// the pipeline is balanced when the threads of each stage are proportional to its service time
+	for (int r = 0; r < QT_ROLE_CNT; r++) {
+		if (!live[r])
+			continue;
+		target = budget * service[r] / service_sum;
+		deficit = target - counts[r];
+		surplus = counts[r] - target;
+		if (can_grow[r] && deficit > best_deficit) {
+			best_deficit = deficit;
+			dst = r;
+		}
+		if (counts[r] > 1 && surplus > best_surplus) {
+			best_surplus = surplus;
+			src = r;
+		}
+	}
+
+	log_debug("Rebalance: R/W/T %u/%u/%u, service %.3f/%.3f/%.3f ms, queued %u in / %u out", counts[QT_ROLE_READER], counts[QT_ROLE_WORKER], counts[QT_ROLE_WRITER],
+		  service[QT_ROLE_READER] * 1e3, service[QT_ROLE_WORKER] * 1e3, service[QT_ROLE_WRITER] * 1e3, in_size, out_size);
+
+	// only moves that bring the counts closer to the targets, so a steady load doesn't make threads bounce
+	if (src < 0 || dst < 0 || src == dst || best_deficit + best_surplus <= 1)
+		return;
+	if (move_thread(qt_info, src, dst) < 0)
+		return;
+
+	st->moves++;
+	counts[src]--;
+	counts[dst]++;
+	log_info("Rebalance: moved a thread %s -> %s, R/W/T now %u/%u/%u (service %.3f/%.3f/%.3f ms, queued %u in / %u out)", qt_role_to_str(src), qt_role_to_str(dst),
+		 counts[QT_ROLE_READER], counts[QT_ROLE_WORKER], counts[QT_ROLE_WRITER], service[QT_ROLE_READER] * 1e3, service[QT_ROLE_WORKER] * 1e3,
+		 service[QT_ROLE_WRITER] * 1e3, in_size, out_size);
+}
+
+void *rebalance_thread(void *arg)
+{
+	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
+	struct rebalance_state st = { 0 };
+	uint32_t interval_ms = qt_info->pargs->compute_ctx.qm.rebalance_ms;
+	struct timespec abstime;
+	uint32_t key;
+
+	st.start_time = get_time_in_seconds();
+	log_debug("Rebalancer started, interval %u ms.", interval_ms);
+
+	while (1) {
+		key = ec_prepare_wait(&qt_info->rebalance_ec);
+		if (__atomic_load_n(&qt_info->role_threads_left, __ATOMIC_ACQUIRE) == 0) {
+			ec_cancel_wait(&qt_info->rebalance_ec);
+			break;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &abstime);
+		abstime.tv_sec += interval_ms / 1000;
+		abstime.tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+		abstime.tv_sec += abstime.tv_nsec / 1000000000L;
+		abstime.tv_nsec %= 1000000000L;
+		// woken early only by the last role thread
+		if (ec_wait(&qt_info->rebalance_ec, key, &abstime) != ETIMEDOUT)
+			continue;
+
+		rebalance_step(qt_info, &st);
+	}
+
+	log_info("Rebalance: %u move(s) in total.", st.moves);
+	return NULL;
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "qmt-threads.h"
+
+/**
+ * Rebalancer of --rebalance=<ms>. Every interval it samples the queue occupancy and the mean service time of each stage
+ * (reading a file, computing an image, writing it) and moves at most one role thread to the stage that is short of threads,
+ * keeping the total at R + W + T. Every move is logged. Exits once all role threads have finished.
+ *
+ * @param arg A pointer to the struct qthreads_gen_info of the run.
+ *
+ * @return NULL upon completion.
+ */
+void *rebalance_thread(void *arg);
@@ -7,87 +7,220 @@
 #include "libbmp/libbmp.h"
 #include "logger/log.h"
 #include "utils/threads-general.h"
-#include "../mt/mt-compute.h"
+#include "../mt/mt-exec.h"
+#include "../inplace/inplace-exec.h"
+#include "../compute/decimate.h"
+#include "../compute/uniform.h"
+#include "../compute/gray.h"
+#include "../compute/bilateral.h"
 #include "utils/utils.h"
+#include "utils/thread-pool.h"
 #include "utils/qmt-queue.h"
 
 // Global counters for tracking file progress across threads
 size_t written_files = 0;
 size_t read_files = 0;
 
-void *reader_thread(void *arg)
+static const char *qt_role_names[] = { "reader", "worker", "writer" };
+
+const char *qt_role_to_str(enum qt_role role)
 {
-	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
-	size_t i = 0;
-	bmp_img *img;
+	return role < QT_ROLE_CNT ? qt_role_names[role] : "done";
+}
+
+// the input is charged to the budget from the reader to the worker, the result from the worker to the writer
+static size_t result_bytes(uint32_t width, uint32_t height, const struct p_args *pargs)
+{
+	if (pargs->compute_cfg.inplace)
+		return 0;
+	return mem_budget_img_bytes(DECIMATED_SIZE(width, pargs->compute_cfg.decimate), DECIMATED_SIZE(height, pargs->compute_cfg.decimate));
+}
+
+static size_t img_bytes(const bmp_img *img)
+{
+	return mem_budget_img_bytes(img->img_header.biWidth, abs(img->img_header.biHeight));
+}
+
+// dimensions from the header alone, so the memory is reserved before the pixels are loaded
+static int reader_peek_dims(const char *filepath, uint32_t *width, uint32_t *height)
+{
+	FILE *file = fopen(filepath, "rb");
+	bmp_header header;
+	enum bmp_error err;
+
+	if (!file)
+		return -1;
+	err = bmp_header_read(&header, file);
+	fclose(file);
+	if (err != BMP_OK || header.biWidth <= 0 || header.biHeight == 0)
+		return -1;
+
+	*width = header.biWidth;
+	*height = abs(header.biHeight);
+	return 0;
+}
+
+// work estimate of computing an image, orders the input queue and the files with --queue-policy=sjf|ljf
+static uint64_t compute_cost(uint32_t width, uint32_t height, const struct qthreads_gen_info *qt_info)
+{
+	const struct p_args *pargs = qt_info->pargs;
+	uint64_t window = max(get_filter_window_size(qt_info->filters, pargs->compute_cfg.filter_type), 1);
+
+	// every result pixel reads a window of input pixels
+	return (uint64_t)DECIMATED_SIZE(width, pargs->compute_cfg.decimate) * DECIMATED_SIZE(height, pargs->compute_cfg.decimate) * window * window;
+}
+
+struct file_cost {
+	char *filename;
+	uint64_t cost;
+	size_t idx;
+};
+
+static int file_cost_cmp_sjf(const void *a, const void *b)
+{
+	const struct file_cost *fa = a, *fb = b;
+
+	if (fa->cost != fb->cost)
+		return fa->cost < fb->cost ? -1 : 1;
+	return fa->idx < fb->idx ? -1 : 1; // qsort isn't stable, equal files keep the command-line order
+}
+
+static int file_cost_cmp_ljf(const void *a, const void *b)
+{
+	const struct file_cost *fa = a, *fb = b;
+
+	if (fa->cost != fb->cost)
+		return fa->cost > fb->cost ? -1 : 1;
+	return fa->idx < fb->idx ? -1 : 1;
+}
+
+void qt_order_files(struct qthreads_gen_info *qt_info)
+{
+	struct files_cfg *files_cfg = &qt_info->pargs->files_cfg;
+	enum conv_queue_policy policy = qt_info->pargs->compute_ctx.qm.policy;
+	struct file_cost *files;
 	char filepath[MAX_PATH_LEN];
-	bmp_img *empty_img = NULL;
+	uint32_t width, height;
+
+	if (policy == CONV_QUEUE_FIFO || files_cfg->file_cnt < 2)
+		return;
+
+	files = malloc(files_cfg->file_cnt * sizeof(struct file_cost));
+	if (!files) {
+		log_warn("Warn: Failed to allocate the file order, reading the files in command-line order.");
+		return;
+	}
+
+	for (size_t i = 0; i < files_cfg->file_cnt; i++) {
+		files[i].filename = files_cfg->input_filename[i];
+		files[i].idx = i;
+		files[i].cost = 0; // the reader reports an unreadable file once it gets to it
+		snprintf(filepath, sizeof(filepath), "test-img/%s", files[i].filename);
+		if (reader_peek_dims(filepath, &width, &height) == 0)
+			files[i].cost = compute_cost(width, height, qt_info);
+	}
+	qsort(files, files_cfg->file_cnt, sizeof(struct file_cost), policy == CONV_QUEUE_SJF ? file_cost_cmp_sjf : file_cost_cmp_ljf);
+
+	for (size_t i = 0; i < files_cfg->file_cnt; i++) {
+		files_cfg->input_filename[i] = files[i].filename;
+		log_debug("Queue policy %s: file %zu is '%s'", valid_queue_policies[policy], i, files[i].filename);
+	}
+	free(files);
+}
+
+static void stage_account(struct qthreads_gen_info *qt_info, enum qt_role role, double time)
+{
+	__atomic_fetch_add(&qt_info->stats[role].busy_ns, (uint64_t)(time * 1e9), __ATOMIC_RELAXED);
+	__atomic_fetch_add(&qt_info->stats[role].done, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Reads the next unclaimed file and pushes it onto the input queue. A file that can't be loaded is skipped.
+ * Once the files ran out, the last reader step to leave closes the input queue.
+ *
+ * @return 1 if there was no file left to read, 0 otherwise.
+ */
+static int reader_step(struct qthreads_gen_info *qt_info, const char *mode_str)
+{
+	size_t file_cnt = qt_info->pargs->files_cfg.file_cnt;
+	size_t read_files_local;
+	char filepath[MAX_PATH_LEN];
+	bmp_img *img = NULL;
+	uint32_t width, height;
+	size_t bytes;
 	double start_time = 0;
 	double result_time = 0;
-	size_t read_files_local = 0;
-	const char *mode_str = NULL;
-	log_debug("Reader thread started.");
+	int done = 0;
 
-	mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+	// announced before the claim, so whoever sees the files run out and no reader busy knows every push has returned
+	__atomic_fetch_add(&qt_info->readers_busy, 1, __ATOMIC_SEQ_CST);
 
-	while (1) {
-		read_files_local = __atomic_fetch_add(&read_files, 1, __ATOMIC_ACQUIRE);
-		if (read_files_local >= qt_info->pargs->files_cfg.file_cnt) {
-			__atomic_fetch_sub(&read_files, 1, __ATOMIC_RELEASE);
-			break;
-		}
+	read_files_local = __atomic_fetch_add(&read_files, 1, __ATOMIC_SEQ_CST);
+	if (read_files_local >= file_cnt) {
+		__atomic_fetch_sub(&read_files, 1, __ATOMIC_SEQ_CST);
+		done = 1;
+		goto out;
+	}
 
-		start_time = get_time_in_seconds();
+	if (!qt_info->pargs->files_cfg.input_filename[read_files_local]) {
+		log_error("Reader Error: NULL filename for file index %zu (file_cnt=%zu)", read_files_local, file_cnt);
+		goto out;
+	}
 
-		if (!qt_info->pargs->files_cfg.input_filename[read_files_local]) {
-			log_error("Reader Error: NULL filename for file index %zu (file_cnt=%u)", read_files_local,
-				  (unsigned)qt_info->pargs->files_cfg.file_cnt);
-			break;
-		}
+	snprintf(filepath, sizeof(filepath), "test-img/%s", qt_info->pargs->files_cfg.input_filename[read_files_local]);
 
-		img = malloc(sizeof(bmp_img));
-		if (!img) {
-			log_error("Reader Error: Failed to allocate bmp_img struct");
-			break;
-		}
+	if (reader_peek_dims(filepath, &width, &height) < 0) {
+		log_error("Reader Error: Could not read BMP header of '%s'", filepath);
+		exit(EXIT_FAILURE);
+	}
+	// the backpressure point of the pipeline: nothing is loaded until the image and its result fit in the budget
+	bytes = mem_budget_img_bytes(width, height) + result_bytes(width, height, qt_info->pargs);
+	result_time = mem_budget_acquire(&qt_info->budget, bytes);
+	if (result_time > 0) {
+		log_trace("Reader blocked on the memory budget for %.4f seconds.", result_time);
+		qt_write_logs(result_time, QPUSH, mode_str);
+	}
 
-		snprintf(filepath, sizeof(filepath), "test-img/%s", qt_info->pargs->files_cfg.input_filename[read_files_local]);
+	start_time = get_time_in_seconds();
 
-		if (bmp_img_read(img, filepath) != 0) {
-			log_error("Reader Error: Could not read BMP file '%s'", filepath);
-			free(img);
-			exit(EXIT_FAILURE);
-		}
+	img = malloc(sizeof(bmp_img));
+	if (!img) {
+		log_error("Reader Error: Failed to allocate bmp_img struct");
+		mem_budget_release(&qt_info->budget, bytes);
+		goto out;
+	}
 
-		queue_push(qt_info->input_q, img, qt_info->pargs->files_cfg.input_filename[read_files_local], mode_str);
+	if (bmp_img_read(img, filepath) != 0) {
+		log_error("Reader Error: Could not read BMP file '%s'", filepath);
+		free(img);
+		exit(EXIT_FAILURE);
+	}
+	stage_account(qt_info, QT_ROLE_READER, get_time_in_seconds() - start_time);
 
-		result_time = get_time_in_seconds() - start_time;
-		if (result_time > 0)
-			qt_write_logs(result_time, READER, mode_str);
+	queue_push(qt_info->input_q, img, qt_info->pargs->files_cfg.input_filename[read_files_local], compute_cost(width, height, qt_info), mode_str);
 
-		log_debug("Reader: Pushed '%s' to input queue.", filepath);
-	}
+	result_time = get_time_in_seconds() - start_time;
+	if (result_time > 0)
+		qt_write_logs(result_time, READER, mode_str);
 
-	log_debug("Reader: Finished reading files. Waiting at barrier.");
-#ifdef __APPLE__
-    // macOS barrier workaround
-    // This is a placeholder. Real implementation would require a custom barrier struct.
-    // For now, let's just cast to void* to avoid the type error if not used, 
-    // or include a polyfill if available.
-    // Since we don't have a polyfill file ready, we'll just use void* and warn.
-#else
-	pthread_barrier_wait(qt_info->reader_barrier);
-#endif
-
-	log_debug("Reader: Barrier passed. Sending termination signals.");
-	for (i = 0; i < (size_t)(qt_info->pargs->compute_ctx.qm.threads_cfg.worker_cnt); i++) {
-		empty_img = calloc(1, sizeof(bmp_img));
-		if (empty_img) {
-			queue_push(qt_info->input_q, empty_img, NULL, mode_str);
-		} else {
-			log_error("Reader Error: Failed to allocate termination signal");
-		}
+	log_debug("Reader: Pushed '%s' to input queue.", filepath);
+
+out:
+	if (__atomic_sub_fetch(&qt_info->readers_busy, 1, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&read_files, __ATOMIC_SEQ_CST) >= file_cnt) {
+		log_debug("Reader: files ran out and no reader is busy, closing input queue.");
+		queue_close(qt_info->input_q);
 	}
+	return done;
+}
+
+void *reader_thread(void *arg)
+{
+	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
+	const char *mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+
+	log_debug("Reader thread started.");
+	while (reader_step(qt_info, mode_str) == 0)
+		;
 
 	log_debug("Reader: thread finished.");
 	return NULL;
@@ -95,31 +228,20 @@ void *reader_thread(void *arg)
 
 /**
  * Pops the next task (image and its filename) from the input queue.
- * Handles potential queue errors and checks for termination signals (images with zero width and height). Frees resources associated with termination signals or failed pops.
+ * Blocks while the queue is empty and still open, unless `stop` is set.
  *
  * @param input_q Pointer to the input queue.
  * @param filename_ptr Pointer to a char pointer where the filename associated with the image will be stored (memory allocated by queue).
- * @param file_count Total expected file count (potentially used by queue logic).
- * @param written_files_ptr Pointer to counter for processed files (potentially used by queue logic).
+ * @param stop Role change flag of a --rebalance thread, NULL with fixed roles.
  *
- * @return Pointer to the bmp_img task, or NULL if queue is empty/error/termination signal.
+ * @return Pointer to the bmp_img task, or NULL if the queue is closed and drained, the pop was interrupted (or on error).
  */
-static bmp_img *worker_get_task(struct img_queue *input_q, char **filename_ptr, int file_count, size_t *written_files_ptr, const char *mode)
+static bmp_img *worker_get_task(struct img_queue *input_q, char **filename_ptr, const char *mode, const uint8_t *stop)
 {
-	bmp_img *img = queue_pop(input_q, filename_ptr, file_count, written_files_ptr, mode);
+	bmp_img *img = stop ? queue_pop_interruptible(input_q, filename_ptr, mode, stop) : queue_pop(input_q, filename_ptr, mode);
 
 	if (!img) {
-		log_info("Worker Info: queue_pop returned NULL (end of queue or error).");
-		if (*filename_ptr) {
-			free(*filename_ptr);
-			*filename_ptr = NULL;
-		}
-		return NULL;
-	}
-
-	if (img->img_header.biWidth == 0 && img->img_header.biHeight == 0) {
-		log_debug("Worker: Received termination signal.");
-		free(img);
+		log_debug("Worker: no task from input queue.");
 		if (*filename_ptr) {
 			free(*filename_ptr);
 			*filename_ptr = NULL;
@@ -148,48 +270,71 @@ static struct thread_spec *worker_allocate_resources(bmp_img *input_img, struct
 	struct img_dim *dim = NULL;
 	struct img_spec *img_spec = NULL;
 
-	img_result = malloc(sizeof(bmp_img));
-	if (!img_result) {
-		log_error("Worker Error: Result image allocation failed");
-		return NULL;
+	if (pargs->compute_cfg.inplace) {
+		img_result = input_img;
+		init_output_header(&img_result->img_header, &input_img->img_header, input_img->img_header.biWidth, input_img->img_header.biHeight);
+	} else {
+		img_result = malloc(sizeof(bmp_img));
+		if (!img_result) {
+			log_error("Worker Error: Result image allocation failed");
+			return NULL;
+		}
+		bmp_img_init_df(img_result, DECIMATED_SIZE(input_img->img_header.biWidth, pargs->compute_cfg.decimate),
+				DECIMATED_SIZE(input_img->img_header.biHeight, pargs->compute_cfg.decimate));
+		init_output_header(&img_result->img_header, &input_img->img_header, img_result->img_header.biWidth, img_result->img_header.biHeight);
 	}
-	bmp_img_init_df(img_result, input_img->img_header.biWidth, input_img->img_header.biHeight);
 
 	th_spec = init_thread_spec(pargs, filters);
 	if (!th_spec) {
 		log_error("Worker Error: thread_spec allocation failed");
-		bmp_img_free(img_result);
-		free(img_result);
-		return NULL;
+		goto result_err;
 	}
 
 	dim = init_dimensions(input_img->img_header.biWidth, input_img->img_header.biHeight);
 	if (!dim) {
 		log_error("Worker Error: init_dimensions failed");
+		free(th_spec->st_gen_info);
 		free(th_spec);
-		bmp_img_free(img_result);
-		free(img_result);
-		return NULL;
+		goto result_err;
 	}
 
 	img_spec = init_img_spec(input_img, img_result, dim);
 	if (!img_spec) {
 		log_error("Worker Error: init_img_spec failed");
 		free(dim);
+		free(th_spec->st_gen_info);
 		free(th_spec);
-		bmp_img_free(img_result);
-		free(img_result);
-		return NULL;
+		goto result_err;
 	}
 
 	th_spec->img = img_spec;
 
+	if ((gray_supported(pargs, filters) && gray_attach(img_spec) < 0) ||
+	    (pargs->compute_cfg.uniform_skip && uniform_map_attach(img_spec, pargs, filters) < 0) ||
+	    (filter_is_bilateral(pargs->compute_cfg.filter_type) && bilateral_grid_attach(max(pargs->compute_ctx.qm.threads_cfg.worker_cnt, 1), img_spec, pargs) < 0)) {
+		gray_detach(img_spec);
+		uniform_map_detach(img_spec);
+		free(img_spec);
+		free(dim);
+		free(th_spec->st_gen_info);
+		free(th_spec);
+		goto result_err;
+	}
+
 	return th_spec;
+
+result_err:
+	if (img_result != input_img) {
+		bmp_img_free(img_result);
+		free(img_result);
+	}
+	return NULL;
 }
 
 /**
  * Processes the image contained within the thread_spec structure according to the compute mode specified in pargs.
- * Uses a local mutex to manage access to block counters if needed by processing functions.
+ * An image of at least --queue-split pixels is split into worker_cnt tasks on the shared thread pool, so pool threads
+ * and workers waiting for their own images help with it. A smaller one is computed by the worker alone, without the dispatch.
  *
  * @param th_spec The thread specification structure containing image data, dimensions, etc.
  * @param pargs Pointer to the program arguments structure containing compute mode, block size.
@@ -198,47 +343,22 @@ static struct thread_spec *worker_allocate_resources(bmp_img *input_img, struct
  */
 static int worker_process_image(struct thread_spec *th_spec, struct p_args *pargs)
 {
-	uint16_t next_x_block_local = 0;
-	uint16_t next_y_block_local = 0;
-	int process_status = 0;
-	pthread_mutex_t local_xy_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-	while (1) {
-		process_status = 0;
-
-		switch ((enum conv_compute_mode)pargs->compute_cfg.compute_mode) {
-		case CONV_COMPUTE_BY_ROW:
-			process_status = process_by_row(th_spec, &next_x_block_local, pargs->compute_cfg.block_size, &local_xy_mutex);
-			break;
-		case CONV_COMPUTE_BY_COLUMN:
-			process_status = process_by_column(th_spec, &next_y_block_local, pargs->compute_cfg.block_size, &local_xy_mutex);
-			break;
-		case CONV_COMPUTE_BY_PIXEL:
-			process_status = process_by_pixel(th_spec, &next_x_block_local, &next_y_block_local, &local_xy_mutex);
-			break;
-		case CONV_COMPUTE_BY_GRID:
-			process_status = process_by_grid(th_spec, &next_x_block_local, &next_y_block_local, pargs->compute_cfg.block_size, &local_xy_mutex);
-			break;
-		default:
-			log_error("Worker Error: Invalid compute mode %d", pargs->compute_cfg.compute_mode);
-			process_status = -1;
-			break;
-		}
-
-		if (process_status != 0) {
-			if (process_status < 0) {
-				log_error("Worker Error: Processing function returned error %d", process_status);
-			} else {
-				log_debug("Worker: Finished processing chunks for this image.");
-				process_status = 0;
-			}
-			break;
-		}
-		filter_part_computation(th_spec);
-	}
-
-	pthread_mutex_destroy(&local_xy_mutex);
-	return process_status;
+	uint64_t pixels = (uint64_t)th_spec->img->dim->width * th_spec->img->dim->height;
+	int tasks = pixels >= pargs->compute_ctx.qm.split_px ? max(pargs->compute_ctx.qm.threads_cfg.worker_cnt, 1) : 1;
+	double result_time;
+
+	log_debug("Worker: %llu px image in %d task(s)", (unsigned long long)pixels, tasks);
+
+	if (filter_is_whole_image(pargs->compute_cfg.filter_type))
+		result_time = execute_whole_image_computation(tasks, th_spec->img, pargs);
+	else if (pargs->compute_cfg.inplace)
+		result_time = execute_inplace_computation(tasks, th_spec->img, pargs, th_spec->st_gen_info->filters);
+	else
+		result_time = execute_mt_computation(tasks, th_spec->img, pargs, th_spec->st_gen_info->filters);
+
+	// the result has to be in the output image before it's pushed
+	gray_detach(th_spec->img);
+	return result_time > 0 ? 0 : -1;
 }
 
 /**
@@ -258,167 +378,235 @@ static void worker_cleanup_image_resources(bmp_img *input_img, struct thread_spe
 	}
 
 	if (th_spec) {
-		if (th_spec->img)
+		if (th_spec->img) {
+			uniform_map_detach(th_spec->img);
+			bilateral_grid_detach(th_spec->img);
 			free(th_spec->img);
+		}
 		if (th_spec->st_gen_info)
 			free(th_spec->st_gen_info);
 		free(th_spec);
 	}
 }
 
-void *worker_thread(void *arg)
+/**
+ * Pops one image from the input queue, processes it and pushes the result onto the output queue.
+ * Once the input queue is drained, the last worker step to leave closes the output queue.
+ *
+ * @param stop Role change flag of a --rebalance thread, NULL with fixed roles.
+ *
+ * @return 1 if the input queue is drained, 0 otherwise.
+ */
+static int worker_step(struct qthreads_gen_info *qt_info, const uint8_t *stop, const char *mode_str)
 {
-	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
 	bmp_img *img = NULL;
 	bmp_img *img_result = NULL;
 	struct thread_spec *th_spec = NULL;
 	char *filename = NULL;
+	size_t in_bytes, out_bytes;
 	double start_time = 0;
+	double service_start = 0;
 	double result_time = 0;
 	int process_status = 0;
-	const char *mode_str = NULL;
+	int done = 0;
 
-	log_debug("Worker: thread started.");
-
-	mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+	// announced before the pop, so a result is always pushed before the count can drop to 0
+	__atomic_fetch_add(&qt_info->workers_busy, 1, __ATOMIC_SEQ_CST);
 
-	while (1) {
-		start_time = get_time_in_seconds();
+	start_time = get_time_in_seconds();
 
-		img = worker_get_task(qt_info->input_q, &filename, qt_info->pargs->files_cfg.file_cnt, &written_files, mode_str);
-		if (!img) {
-			log_debug("Worker: Exiting loop due to null task from queue.");
-			break;
-		}
+	img = worker_get_task(qt_info->input_q, &filename, mode_str, stop);
+	if (!img) {
+		done = queue_is_drained(qt_info->input_q);
+		goto out;
+	}
+	service_start = get_time_in_seconds();
+	in_bytes = img_bytes(img);
+	out_bytes = result_bytes(img->img_header.biWidth, abs(img->img_header.biHeight), qt_info->pargs);
 
-		th_spec = worker_allocate_resources(img, qt_info->pargs, qt_info->filters);
-		if (!th_spec) {
-			worker_cleanup_image_resources(img, NULL);
-			if (filename)
-				free(filename);
-			continue;
-		}
-		img_result = th_spec->img->output;
+	th_spec = worker_allocate_resources(img, qt_info->pargs, qt_info->filters);
+	if (!th_spec) {
+		worker_cleanup_image_resources(img, NULL);
+		mem_budget_release(&qt_info->budget, in_bytes + out_bytes);
+		free(filename);
+		goto out;
+	}
+	img_result = th_spec->img->output;
 
-		process_status = worker_process_image(th_spec, qt_info->pargs);
+	process_status = worker_process_image(th_spec, qt_info->pargs);
+	stage_account(qt_info, QT_ROLE_WORKER, get_time_in_seconds() - service_start);
 
-		if (process_status != 0) {
-			log_error("Worker Error: Image processing failed, discarding result.");
+	if (process_status != 0) {
+		log_error("Worker Error: Image processing failed, discarding result.");
+		if (img_result != img) {
 			bmp_img_free(img_result);
 			free(img_result);
-			img_result = NULL;
-		} else {
-			queue_push(qt_info->output_q, img_result, filename, mode_str);
-			log_debug("Worker: Pushed result for '%s' to output queue.", (filename ? filename : "N/A"));
-			img_result = NULL;
 		}
+		img_result = NULL;
+	} else {
+		// writing costs the same for every result pixel
+		queue_push(qt_info->output_q, img_result, filename, (uint64_t)img_result->img_header.biWidth * abs(img_result->img_header.biHeight), mode_str);
+		log_debug("Worker: Pushed result for '%s' to output queue.", (filename ? filename : "N/A"));
+		// in-place result is the input image itself, the writer owns it now
+		if (img_result == img)
+			img = NULL;
+		img_result = NULL;
+	}
 
-		result_time = get_time_in_seconds() - start_time;
-		if (result_time > 0) {
-			qt_write_logs(result_time, WORKER, mode_str);
-		}
+	result_time = get_time_in_seconds() - start_time;
+	if (result_time > 0) {
+		qt_write_logs(result_time, WORKER, mode_str);
+	}
 
-		worker_cleanup_image_resources(img, th_spec);
+	worker_cleanup_image_resources(img, th_spec);
 
-		if (process_status != 0 && filename != NULL) {
-			log_debug("Worker: Freeing filename for failed processing of %s", filename);
-			free(filename);
-			filename = NULL;
-		}
-	}
+	// an in-place result is the input, the writer returns its bytes
+	if (process_status != 0)
+		mem_budget_release(&qt_info->budget, in_bytes + out_bytes);
+	else if (img)
+		mem_budget_release(&qt_info->budget, in_bytes);
 
-	if (filename) {
-		log_warn("Worker: Leaking filename on thread exit?");
+	if (process_status != 0 && filename != NULL) {
+		log_debug("Worker: Freeing filename for failed processing of %s", filename);
 		free(filename);
 	}
 
+out:
+	if (__atomic_sub_fetch(&qt_info->workers_busy, 1, __ATOMIC_SEQ_CST) == 0 && queue_is_drained(qt_info->input_q)) {
+		log_debug("Worker: input queue drained and no worker is busy, closing output queue.");
+		queue_close(qt_info->output_q);
+	}
+	return done;
+}
+
+void *worker_thread(void *arg)
+{
+	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
+	const char *mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+
+	log_debug("Worker: thread started.");
+	thread_pool_set_helping(1);
+
+	while (worker_step(qt_info, NULL, mode_str) == 0)
+		;
+
 	log_debug("Worker: thread finished.");
 	return NULL;
 }
 
-void *writer_thread(void *arg)
+/**
+ * Pops one result from the output queue and writes it to disk.
+ *
+ * @param stop Role change flag of a --rebalance thread, NULL with fixed roles.
+ *
+ * @return 1 if the output queue is drained, 0 otherwise.
+ */
+static int writer_step(struct qthreads_gen_info *qt_info, const uint8_t *stop, const char *mode_str)
 {
-	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
 	char output_filepath[MAX_PATH_LEN];
 	bmp_img *img = NULL;
 	char *filename = NULL;
+	size_t bytes;
 	double start_time = 0;
+	double service_start = 0;
 	double result_time = 0;
 	size_t current_wf_local = 0;
-	const char *mode_str = NULL;
 
-	log_debug("Writer: thread started. Expecting %u files.", (unsigned)qt_info->pargs->files_cfg.file_cnt);
+	start_time = get_time_in_seconds();
 
-	mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+	img = stop ? queue_pop_interruptible(qt_info->output_q, &filename, mode_str, stop) : queue_pop(qt_info->output_q, &filename, mode_str);
+	if (!img) {
+		if (!queue_is_drained(qt_info->output_q))
+			return 0;
+		log_debug("Writer: output queue drained (%zu/%u files written).", __atomic_load_n(&written_files, __ATOMIC_ACQUIRE),
+			  (unsigned)qt_info->pargs->files_cfg.file_cnt);
+		return 1;
+	}
+	service_start = get_time_in_seconds();
 
-	while (1) {
-		current_wf_local = __atomic_load_n(&written_files, __ATOMIC_ACQUIRE);
-		if (current_wf_local >= qt_info->pargs->files_cfg.file_cnt) {
-			log_debug("Writer: All expected files (%zu) accounted for. Exiting.", current_wf_local);
-			break;
-		}
+	bytes = img_bytes(img);
 
-		start_time = get_time_in_seconds();
+	if (!filename) {
+		log_error("Writer Error: Received image from output queue without a filename!");
+		bmp_img_free(img);
+		free(img);
+		mem_budget_release(&qt_info->budget, bytes);
+		return 0;
+	}
 
-		img = queue_pop(qt_info->output_q, &filename, qt_info->pargs->files_cfg.file_cnt, &written_files, mode_str);
+	if (qt_info->pargs->files_cfg.output_filename && strlen(qt_info->pargs->files_cfg.output_filename) > 0) {
+		snprintf(output_filepath, sizeof(output_filepath), "test-img/qmt_out_%s_%s", qt_info->pargs->files_cfg.output_filename, filename);
+	} else {
+		snprintf(output_filepath, sizeof(output_filepath), "test-img/qmt_out_%s", filename);
+	}
 
-		if (!img) {
-			size_t w = __atomic_load_n(&written_files, __ATOMIC_ACQUIRE);
-			if (w >= (size_t)qt_info->pargs->files_cfg.file_cnt) {
-				log_debug("Writer: queue_pop returned NULL, all %u files written.", (unsigned)qt_info->pargs->files_cfg.file_cnt);
-			} else {
-				log_error("Writer: queue_pop returned NULL but only %zu/%u files written.", w, (unsigned)qt_info->pargs->files_cfg.file_cnt);
-			}
-			break;
-		}
+	fit_output_depth(img);
+	if (bmp_img_write(img, output_filepath) != 0) {
+		log_error("Writer Error: Failed to write image to '%s'", output_filepath);
+	} else {
+		stage_account(qt_info, QT_ROLE_WRITER, get_time_in_seconds() - service_start);
+		current_wf_local = __atomic_add_fetch(&written_files, 1, __ATOMIC_RELEASE);
+		log_info("Writer: Successfully wrote '%s' (file %zu/%u)", output_filepath, current_wf_local, (unsigned)qt_info->pargs->files_cfg.file_cnt);
 
-		if (img->img_header.biWidth == 0 && img->img_header.biHeight == 0) {
-			log_warn("Writer: Received unexpected termination signal on output queue.");
-			free(img);
-			if (filename)
-				free(filename);
-			continue;
-		}
+		result_time = get_time_in_seconds() - start_time;
+		if (result_time > 0)
+			qt_write_logs(result_time, WRITER, mode_str);
+	}
 
-		if (!filename) {
-			log_error("Writer Error: Received image from output queue without a filename!");
-			bmp_img_free(img);
-			free(img);
-			continue;
-		}
+	bmp_img_free(img);
+	free(img);
+	free(filename);
+	mem_budget_release(&qt_info->budget, bytes);
+	return 0;
+}
 
-		if (qt_info->pargs->files_cfg.output_filename && strlen(qt_info->pargs->files_cfg.output_filename) > 0) {
-			snprintf(output_filepath, sizeof(output_filepath), "test-img/qmt_out_%s_%s", qt_info->pargs->files_cfg.output_filename, filename);
-		} else {
-			snprintf(output_filepath, sizeof(output_filepath), "test-img/qmt_out_%s", filename);
-		}
+void *writer_thread(void *arg)
+{
+	struct qthreads_gen_info *qt_info = (struct qthreads_gen_info *)arg;
+	const char *mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
 
-		if (bmp_img_write(img, output_filepath) != 0) {
-			log_error("Writer Error: Failed to write image to '%s'", output_filepath);
-		} else {
-			current_wf_local = __atomic_add_fetch(&written_files, 1, __ATOMIC_RELEASE);
-			log_info("Writer: Successfully wrote '%s' (file %zu/%u)", output_filepath, current_wf_local, (unsigned)qt_info->pargs->files_cfg.file_cnt);
+	log_debug("Writer: thread started. Expecting %u files.", (unsigned)qt_info->pargs->files_cfg.file_cnt);
 
-			result_time = get_time_in_seconds() - start_time;
-			if (result_time > 0)
-				qt_write_logs(result_time, WRITER, mode_str);
-		}
+	while (writer_step(qt_info, NULL, mode_str) == 0)
+		;
 
-		bmp_img_free(img);
-		free(img);
-		free(filename);
-		filename = NULL;
-		img = NULL;
+	log_debug("Writer: thread finished.");
+	return NULL;
+}
+
+void *role_thread(void *arg)
+{
+	struct qt_role_thread *th = (struct qt_role_thread *)arg;
+	struct qthreads_gen_info *qt_info = th->qt_info;
+	const char *mode_str = compute_mode_to_str(qt_info->pargs->compute_cfg.compute_mode);
+	uint8_t role;
+	int done = 0;
 
-		if (current_wf_local >= qt_info->pargs->files_cfg.file_cnt) {
-			log_debug("Writer: Reached expected file count (%zu). Exiting.", current_wf_local);
+	log_debug("Role thread started as %s.", qt_role_to_str(__atomic_load_n(&th->role, __ATOMIC_ACQUIRE)));
+	thread_pool_set_helping(1);
+
+	while (1) {
+		// cleared before the role is read: a move after this point leaves the flag set and interrupts the next pop
+		__atomic_store_n(&th->moved, 0, __ATOMIC_SEQ_CST);
+		role = __atomic_load_n(&th->role, __ATOMIC_ACQUIRE);
+
+		if (role == QT_ROLE_READER)
+			done = reader_step(qt_info, mode_str);
+		else if (role == QT_ROLE_WORKER)
+			done = worker_step(qt_info, &th->moved, mode_str);
+		else
+			done = writer_step(qt_info, &th->moved, mode_str);
+
+		if (!done)
+			continue;
+		// the stage is finished for good, go on to the next one unless the rebalancer has already moved the thread
+		if (__atomic_compare_exchange_n(&th->role, &role, role + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) && role + 1 == QT_ROLE_CNT)
 			break;
-		}
 	}
 
-	if (filename)
-		free(filename);
+	if (__atomic_sub_fetch(&qt_info->role_threads_left, 1, __ATOMIC_ACQ_REL) == 0)
+		ec_notify(&qt_info->rebalance_ec);
 
-	log_debug("Writer: thread finished.");
+	log_debug("Role thread finished.");
 	return NULL;
 }
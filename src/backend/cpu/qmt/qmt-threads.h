@@ -11,6 +11,7 @@
 #include "utils/args-parse.h"
 #include "utils/filters.h"
 #include "utils/qmt-queue.h"
+#include "utils/qmt-budget.h"
 
 // thread-work specific struct for better abstraction (#saynotoglobals)
 struct threads_info {
@@ -18,9 +19,27 @@ struct threads_info {
 	pthread_t *threads;
 };
 
-#ifndef PTHREAD_BARRIER_SERIAL_THREAD
-#include "utils/pthread_barrier.h"
-#endif
+// pipeline stages, in the order an image goes through them
+enum qt_role { QT_ROLE_READER, QT_ROLE_WORKER, QT_ROLE_WRITER, QT_ROLE_CNT };
+
+// service time of a stage (reading a file, computing an image, writing it), without the time blocked on the queues
+struct qt_stage_stats {
+	uint64_t busy_ns;
+	uint64_t done;
+};
+
+struct qthreads_gen_info;
+
+// --rebalance: a queue thread that runs whichever stage `role` says, moved between stages by the rebalancer
+struct qt_role_thread {
+	struct qthreads_gen_info *qt_info;
+	uint8_t role; // enum qt_role, QT_ROLE_CNT once the thread is done
+	uint8_t moved; // set by the rebalancer with the role, interrupts a pop the thread is waiting in
+};
+
+// files claimed by the readers and written by the writers so far
+extern size_t read_files;
+extern size_t written_files;
 
 // Structure for incapsulating all the information needed while thread execution in queue-mode
 struct qthreads_gen_info {
@@ -31,22 +50,40 @@ struct qthreads_gen_info {
 	struct filter_mix *filters;
 	struct img_queue *output_q;
 	struct img_queue *input_q;
-#ifdef __APPLE__
-	// macOS doesn't support pthread_barrier_t natively
-	// You might need a custom implementation or use a different synchronization primitive
-	// For now, let's assume a custom implementation or conditional compilation
-	void *reader_barrier; 
-#else
-	pthread_barrier_t *reader_barrier; 
-#endif
+	struct mem_budget budget; // images anywhere in the pipeline, --queue-mem
+	uint32_t readers_busy; // reader steps in flight, the last one out once the files ran out closes input_q
+	uint32_t workers_busy; // worker steps in flight, the last one out once input_q is drained closes output_q
+	struct qt_stage_stats stats[QT_ROLE_CNT];
+
+	// --rebalance only, NULL/0 with fixed roles
+	struct qt_role_thread *role_threads;
+	uint16_t role_thread_cnt;
+	uint16_t role_threads_left; // the last role thread to finish wakes the rebalancer to exit
+	pthread_t rebalancer;
+	uint8_t rebalancer_started;
+	struct eventcount rebalance_ec;
 };
 
+/**
+ * @return Name of the role ("reader", "worker", "writer").
+ */
+const char *qt_role_to_str(enum qt_role role);
+
+/**
+ * With --queue-policy=sjf|ljf, reorders the input files by the compute cost of their header dimensions (stable),
+ * so the readers claim them in policy order. The queues can only reorder the images already read. Nothing to do with fifo.
+ * Must be called before the reader threads start.
+ *
+ * @param qt_info A pointer to the qthreads_gen_info structure with the arguments and filters set.
+ */
+void qt_order_files(struct qthreads_gen_info *qt_info);
+
 /**
  * Reads image file paths specified in arguments, loads the BMP images, and pushes them onto the input queue for worker threads.
  * Handles atomic incrementing of the global read file counter.
- * After processing all files, pushes termination signals onto the queue and waits on a barrier before sending signals.
+ * Once the files ran out, the last reader still busy closes the input queue, so the workers drain it and exit.
  *
- * @param arg A pointer to a struct qthreads_gen_info containing shared information like program arguments, queues, and barriers.
+ * @param arg A pointer to a struct qthreads_gen_info containing shared information like program arguments and queues.
  *
  * @return NULL after completion or in case of critical failure.
  */
@@ -54,7 +91,7 @@ void *reader_thread(void *arg);
 
 /**
  * Main function for worker threads. Enters a loop to get tasks (images) from the input queue, allocate resources, process the image using filters and the specified compute mode, push the result to the output queue, log timing, and clean up resources for the completed task.
- * Exits the loop upon receiving a termination signal or encountering a queue error.
+ * Exits the loop once the input queue is closed and drained; the last worker still busy then closes the output queue.
  *
  * @param arg A void pointer to a struct qthreads_gen_info containing shared information like program arguments, queues, and filter settings.
  *
@@ -64,10 +101,21 @@ void *writer_thread(void *arg);
 
 /**
  * Main function for writer threads. Enters a loop to get processed images (tasks) from the output queue, construct the output filename, write the image data to disk, log timing information, and free the image resources. Handles atomic updates to the global written file counter.
- * Exits when all expected files have been written or a queue error occurs.
+ * Exits once the output queue is closed and drained.
  *
  * @param arg A void pointer to a struct qthreads_gen_info containing shared information like program arguments and the output queue.
  *
  * @return NULL upon completion or error.
  */
 void *worker_thread(void *arg);
+
+/**
+ * Main function of the queue threads with --rebalance. Runs one step (a file, an image) of its current role at a time,
+ * so the rebalancer can move it to another stage between steps; a pop it waits in is interrupted by the move.
+ * A thread whose stage is finished moves on to the next one (reader -> worker -> writer) and exits when the output queue is drained.
+ *
+ * @param arg A pointer to the struct qt_role_thread of the thread.
+ *
+ * @return NULL upon completion.
+ */
+void *role_thread(void *arg);
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "qmt-budget.h"
+#include "libbmp/libbmp.h"
+#include "logger/log.h"
+#include "utils/utils.h"
+
+void mem_budget_init(struct mem_budget *b, size_t limit)
+{
+	b->limit = limit;
+	b->used = 0;
+	b->peak = 0;
+	ec_init(&b->released);
+	log_info("Queue memory budget: %zu bytes", limit);
+}
+
+void mem_budget_destroy(struct mem_budget *b)
+{
+	if (b->used)
+		log_warn("Queue memory budget destroyed with %zu bytes still reserved", b->used);
+	ec_destroy(&b->released);
+}
+
+static int mem_budget_try_acquire(struct mem_budget *b, size_t bytes)
+{
+	size_t cur = __atomic_load_n(&b->used, __ATOMIC_RELAXED);
+	size_t peak;
+
+	do {
+		if (cur != 0 && cur + bytes > b->limit)
+			return -1;
+	} while (!__atomic_compare_exchange_n(&b->used, &cur, cur + bytes, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	peak = __atomic_load_n(&b->peak, __ATOMIC_RELAXED);
+	while (peak < cur + bytes && !__atomic_compare_exchange_n(&b->peak, &peak, cur + bytes, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	return 0;
+}
+
+double mem_budget_acquire(struct mem_budget *b, size_t bytes)
+{
+	double start_block_time = 0;
+	uint32_t key;
+
+	while (mem_budget_try_acquire(b, bytes) < 0) {
+		key = ec_prepare_wait(&b->released);
+		if (mem_budget_try_acquire(b, bytes) == 0) {
+			ec_cancel_wait(&b->released);
+			break;
+		}
+		log_debug("Queue memory budget exhausted (%zu + %zu > %zu bytes). Waiting...", __atomic_load_n(&b->used, __ATOMIC_RELAXED), bytes, b->limit);
+		if (start_block_time == 0)
+			start_block_time = get_time_in_seconds();
+		ec_wait(&b->released, key, NULL);
+	}
+
+	return start_block_time != 0 ? get_time_in_seconds() - start_block_time : 0;
+}
+
+void mem_budget_release(struct mem_budget *b, size_t bytes)
+{
+	__atomic_fetch_sub(&b->used, bytes, __ATOMIC_RELAXED);
+	ec_notify(&b->released);
+}
+
+size_t mem_budget_img_bytes(uint32_t width, uint32_t height)
+{
+	return sizeof(bmp_img) + (size_t)height * (sizeof(bmp_pixel *) + (size_t)width * sizeof(bmp_pixel));
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "utils/eventcount.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Memory budget shared by the whole queue pipeline, in bytes.
+ * A reader reserves everything an image will need (the loaded image and the result a worker allocates for it) before loading it,
+ * the worker releases the input once it is computed and the writer releases the result once it is written.
+ * Readers sleep on `released` while the budget is exhausted, so that is the only place the pipeline waits for memory.
+ */
+struct mem_budget {
+	size_t limit;
+	size_t used;
+	size_t peak;
+	struct eventcount released;
+};
+
+/**
+ * Initializes an empty budget of `limit` bytes.
+ */
+void mem_budget_init(struct mem_budget *b, size_t limit);
+
+/**
+ * Destroys the eventcount. No thread may be waiting.
+ */
+void mem_budget_destroy(struct mem_budget *b);
+
+/**
+ * Reserves `bytes`, blocking until they fit in the budget. A reservation into an empty budget always succeeds,
+ * so an image larger than the whole budget is processed alone instead of blocking forever.
+ *
+ * @return Seconds spent blocked.
+ */
+double mem_budget_acquire(struct mem_budget *b, size_t bytes);
+
+/**
+ * Returns `bytes` reserved by mem_budget_acquire() and wakes the blocked readers.
+ */
+void mem_budget_release(struct mem_budget *b, size_t bytes);
+
+/**
+ * Exact heap size of a bmp_img of the given dimensions as libbmp allocates it
+ * (the struct, the row pointer array and one 24-bit pixel row per line, 8-bit files included).
+ */
+size_t mem_budget_img_bytes(uint32_t width, uint32_t height);
@@ -1,130 +1,260 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "qmt-queue.h"
-#include "utils/utils.h" // For get_time_in_seconds, qt_write_logs, set_wait_time
+#include "utils/utils.h" // For get_time_in_seconds, qt_write_logs
 #include "logger/log.h"
-#include <pthread.h>
 #include <string.h>
-#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <time.h>
 
-/**
- * Estimates the memory usage of a single BMP image structure and its pixel data.
- * Includes the size of the main struct, pixel data array, row pointers (if applicable),
- * and a fixed overhead assumption.
- *
- * @param img A pointer to the bmp_img structure whose memory usage is to be estimated.
- *
- * @return The estimated memory usage in MB.
- */
-static size_t estimate_image_memory(const bmp_img *img)
+// the slot hand-over is ordered by atomics, which Helgrind (CI) can't see, so it is annotated when the header is available
+#if defined(__has_include)
+#if __has_include(<valgrind/helgrind.h>)
+#include <valgrind/helgrind.h>
+#endif
+#endif
+#ifndef ANNOTATE_HAPPENS_BEFORE
+#define ANNOTATE_HAPPENS_BEFORE(obj)
+#define ANNOTATE_HAPPENS_AFTER(obj)
+#endif
+
+int queue_init(struct img_queue *q, uint32_t capacity, enum conv_queue_policy policy)
 {
-	size_t bytes_per_pixel, pixel_data_size_bytes, total_bytes;
-	size_t megabytes;
-
-	bytes_per_pixel = img->img_header.biBitCount / 8;
-	if (bytes_per_pixel == 0)
-		bytes_per_pixel = 3;
-
-	pixel_data_size_bytes = (size_t)img->img_header.biWidth * img->img_header.biHeight * bytes_per_pixel;
-
-	total_bytes = pixel_data_size_bytes + sizeof(bmp_img);
-	if (img->img_pixels != NULL) {
-		total_bytes += (size_t)img->img_header.biHeight * sizeof(bmp_pixel *) + RAW_MEM_OVERHEAD;
+	if (capacity == 0) {
+		log_warn("Queue capacity 0 would block every push, using 1.");
+		capacity = 1;
 	}
+	q->head = q->tail = 0;
+	q->closed = 0;
+	q->capacity = capacity;
+	q->policy = policy;
 
-	megabytes = (total_bytes + (1024 * 1024 - 1)) / (1024 * 1024);
-	megabytes += RAW_MEM_OVERHEAD;
-
-	if (megabytes == 0) {
-		megabytes = 1;
+	q->cells = malloc(capacity * sizeof(struct queue_cell));
+	if (!q->cells) {
+		log_error("Failed to allocate queue cell array (capacity: %u)", capacity);
+		return -1;
 	}
-
-	return megabytes;
+	for (uint32_t i = 0; i < capacity; i++)
+		q->cells[i].seq = 2 * (uint64_t)i;
+
+	if (policy != CONV_QUEUE_FIFO)
+		pthread_mutex_init(&q->heap_lock, NULL);
+	ec_init(&q->not_empty);
+	ec_init(&q->not_full);
+	log_info("Queue initialized with capacity: %u, policy: %s", q->capacity, valid_queue_policies[policy]);
+	return 0;
 }
 
-int queue_init(struct img_queue *q, uint32_t capacity, size_t max_mem)
+static void queue_free_cell(struct queue_cell *cell)
 {
-	q->front = q->rear = q->size = 0;
-	q->current_mem_usage = 0;
-	q->capacity = capacity;
-	q->max_mem_usage = max_mem;
-
-	q->images = malloc(capacity * sizeof(struct queue_img_info *));
-	if (!q->images) {
-		log_error("Failed to allocate queue image array (capacity: %u)", capacity);
-		return -1;
+	log_trace("Destroying remaining queue element: filename='%s'", cell->filename ? cell->filename : "NULL");
+	if (cell->image) {
+		if (cell->image->img_header.biWidth > 0 || cell->image->img_header.biHeight > 0) {
+			bmp_img_free(cell->image);
+		}
+		free(cell->image);
 	}
-
-	pthread_mutex_init(&q->mutex, NULL);
-	pthread_cond_init(&q->cond_non_empty, NULL);
-	pthread_cond_init(&q->cond_non_full, NULL);
-	log_info("Queue initialized with max memory: %zu MB", q->max_mem_usage);
-	return 0;
+	free(cell->filename);
 }
 
 void queue_destroy(struct img_queue *q)
 {
+	struct queue_cell *cell;
+
 	if (!q)
 		return;
 
-	pthread_mutex_lock(&q->mutex);
+	log_debug("Destroying queue: Capacity=%u, Size=%llu", q->capacity, (unsigned long long)(q->tail - q->head));
 
-	log_debug("Destroying queue: Capacity=%u, Size=%u, MemUsage=%zu MiB", q->capacity, q->size, q->current_mem_usage);
-
-	while (q->size > 0) {
-		uint32_t current_front = q->front;
-		struct queue_img_info *iqi = q->images[current_front];
+	if (q->policy != CONV_QUEUE_FIFO) {
+		// the heap is packed at the front of `cells`
+		for (uint64_t i = 0; i < q->tail - q->head; i++)
+			queue_free_cell(&q->cells[i]);
+		pthread_mutex_destroy(&q->heap_lock);
+	} else {
+		for (; q->head != q->tail; q->head++) {
+			cell = &q->cells[q->head % q->capacity];
+			if (cell->seq != 2 * q->head + 1) {
+				log_warn("Found unfinished slot in queue during destroy at position %llu", (unsigned long long)q->head);
+				continue;
+			}
+			queue_free_cell(cell);
+		}
+	}
+	free(q->cells);
+	q->cells = NULL;
 
-		q->front = (q->front + 1) % q->capacity;
-		q->size--;
+	ec_destroy(&q->not_empty);
+	ec_destroy(&q->not_full);
+	log_info("Queue destroyed successfully.");
+}
 
-		if (iqi) {
-			log_trace("Destroying remaining queue element: filename='%s'", iqi->filename ? iqi->filename : "NULL");
-			if (iqi->image) {
-				if (iqi->image->img_header.biWidth > 0 || iqi->image->img_header.biHeight > 0) {
-					bmp_img_free(iqi->image);
-				}
-				free(iqi->image);
-				iqi->image = NULL;
+// claims the slot for the next push, NULL if the ring is full
+static struct queue_cell *queue_claim_push(struct img_queue *q, uint64_t *pos_ptr)
+{
+	uint64_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	struct queue_cell *cell;
+	int64_t diff;
+
+	while (1) {
+		cell = &q->cells[pos % q->capacity];
+		diff = (int64_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - 2 * pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				ANNOTATE_HAPPENS_AFTER(cell);
+				*pos_ptr = pos;
+				return cell;
 			}
-			if (iqi->filename) {
-				free(iqi->filename);
-				iqi->filename = NULL;
+		} else if (diff < 0) {
+			return NULL; // the pop of the previous lap hasn't freed the slot yet
+		} else {
+			pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+// claims the slot for the next pop, NULL if the ring is empty
+static struct queue_cell *queue_claim_pop(struct img_queue *q, uint64_t *pos_ptr)
+{
+	uint64_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	struct queue_cell *cell;
+	int64_t diff;
+
+	while (1) {
+		cell = &q->cells[pos % q->capacity];
+		diff = (int64_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (2 * pos + 1));
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				*pos_ptr = pos;
+				return cell;
 			}
-			free(iqi);
-			q->images[current_front] = NULL;
+		} else if (diff < 0) {
+			return NULL;
 		} else {
-			log_warn("Found NULL element pointer in queue during destroy at index %u", current_front);
+			pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
 		}
 	}
+}
+
+// 1 if `a` has to be popped before `b`
+static int heap_before(const struct img_queue *q, const struct queue_cell *a, const struct queue_cell *b)
+{
+	if (a->cost != b->cost)
+		return q->policy == CONV_QUEUE_SJF ? a->cost < b->cost : a->cost > b->cost;
+	return a->seq < b->seq;
+}
 
-	if (q->size != 0) {
-		log_error("Queue size is non-zero (%u) after cleanup in destroy!", q->size);
+static void heap_sift_up(struct img_queue *q, uint32_t i)
+{
+	struct queue_cell node = q->cells[i];
+	uint32_t parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!heap_before(q, &node, &q->cells[parent]))
+			break;
+		q->cells[i] = q->cells[parent];
+		i = parent;
 	}
-	q->current_mem_usage = 0;
+	q->cells[i] = node;
+}
 
-	free(q->images);
-	q->images = NULL;
+static void heap_sift_down(struct img_queue *q, uint32_t i, uint32_t size)
+{
+	struct queue_cell node = q->cells[i];
+	uint32_t child;
+
+	while ((child = 2 * i + 1) < size) {
+		if (child + 1 < size && heap_before(q, &q->cells[child + 1], &q->cells[child]))
+			child++;
+		if (!heap_before(q, &q->cells[child], &node))
+			break;
+		q->cells[i] = q->cells[child];
+		i = child;
+	}
+	q->cells[i] = node;
+}
 
-	pthread_mutex_unlock(&q->mutex);
+// 0 if the queue is full
+static int queue_try_push(struct img_queue *q, bmp_img *img, char *filename, uint64_t cost)
+{
+	struct queue_cell *cell;
+	uint64_t pos;
+
+	if (q->policy != CONV_QUEUE_FIFO) {
+		pthread_mutex_lock(&q->heap_lock);
+		pos = q->tail;
+		if (pos - q->head == q->capacity) {
+			pthread_mutex_unlock(&q->heap_lock);
+			return 0;
+		}
+		cell = &q->cells[pos - q->head];
+		cell->seq = pos;
+		cell->cost = cost;
+		cell->image = img;
+		cell->filename = filename;
+		heap_sift_up(q, (uint32_t)(pos - q->head));
+		// atomic only for the lock-free readers of the counters (queue_size(), queue_is_drained())
+		__atomic_store_n(&q->tail, pos + 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&q->heap_lock);
+	} else {
+		if (!(cell = queue_claim_push(q, &pos)))
+			return 0;
+		cell->cost = cost;
+		cell->image = img;
+		cell->filename = filename;
+		ANNOTATE_HAPPENS_BEFORE(cell);
+		__atomic_store_n(&cell->seq, 2 * pos + 1, __ATOMIC_RELEASE);
+	}
 
-	pthread_mutex_destroy(&q->mutex);
-	pthread_cond_destroy(&q->cond_non_full);
-	pthread_cond_destroy(&q->cond_non_empty);
-	log_info("Queue destroyed successfully.");
+	log_trace("Pushed '%s' at position %llu (cost %llu).", filename, (unsigned long long)pos, (unsigned long long)cost);
+	return 1;
 }
 
-void queue_push(struct img_queue *q, bmp_img *img, char *filename, const char *mode)
+// 0 if the queue is empty
+static int queue_try_pop(struct img_queue *q, bmp_img **img, char **filename)
+{
+	struct queue_cell *cell;
+	uint64_t pos, size;
+
+	if (q->policy != CONV_QUEUE_FIFO) {
+		pthread_mutex_lock(&q->heap_lock);
+		pos = q->head;
+		size = q->tail - pos;
+		if (size == 0) {
+			pthread_mutex_unlock(&q->heap_lock);
+			return 0;
+		}
+		*img = q->cells[0].image;
+		*filename = q->cells[0].filename;
+		log_trace("Popped '%s' pushed at position %llu (cost %llu).", (*filename ? *filename : "NULL"), (unsigned long long)q->cells[0].seq,
+			  (unsigned long long)q->cells[0].cost);
+		q->cells[0] = q->cells[size - 1];
+		heap_sift_down(q, 0, (uint32_t)(size - 1));
+		__atomic_store_n(&q->head, pos + 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&q->heap_lock);
+		return 1;
+	}
+
+	if (!(cell = queue_claim_pop(q, &pos)))
+		return 0;
+	ANNOTATE_HAPPENS_AFTER(cell);
+	*img = cell->image;
+	*filename = cell->filename;
+	ANNOTATE_HAPPENS_BEFORE(cell);
+	__atomic_store_n(&cell->seq, 2 * (pos + q->capacity), __ATOMIC_RELEASE);
+
+	log_trace("Popped '%s' at position %llu.", (*filename ? *filename : "NULL"), (unsigned long long)pos);
+	return 1;
+}
+
+void queue_push(struct img_queue *q, bmp_img *img, char *filename, uint64_t cost, const char *mode)
 {
-	struct queue_img_info *iq_info = NULL;
-	size_t image_memory = 0;
 	double start_block_time = 0;
 	double result_time = 0;
-	int8_t is_arr_limit = 0, is_mem_limit = 0;
+	uint32_t key;
 
 	if (!filename) {
 		log_warn("queue_push attempted with NULL filename. Skipping.");
@@ -135,36 +265,16 @@ void queue_push(struct img_queue *q, bmp_img *img, char *filename, const char *m
 		return;
 	}
 
-	iq_info = malloc(sizeof(struct queue_img_info));
-	if (!iq_info) {
-		log_error("Memory allocation failed for queue_img_info in 'queue_push'");
-		exit(EXIT_FAILURE);
-	}
-	iq_info->filename = filename;
-	iq_info->image = img;
-
-	pthread_mutex_lock(&q->mutex);
-
-	image_memory = estimate_image_memory(img);
-	log_trace("Pushing '%s', estimated memory: %zu MB. Current usage: %zu/%zu, size: %u/%u", filename, image_memory, q->current_mem_usage, q->max_mem_usage, q->size,
-		  q->capacity);
-
-	is_mem_limit = (q->current_mem_usage + image_memory > q->max_mem_usage && q->size > 0);
-	is_arr_limit = (q->size >= q->capacity); // check limit
-
-	while (is_mem_limit || is_arr_limit) {
-		if (is_arr_limit) {
-			log_debug("Queue array full (size %u >= MAX_QUEUE_SIZE %d). Waiting...", q->size, q->capacity);
-		} else { // is_mem_limit must be true
-			log_debug("Queue memory limit would be exceeded (current: %zu + new: %zu > max: %zu). Waiting...", q->current_mem_usage, image_memory, q->max_mem_usage);
+	while (!queue_try_push(q, img, filename, cost)) {
+		key = ec_prepare_wait(&q->not_full);
+		if (queue_try_push(q, img, filename, cost)) {
+			ec_cancel_wait(&q->not_full);
+			break;
 		}
-		start_block_time = get_time_in_seconds();
-		pthread_cond_wait(&q->cond_non_full, &q->mutex);
-		log_trace("Woke up from cond_non_full wait.");
-
-		// re-check
-		is_mem_limit = (q->current_mem_usage + image_memory > q->max_mem_usage && q->size > 0);
-		is_arr_limit = (q->size >= q->capacity);
+		log_debug("Queue array full (capacity %u). Waiting...", q->capacity);
+		if (start_block_time == 0)
+			start_block_time = get_time_in_seconds();
+		ec_wait(&q->not_full, key, NULL);
 	}
 
 	result_time = (start_block_time != 0) ? get_time_in_seconds() - start_block_time : 0;
@@ -173,59 +283,66 @@ void queue_push(struct img_queue *q, bmp_img *img, char *filename, const char *m
 		qt_write_logs(result_time, QPUSH, mode);
 	}
 
-	q->images[q->rear] = iq_info;
-	q->rear = (q->rear + 1) % q->capacity;
-	q->size++;
-	q->current_mem_usage += image_memory;
+	ec_notify(&q->not_empty);
+}
+
+void queue_close(struct img_queue *q)
+{
+	__atomic_store_n(&q->closed, 1, __ATOMIC_RELEASE);
+	log_debug("Queue closed with %llu element(s) left to drain.", (unsigned long long)(__atomic_load_n(&q->tail, __ATOMIC_RELAXED) - __atomic_load_n(&q->head, __ATOMIC_RELAXED)));
+	ec_notify(&q->not_empty);
+}
+
+// 0 if the queue is drained (closed, and empty once every push before the close is visible) or just empty
+static int queue_try_pop_or_drained(struct img_queue *q, bmp_img **img, char **filename, int *drained)
+{
+	int popped = queue_try_pop(q, img, filename);
 
-	log_trace("Pushed '%s'. New usage: %zu MB, size: %zu", filename, q->current_mem_usage, q->size);
+	*drained = 0;
+	if (!popped && __atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) {
+		popped = queue_try_pop(q, img, filename);
+		*drained = !popped;
+	}
+	return popped;
+}
 
-	pthread_cond_signal(&q->cond_non_empty);
-	pthread_mutex_unlock(&q->mutex);
+static int pop_stopped(const uint8_t *stop)
+{
+	return stop && __atomic_load_n(stop, __ATOMIC_ACQUIRE);
 }
 
-bmp_img *queue_pop(struct img_queue *q, char **filename, uint8_t file_count, size_t *written_files, const char *mode)
+static bmp_img *queue_pop_until(struct img_queue *q, char **filename, const char *mode, const uint8_t *stop)
 {
-	struct queue_img_info *iqi = NULL;
 	bmp_img *img_src = NULL;
-	size_t image_memory = 0;
+	char *cell_filename = NULL;
 	double start_block_time = 0;
 	double result_time = 0;
-	struct timespec wait_time;
-	uint8_t curr_written_files = 0;
-	int wait_result = 0;
+	uint32_t key;
+	int drained;
 	*filename = NULL;
 
-	pthread_mutex_lock(&q->mutex);
-
-restart_wait_loop:
-	while (q->size == 0) {
-		start_block_time = get_time_in_seconds();
-
-		if ((curr_written_files = __atomic_load_n(written_files, __ATOMIC_ACQUIRE)) >= file_count) {
-			log_debug("Pop termination check: written_files (%zu) >= file_count (%u). Returning NULL.", curr_written_files, file_count);
-			pthread_mutex_unlock(&q->mutex);
+	while (!queue_try_pop_or_drained(q, &img_src, &cell_filename, &drained)) {
+		if (drained) {
+			log_debug("Queue closed and drained. Returning NULL.");
 			return NULL;
 		}
-
-		log_trace("Queue empty, waiting on cond_non_empty...");
-		set_wait_time(&wait_time);
-		wait_result = pthread_cond_timedwait(&q->cond_non_empty, &q->mutex, &wait_time);
-
-		if (wait_result == ETIMEDOUT) {
-			log_trace("Consumer timed out waiting for item.");
-			if ((curr_written_files = __atomic_load_n(written_files, __ATOMIC_ACQUIRE)) >= file_count) {
-				log_debug("Pop termination check after timeout: written_files (%zu) >= file_count (%u). Returning NULL.", curr_written_files, file_count);
-				pthread_mutex_unlock(&q->mutex);
-				return NULL;
-			}
-			goto restart_wait_loop; // Try waiting again if not finished
-		} else if (wait_result != 0) {
-			log_error("pthread_cond_timedwait error: %s", strerror(wait_result));
-			pthread_mutex_unlock(&q->mutex);
+		if (pop_stopped(stop))
 			return NULL;
+
+		key = ec_prepare_wait(&q->not_empty);
+		if (queue_try_pop_or_drained(q, &img_src, &cell_filename, &drained)) {
+			ec_cancel_wait(&q->not_empty);
+			break;
 		}
-		log_trace("Consumer woken up by signal."); // Normal wakeup, re-check q->size
+		if (drained || pop_stopped(stop)) {
+			ec_cancel_wait(&q->not_empty);
+			continue;
+		}
+
+		log_trace("Queue empty, waiting on not_empty...");
+		if (start_block_time == 0)
+			start_block_time = get_time_in_seconds();
+		ec_wait(&q->not_empty, key, NULL);
 	}
 
 	result_time = (start_block_time != 0) ? get_time_in_seconds() - start_block_time : 0;
@@ -234,37 +351,46 @@ restart_wait_loop:
 		qt_write_logs(result_time, QPOP, mode);
 	}
 
-	iqi = q->images[q->front];
-	image_memory = estimate_image_memory(iqi->image);
-
-	q->front = (q->front + 1) % q->capacity;
-	q->size--;
-	if (q->current_mem_usage >= image_memory) {
-		q->current_mem_usage -= image_memory;
-	} else {
-		q->current_mem_usage = 0;
-	}
-
-	log_trace("Popped '%s'. New usage: %zu bytes, size: %zu", (iqi->filename ? iqi->filename : "NULL"), q->current_mem_usage, q->size);
+	ec_notify(&q->not_full);
 
-	if (iqi->filename) {
-		*filename = strdup(iqi->filename);
+	if (cell_filename) {
+		*filename = strdup(cell_filename);
 		if (!*filename) {
 			log_error("strdup failed for filename in queue_pop");
-			free(iqi);
-			pthread_cond_signal(&q->cond_non_full);
-			pthread_mutex_unlock(&q->mutex);
 			return NULL;
 		}
-	} else {
-		*filename = NULL;
 	}
 
-	img_src = iqi->image;
-	free(iqi);
+	return img_src;
+}
 
-	pthread_cond_signal(&q->cond_non_full);
-	pthread_mutex_unlock(&q->mutex);
+bmp_img *queue_pop(struct img_queue *q, char **filename, const char *mode)
+{
+	return queue_pop_until(q, filename, mode, NULL);
+}
 
-	return img_src;
+bmp_img *queue_pop_interruptible(struct img_queue *q, char **filename, const char *mode, const uint8_t *stop)
+{
+	return queue_pop_until(q, filename, mode, stop);
+}
+
+void queue_interrupt(struct img_queue *q)
+{
+	ec_notify(&q->not_empty);
+}
+
+int queue_is_drained(struct img_queue *q)
+{
+	// the close comes after the last push, so once it is seen `tail` is final
+	if (!__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE))
+		return 0;
+	return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+uint32_t queue_size(struct img_queue *q)
+{
+	uint64_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	uint64_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+	return tail > head ? (uint32_t)(tail - head) : 0;
 }
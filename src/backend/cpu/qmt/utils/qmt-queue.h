@@ -3,73 +3,117 @@
 #pragma once
 
 #include "libbmp/libbmp.h"
+#include "utils/args-parse.h"
+#include "utils/eventcount.h"
 #include <pthread.h>
 #include <stdint.h>
 
-#define RAW_MEM_OVERHEAD (1) // Assumed overhead for non-pixel data per image
-
-struct queue_img_info {
+// fifo: ring slot, `seq` tells whose turn it is: 2 * pos - free for the push of pos, 2 * pos + 1 - full for the pop of pos
+// (doubled, so the states of consecutive laps differ even with capacity 1)
+// sjf/ljf: heap node, `seq` is the push position, so images of equal cost leave in the order they came
+struct queue_cell {
+	uint64_t seq;
+	uint64_t cost;
 	bmp_img *image;
 	char *filename;
 };
 
-// queue_node struct
+/**
+ * Bounded MPMC image queue. With the fifo policy it is a lock-free ring (Vyukov): a push or pop claims a position
+ * with one CAS on `tail` or `head` and hands the slot over with the release store of its sequence number.
+ * With sjf/ljf `cells` is a binary heap ordered by cost under `heap_lock`; `head` and `tail` then count the pops and pushes.
+ * Threads sleep on the eventcounts only when the queue is empty or full. Memory is bounded by the pipeline's mem_budget, not here.
+ */
 struct img_queue {
-	struct queue_img_info **images;
-	uint32_t front, rear, size, capacity; // capacity - max el count
-	pthread_mutex_t mutex;
+	struct queue_cell *cells;
+	uint32_t capacity; // max el count
+	uint8_t closed; // set by queue_close(), pops return NULL once the queue is empty
+	enum conv_queue_policy policy;
+	pthread_mutex_t heap_lock; // sjf/ljf only
+
+	// producers and consumers each hammer their own counter, keep them on separate cache lines
+	char pad0[64];
+	uint64_t tail; // next push position
+	char pad1[56];
+	uint64_t head; // next pop position
+	char pad2[56];
 
-	// for advanced balancing by mem_usage factor;
-	pthread_cond_t cond_non_empty, cond_non_full;
-	size_t current_mem_usage, max_mem_usage; // in mb
+	struct eventcount not_empty, not_full;
 };
 
 /**
  * Initializes a thread-safe image queue structure.
- * Sets initial queue state (size, front, rear), memory usage limits,
- * and initializes the mutex and condition variables for synchronization.
+ * Sets initial queue state (head, tail, slot sequence numbers)
+ * and initializes the eventcounts used for parking.
  *
  * @param q A pointer to the img_queue structure to be initialized.
- * @param max_mem The maximum total estimated memory (in bytes) the queue should hold across all images. If 0, a default maximum is used.
+ * @param capacity Maximum number of queued images (0 is raised to 1).
+ * @param policy Pop order: fifo, or the cheapest (sjf) or most expensive (ljf) queued image first.
  */
-int queue_init(struct img_queue *q, uint32_t capacity, size_t max_mem);
+int queue_init(struct img_queue *q, uint32_t capacity, enum conv_queue_policy policy);
 
 /**
  * Pushes an image and its associated filename onto the thread-safe queue.
- * Blocks if the queue is full (either by item count or estimated memory usage)
- * until space becomes available. Estimates image memory usage before adding.
- * Handles memory allocation for queue metadata and signals waiting consumers.
+ * Blocks if the queue is full until a slot becomes available.
+ * Wakes consumers parked on an empty queue.
  *
  * @param q - A pointer to the img_queue structure.
  * @param img - A pointer to the bmp_img structure to be added. Ownership is transferred.
  * @param filename - A string containing the filename associated with the image. Ownership is transferred (the pointer itself, not usually a copy). Must not be NULL (function returns early if it is).
+ * @param cost - Work estimate of the image, orders the pops with the sjf/ljf policies (ignored with fifo).
  * @param mode - A pointer to mode string.
  */
-void queue_push(struct img_queue *q, bmp_img *img, char *filename, const char *mode);
+void queue_push(struct img_queue *q, bmp_img *img, char *filename, uint64_t cost, const char *mode);
 
 /**
- * Destroys the initialised primitives for queue-func (mutex and cond_vars).
+ * Frees the images left in the queue and destroys the eventcounts. No thread may be using the queue.
  *
  * @param q A pointer to the img_queue structure to be initialized.
  */
 void queue_destroy(struct img_queue *q);
 
 /**
- * Pops an image and its filename from the thread-safe queue.
- * Blocks with a timeout if the queue is empty, checking periodically if all
- * expected files have been processed (based on written_files counter).
- * Returns NULL if the queue remains empty after timeout and all files are done,
- * or if a signal indicates completion. Allocates memory for the returned filename.
+ * Closes the queue: no more pushes will come. Wakes every consumer waiting on the empty queue;
+ * the images already queued are still popped, then queue_pop() returns NULL without waiting.
+ * Must be called after the last queue_push() of every producer has returned.
  *
- * !NOTE: in CI (Helgrind analysis) you may have noticed an error:
- * "Thread #?: pthread_cond{signal,broadcast}: dubious: associated lock is not held by any thread"
- * Error indicates, that mutex inside queue_pop wasn't held before pthread_cond_timedwait was called. Thats obviously false
+ * @param q A pointer to the img_queue structure.
+ */
+void queue_close(struct img_queue *q);
+
+/**
+ * Pops an image and its filename from the thread-safe queue.
+ * Blocks while the queue is empty and open. Allocates memory for the returned filename.
  *
  * @param q A pointer to the img_queue structure.
  * @param filename A pointer to a char pointer (`char **`). On success, this will be updated to point to a newly allocated string containing the filename. The caller is responsible for freeing this memory.
- * @param file_count The total number of files expected to be processed by the system.
- * @param written_files A pointer to a global atomic counter tracking the number of files successfully processed (written). Used for termination check.
+ * @param mode - A pointer to mode string.
  *
- * @return A pointer to the popped bmp_img structure, or NULL if the queue is empty and processing should terminate, or on error during timed wait.
+ * @return A pointer to the popped bmp_img structure, or NULL if the queue is closed and drained (or on a filename allocation failure).
+ */
+bmp_img *queue_pop(struct img_queue *q, char **filename, const char *mode);
+
+/**
+ * Same as queue_pop(), but also returns NULL once `*stop` is set. A thread that sets the flag of a waiting
+ * consumer has to call queue_interrupt() afterwards to wake it.
+ *
+ * @param stop Flag polled while waiting, with acquire ordering.
+ *
+ * @return As queue_pop(); NULL with the queue not drained if the pop was interrupted.
+ */
+bmp_img *queue_pop_interruptible(struct img_queue *q, char **filename, const char *mode, const uint8_t *stop);
+
+/**
+ * Wakes the consumers waiting on the queue, so they recheck their stop flags.
+ */
+void queue_interrupt(struct img_queue *q);
+
+/**
+ * @return 1 if the queue is closed and every queued image has been popped, 0 otherwise.
+ */
+int queue_is_drained(struct img_queue *q);
+
+/**
+ * @return Number of claimed slots (being pushed or queued). Only a snapshot, for monitoring.
  */
-bmp_img *queue_pop(struct img_queue *q, char **filename, uint8_t file_count, size_t *written_files, const char *mode);
+uint32_t queue_size(struct img_queue *q);
@@ -102,8 +102,8 @@ double opencl_execute_basic_computation(struct img_spec *img_spec, struct p_args
     // Prepare Data
     int width = img_spec->dim->width;
     int height = img_spec->dim->height;
-    int num_pixels = width * height;
-    size_t img_size_bytes = (size_t)num_pixels * 3 * sizeof(unsigned char); // Explicitly 3 bytes per pixel
+    size_t num_pixels = (size_t)width * height;
+    size_t img_size_bytes = num_pixels * 3 * sizeof(unsigned char); // Explicitly 3 bytes per pixel
 
     unsigned char* flat_input = malloc(img_size_bytes);
     if (!flat_input) { log_error("Malloc failed"); return 0; }
@@ -173,7 +173,7 @@ double opencl_execute_basic_computation(struct img_spec *img_spec, struct p_args
         if (err != CL_SUCCESS) { log_error("Failed to get max work group size"); return 0; }
 
         if ((size_t)block * block > max_work_group_size) {
-             log_error("Error: Block size %d results in work group size %d which exceeds device limit %zu", block, block*block, max_work_group_size);
+             log_error("Error: Block size %d results in work group size %zu which exceeds device limit %zu", block, (size_t)block * block, max_work_group_size);
              return 0;
         }
 
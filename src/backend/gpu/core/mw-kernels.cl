@@ -41,7 +41,7 @@ __kernel void apply_filter_kernel(
             else if (potential_imageY >= height) imageY = height - 1;
             else imageY = potential_imageY;
 
-            int pixel_idx = (imageY * width + imageX) * 3;
+            size_t pixel_idx = ((size_t)imageY * width + imageX) * 3;
 
             uchar r = input_data[pixel_idx];
             uchar g = input_data[pixel_idx + 1];
@@ -59,7 +59,7 @@ __kernel void apply_filter_kernel(
     uchar out_g = (uchar)clamp(green_acc * factor + bias, 0.0f, 255.0f);
     uchar out_b = (uchar)clamp(blue_acc * factor + bias, 0.0f, 255.0f);
 
-    int out_idx = (y * width + x) * 3;
+    size_t out_idx = ((size_t)y * width + x) * 3;
     
     output_data[out_idx]     = out_r;
     output_data[out_idx + 1] = out_g;
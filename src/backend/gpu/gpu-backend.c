@@ -31,6 +31,19 @@ int gpu_verify_args(struct p_args *args)
 		log_error("Error: Queued mode isn't supported");
 		return -1;
 	}
+	if (args->compute_cfg.decimate > 1) {
+		log_error("Error: --decimate isn't supported by the GPU backend");
+		return -1;
+	}
+	if (args->compute_cfg.uniform_skip) {
+		log_error("Error: --uniform-skip isn't supported by the GPU backend");
+		return -1;
+	}
+	if (filter_is_whole_image(args->compute_cfg.filter_type) || filter_is_morphology(args->compute_cfg.filter_type) ||
+	    filter_is_bilateral(args->compute_cfg.filter_type)) {
+		log_error("Error: Filter '%s' isn't supported by the GPU backend", args->compute_cfg.filter_type);
+		return -1;
+	}
 
 	return 0;
 }
@@ -7,6 +7,7 @@
 #include "utils/filters.h"
 #include "utils/cli.h"
 #include "utils/modes.h"
+#include "utils/stats.h"
 #include "backend/compute-backend.h"
 #include <stdbool.h>
 #include <stdio.h>
@@ -69,8 +70,10 @@ int main(int argc, char *argv[])
 	if (result_time > 0) {
 		/* TODO: make it more accurate */
 		int rank = (backend->ops->get_logging_rank ? backend->ops->get_logging_rank(backend) : 0);
-		if (rank == 0)
+		if (rank == 0) {
 			write_logs(args, result_time, backend->backend);
+			stats_report(args);
+		}
 	}
 
 	compute_backend_destroy(backend);
@@ -81,5 +84,5 @@ int main(int argc, char *argv[])
 		free(args->files_cfg.input_filename);
 	free(args);
 
-	return 0;
+	return result_time > 0 ? 0 : -1;
 }
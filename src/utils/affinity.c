@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+#include "affinity.h"
+#include "hw-info.h"
+#include "thread-pool.h"
+#include "utils.h"
+#include "logger/log.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// CPU picked for every compute and queue thread
+static struct {
+	int *compute;
+	int *queue;
+	int compute_cnt;
+	int queue_cnt;
+} plan;
+
+struct cpu_slot {
+	int cpu;
+	int node;
+};
+
+static int cmp_slot_by_node(const void *a, const void *b)
+{
+	const struct cpu_slot *x = a, *y = b;
+
+	if (x->node != y->node)
+		return x->node - y->node;
+	return x->cpu - y->cpu;
+}
+
+#ifdef __linux__
+static int allowed_cpus(struct cpu_slot **slots)
+{
+	cpu_set_t set;
+	int cpu, n = 0;
+
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+		log_error("Error: sched_getaffinity failed.");
+		return -1;
+	}
+
+	*slots = malloc(CPU_COUNT(&set) * sizeof(struct cpu_slot));
+	if (!*slots) {
+		log_error("Error: Failed to allocate CPU list.");
+		return -1;
+	}
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set)) {
+			(*slots)[n].cpu = cpu;
+			(*slots)[n].node = hw_get_cpu_node(cpu);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void pin_thread(pthread_t thread, int cpu)
+{
+	cpu_set_t set;
+	int rc;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+	if (rc != 0)
+		log_warn("Warn: Failed to pin a thread to CPU %d: %s", cpu, strerror(rc));
+}
+#else
+static int allowed_cpus(struct cpu_slot **slots)
+{
+	(void)slots;
+	log_warn("Warn: --affinity is only supported on Linux, threads aren't pinned.");
+	return 0;
+}
+
+static void pin_thread(pthread_t thread, int cpu)
+{
+	(void)thread;
+	(void)cpu;
+}
+#endif
+
+// reorders compact slots so that consecutive ones go to different nodes
+static void deal_over_nodes(struct cpu_slot *slots, int n)
+{
+	struct cpu_slot *dealt = malloc(n * sizeof(struct cpu_slot));
+	int *taken = calloc(n, sizeof(int));
+	int i, k = 0, last_node = -1;
+
+	if (!dealt || !taken) {
+		log_warn("Warn: Not enough memory for scatter placement, using compact.");
+		goto cleanup;
+	}
+
+	// slots are sorted by node, so every pass takes the first free CPU of each node
+	while (k < n) {
+		last_node = -1;
+		for (i = 0; i < n; i++) {
+			if (taken[i] || slots[i].node == last_node)
+				continue;
+			dealt[k++] = slots[i];
+			taken[i] = 1;
+			last_node = slots[i].node;
+		}
+	}
+	memcpy(slots, dealt, n * sizeof(struct cpu_slot));
+
+cleanup:
+	free(dealt);
+	free(taken);
+}
+
+int affinity_init(enum conv_affinity policy, int compute_cnt, int queue_cnt)
+{
+	struct cpu_slot *slots = NULL;
+	int n, i, spare;
+
+	if (policy == CONV_AFFINITY_NONE)
+		return 0;
+
+	n = allowed_cpus(&slots);
+	if (n <= 0)
+		return n;
+
+	plan.compute = malloc(max(compute_cnt, 1) * sizeof(int));
+	plan.queue = malloc(max(queue_cnt, 1) * sizeof(int));
+	if (!plan.compute || !plan.queue) {
+		log_error("Error: Failed to allocate thread placement.");
+		free(slots);
+		affinity_free();
+		return -1;
+	}
+
+	qsort(slots, n, sizeof(struct cpu_slot), cmp_slot_by_node);
+	if (policy == CONV_AFFINITY_SCATTER)
+		deal_over_nodes(slots, n);
+
+	for (i = 0; i < compute_cnt; i++) {
+		plan.compute[i] = slots[i % n].cpu;
+		log_info("Affinity %s: pool thread %d -> CPU %d (node %d)", valid_affinities[policy], i, slots[i % n].cpu, slots[i % n].node);
+	}
+	// role keeps the queue threads off the compute CPUs while there are CPUs left
+	spare = n - compute_cnt;
+	for (i = 0; i < queue_cnt; i++) {
+		struct cpu_slot *slot;
+
+		if (policy != CONV_AFFINITY_ROLE)
+			slot = &slots[(compute_cnt + i) % n];
+		else
+			slot = spare > 0 ? &slots[compute_cnt + i % spare] : &slots[n - 1];
+		plan.queue[i] = slot->cpu;
+		log_info("Affinity %s: queue thread %d -> CPU %d (node %d)", valid_affinities[policy], i, slot->cpu, slot->node);
+	}
+	plan.compute_cnt = compute_cnt;
+	plan.queue_cnt = queue_cnt;
+
+	free(slots);
+	return 0;
+}
+
+void affinity_free(void)
+{
+	free(plan.compute);
+	free(plan.queue);
+	plan.compute = plan.queue = NULL;
+	plan.compute_cnt = plan.queue_cnt = 0;
+}
+
+void affinity_pin_compute(int idx)
+{
+	if (idx < plan.compute_cnt)
+		pin_thread(pthread_self(), plan.compute[idx]);
+}
+
+void affinity_pin_queue(pthread_t thread, int idx)
+{
+	if (idx < plan.queue_cnt)
+		pin_thread(thread, plan.queue[idx]);
+}
+
+struct touch_ctx {
+	struct img_spec *img;
+	int bands;
+	int error;
+};
+
+// copies rows [start, end) into memory allocated (and so first touched) by the calling thread
+static int rehome_rows(bmp_pixel **rows, int32_t start, int32_t end, size_t width)
+{
+	bmp_pixel *row;
+
+	for (int32_t y = start; y < end; y++) {
+		row = malloc(width * sizeof(bmp_pixel));
+		if (!row)
+			return -1;
+		memcpy(row, rows[y], width * sizeof(bmp_pixel));
+		free(rows[y]);
+		rows[y] = row;
+	}
+
+	return 0;
+}
+
+static void first_touch_task(void *arg, int idx)
+{
+	struct touch_ctx *ctx = (struct touch_ctx *)arg;
+	bmp_img *input = ctx->img->input, *output = ctx->img->output;
+	int32_t h = abs(input->img_header.biHeight);
+	int rc;
+
+	rc = rehome_rows(input->img_pixels, (int64_t)h * idx / ctx->bands, (int64_t)h * (idx + 1) / ctx->bands, input->img_header.biWidth);
+	if (rc == 0 && output != input) {
+		h = abs(output->img_header.biHeight);
+		rc = rehome_rows(output->img_pixels, (int64_t)h * idx / ctx->bands, (int64_t)h * (idx + 1) / ctx->bands, output->img_header.biWidth);
+	}
+	if (rc != 0)
+		__atomic_store_n(&ctx->error, 1, __ATOMIC_RELAXED);
+}
+
+int affinity_first_touch(struct img_spec *img_spec)
+{
+	struct touch_ctx ctx = { .img = img_spec, .bands = thread_pool_size(), .error = 0 };
+
+	if (!plan.compute_cnt || ctx.bands <= 1)
+		return 0;
+
+	thread_pool_run_bound(ctx.bands, first_touch_task, &ctx);
+	if (ctx.error) {
+		log_error("Error: Failed to reallocate image rows for first-touch placement.");
+		return -1;
+	}
+	log_info("First-touch: image rows placed in %d bands, one per pool thread", ctx.bands);
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <pthread.h>
+#include "args-parse.h"
+#include "threads-general.h"
+
+/**
+ * Builds the placement of the compute (thread pool) and queue-mode (reader, worker, writer) threads over the CPUs the process may run on.
+ * CPUs are grouped by NUMA node (hw_get_cpu_node()):
+ *  - compact: compute threads, then queue threads, fill the CPUs of one node before the next one;
+ *  - scatter: same sequence, dealt round-robin over the nodes;
+ *  - role: compute threads compact from the first CPU, queue threads (which only wait for I/O or the pool) on the CPUs left after them.
+ * The placement is logged. Only Linux is supported, elsewhere the policy falls back to none with a warning.
+ *
+ * @param policy Placement policy, CONV_AFFINITY_NONE does nothing.
+ * @param compute_cnt Number of thread pool threads.
+ * @param queue_cnt Number of queue-mode threads (0 outside of queue mode).
+ *
+ * @return 0 on success, -1 on error.
+ */
+int affinity_init(enum conv_affinity policy, int compute_cnt, int queue_cnt);
+void affinity_free(void);
+
+/**
+ * Pins the calling thread to the CPU of compute thread `idx`. No-op without a placement.
+ */
+void affinity_pin_compute(int idx);
+
+/**
+ * Pins queue-mode thread `idx` (readers, then workers, then writers). No-op without a placement.
+ */
+void affinity_pin_queue(pthread_t thread, int idx);
+
+/**
+ * First-touch placement: every pool thread reallocates and copies one band of rows of the input and output images,
+ * so the pages of band i end up on the node of pool thread i (see thread_pool_run_bound()).
+ * Band i is the one thread i starts from in work_steal mode.
+ *
+ * @param img_spec Image spec whose row pointers are replaced.
+ *
+ * @return 0 on success, -1 on error (rows that were already moved stay valid).
+ */
+int affinity_first_touch(struct img_spec *img_spec);
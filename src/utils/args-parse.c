@@ -8,8 +8,9 @@
 #include <stdio.h>
 #include <limits.h>
 #include <errno.h>
+#include <math.h>
 
-const char *valid_filters[] = { "bb", "mb", "em", "gg", "gb", "co", "sh", "mm", "bo", "mg", NULL };
+const char *valid_filters[] = { "bb", "mb", "em", "gg", "gb", "co", "sh", "mm", "bo", "mg", "rg", "pg", "bl", "di", "er", "op", "cl", NULL };
 
 int parse_mandatory_args(int argc, char *argv[], struct p_args *args)
 {
@@ -56,17 +57,116 @@ int parse_mandatory_args(int argc, char *argv[], struct p_args *args)
 				log_error("Error: Block size cannot be empty.\n");
 				return -1;
 			}
-			args->compute_cfg.block_size = atoi(block_str);
-			if (args->compute_cfg.block_size <= 0) {
-				log_error("Error: Block size must be > 0.\n");
+			char *end;
+			long block = strtol(block_str, &end, 10);
+			if (*end != '\0' || block <= 0 || block > INT32_MAX) {
+				log_error("Error: Block size must be an integer in 1..%d.\n", INT32_MAX);
 				return -1;
 			}
+			args->compute_cfg.block_size = block;
 			argv[i] = "_"; // Mark as processed
 		}
 	}
 	return 0;
 }
 
+int parse_optional_args(int argc, char *argv[], struct p_args *args)
+{
+	for (int i = 1; i < argc; i++) {
+		// Skip already processed arguments
+		if (strncmp(argv[i], "_", 1) == 0) {
+			continue;
+		}
+
+		if (strncmp(argv[i], "--tile=", 7) == 0) {
+			args->compute_cfg.tiled = atoi(argv[i] + 7) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--winograd=", 11) == 0) {
+			args->compute_cfg.winograd = atoi(argv[i] + 11) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--inplace=", 10) == 0) {
+			args->compute_cfg.inplace = atoi(argv[i] + 10) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--sigma=", 8) == 0) {
+			char *end;
+			double sigma = strtod(argv[i] + 8, &end);
+			if (end == argv[i] + 8 || *end != '\0' || !isfinite(sigma) || sigma <= 0) {
+				log_error("Error: Sigma must be a number > 0.\n");
+				return -1;
+			}
+			args->compute_cfg.sigma = sigma;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--sigma-r=", 10) == 0) {
+			char *end;
+			double sigma_r = strtod(argv[i] + 10, &end);
+			if (end == argv[i] + 10 || *end != '\0' || !isfinite(sigma_r) || sigma_r <= 0) {
+				log_error("Error: Range sigma must be a number > 0.\n");
+				return -1;
+			}
+			args->compute_cfg.sigma_r = sigma_r;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--accuracy=", 11) == 0) {
+			args->compute_cfg.accuracy = atoi(argv[i] + 11) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--radius=", 9) == 0) {
+			char *end;
+			long radius = strtol(argv[i] + 9, &end, 10);
+			// checked before the store, the field is narrower than long
+			if (end == argv[i] + 9 || *end != '\0' || radius <= 0 || radius > MORPH_MAX_RADIUS) {
+				log_error("Error: Radius must be an integer in 1..%d.\n", MORPH_MAX_RADIUS);
+				return -1;
+			}
+			args->compute_cfg.radius = radius;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--decimate=", 11) == 0) {
+			int step = atoi(argv[i] + 11);
+			if (step != 1 && step != 2 && step != 4 && step != 8) {
+				log_error("Error: Decimation factor must be 1, 2, 4 or 8.\n");
+				return -1;
+			}
+			args->compute_cfg.decimate = step;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--uniform-skip=", 15) == 0) {
+			args->compute_cfg.uniform_skip = atoi(argv[i] + 15) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--gray=", 7) == 0) {
+			args->compute_cfg.gray = atoi(argv[i] + 7) ? 1 : 0;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--affinity=", 11) == 0) {
+			int policy = -1;
+			for (int k = 0; valid_affinities[k] != NULL; k++) {
+				if (strcmp(argv[i] + 11, valid_affinities[k]) == 0)
+					policy = k;
+			}
+			if (policy < 0) {
+				log_error("Error: Invalid affinity '%s'. Valid policies are: none, compact, scatter, role\n", argv[i] + 11);
+				return -1;
+			}
+			args->compute_cfg.affinity = policy;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--order=", 8) == 0) {
+			int order = -1;
+			for (int k = 0; valid_orders[k] != NULL; k++) {
+				if (strcmp(argv[i] + 8, valid_orders[k]) == 0)
+					order = k;
+			}
+			if (order < 0) {
+				log_error("Error: Invalid tile order '%s'. Valid orders are: raster, morton, hilbert\n", argv[i] + 8);
+				return -1;
+			}
+			args->compute_cfg.order = order;
+			argv[i] = "_";
+		}
+	}
+
+	if (args->compute_cfg.filter_type && strcmp(args->compute_cfg.filter_type, "bl") == 0 &&
+	    (args->compute_cfg.sigma < BILATERAL_MIN_SIGMA || args->compute_cfg.sigma_r < BILATERAL_MIN_SIGMA)) {
+		log_error("Error: Bilateral filter requires --sigma and --sigma-r >= %.1f.\n", BILATERAL_MIN_SIGMA);
+		return -1;
+	}
+	return 0;
+}
+
 int parse_queue_mode_args(int argc, char *argv[], struct p_args *args)
 {
 	uint8_t rww_found = 0;
@@ -91,6 +191,35 @@ int parse_queue_mode_args(int argc, char *argv[], struct p_args *args)
 				return -1;
 			}
 			argv[i] = "_";
+		} else if (strncmp(argv[i], "--queue-split=", 14) == 0) {
+			char *end;
+			args->compute_ctx.qm.split_px = strtoull(argv[i] + 14, &end, 10);
+			if (end == argv[i] + 14 || *end != '\0' || argv[i][14] == '-') {
+				log_error("Error: Invalid value for --queue-split.\n");
+				return -1;
+			}
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--rebalance=", 12) == 0) {
+			char *end;
+			long rebalance_ms = strtol(argv[i] + 12, &end, 10);
+			if (end == argv[i] + 12 || *end != '\0' || rebalance_ms < 0 || rebalance_ms > UINT16_MAX) {
+				log_error("Error: Invalid value for --rebalance (0..%d ms).\n", UINT16_MAX);
+				return -1;
+			}
+			args->compute_ctx.qm.rebalance_ms = (uint32_t)rebalance_ms;
+			argv[i] = "_";
+		} else if (strncmp(argv[i], "--queue-policy=", 15) == 0) {
+			int policy = -1;
+			for (int k = 0; valid_queue_policies[k] != NULL; k++) {
+				if (strcmp(argv[i] + 15, valid_queue_policies[k]) == 0)
+					policy = k;
+			}
+			if (policy < 0) {
+				log_error("Error: Invalid queue policy '%s'. Valid policies are: fifo, sjf, ljf\n", argv[i] + 15);
+				return -1;
+			}
+			args->compute_ctx.qm.policy = policy;
+			argv[i] = "_";
 		} else if (strncmp(argv[i], "--output=", 9) == 0) {
 			args->files_cfg.output_filename = argv[i] + 9;
 			argv[i] = "_";
@@ -193,6 +322,18 @@ void initialize_args(struct p_args *args_ptr)
 	args_ptr->files_cfg.output_filename = "";
 	args_ptr->compute_cfg.filter_type = NULL;
 	args_ptr->compute_cfg.compute_mode = CONV_COMPUTE_INIT;
+	args_ptr->compute_cfg.tiled = 0;
+	args_ptr->compute_cfg.winograd = 1;
+	args_ptr->compute_cfg.inplace = 0;
+	args_ptr->compute_cfg.sigma = DEFAULT_SIGMA;
+	args_ptr->compute_cfg.sigma_r = DEFAULT_SIGMA_R;
+	args_ptr->compute_cfg.accuracy = 0;
+	args_ptr->compute_cfg.radius = DEFAULT_MORPH_RADIUS;
+	args_ptr->compute_cfg.decimate = 1;
+	args_ptr->compute_cfg.uniform_skip = 0;
+	args_ptr->compute_cfg.gray = 1;
+	args_ptr->compute_cfg.affinity = CONV_AFFINITY_NONE;
+	args_ptr->compute_cfg.order = CONV_ORDER_RASTER;
 	args_ptr->log_enabled = 0;
 	args_ptr->compute_cfg.backend = CONV_BACKEND_CPU;
 	args_ptr->compute_cfg.queue = 0; 
@@ -204,6 +345,9 @@ void initialize_args(struct p_args *args_ptr)
 	args_ptr->files_cfg.file_cnt = 0;
 	args_ptr->compute_ctx.qm.tq_memory_limit_mb = DEFAULT_QUEUE_MEM_LIMIT;
 	args_ptr->compute_ctx.qm.tq_capacity = DEFAULT_QUEUE_CAP;
+	args_ptr->compute_ctx.qm.split_px = DEFAULT_QUEUE_SPLIT_PX;
+	args_ptr->compute_ctx.qm.rebalance_ms = 0;
+	args_ptr->compute_ctx.qm.policy = CONV_QUEUE_FIFO;
 
 	args_ptr->files_cfg.input_filename = malloc(DEFAULT_QUEUE_CAP * sizeof(char *));
 	if (!args_ptr->files_cfg.input_filename) {
@@ -218,12 +362,18 @@ void initialize_args(struct p_args *args_ptr)
 
 char *check_filter_arg(char *filter)
 {
+	char valid_list[128] = "";
+	size_t len = 0;
+
 	for (int i = 0; valid_filters[i] != NULL; i++) {
 		if (strcmp(filter, valid_filters[i]) == 0) {
 			return filter;
 		}
 	}
-	log_error("Error: Invalid filter type '%s'. Valid types are: bb, mb, em, gg, gb, co, sh, mm, bo, mg\n", filter);
+	// listed from valid_filters, so that a new filter is never missing from the message
+	for (int i = 0; valid_filters[i] != NULL && len < sizeof(valid_list); i++)
+		len += snprintf(valid_list + len, sizeof(valid_list) - len, "%s%s", i ? ", " : "", valid_filters[i]);
+	log_error("Error: Invalid filter type '%s'. Valid types are: %s\n", filter, valid_list);
 	return NULL;
 }
 
@@ -238,7 +388,7 @@ int check_mode_arg(char *mode_str)
 			return i;
 		}
 	}
-	log_error("Error: Invalid mode '%s' (len=%zu). Valid modes are: by_row, by_column, by_pixel, by_grid\n", mode_str, strlen(mode_str));
+	log_error("Error: Invalid mode '%s' (len=%zu). Valid modes are: by_row, by_column, by_pixel, by_grid, work_steal, guided, auto\n", mode_str, strlen(mode_str));
 	return -1;
 }
 
@@ -279,6 +429,11 @@ int parse_args(int argc, char *argv[], struct p_args *args)
 		return -1;
 	}
 
+	if (parse_optional_args(argc, argv, args) < 0) {
+		log_error("Error parsing optional arguments.\n");
+		return -1;
+	}
+
 	if (args->compute_cfg.queue == CONV_QUEUE_ENABLED) {
 		if (parse_queue_mode_args(argc, argv, args) < 0) {
 			log_error("Error parsing queue-mode specific arguments.\n");
@@ -7,6 +7,12 @@
 
 #define DEFAULT_QUEUE_CAP 20
 #define DEFAULT_QUEUE_MEM_LIMIT 500
+#define DEFAULT_QUEUE_SPLIT_PX (1 << 20)
+#define DEFAULT_SIGMA 2.0
+#define DEFAULT_SIGMA_R 25.0
+#define DEFAULT_MORPH_RADIUS 7
+#define MORPH_MAX_RADIUS 63 // open/close reach 2 * radius, which must fit the MPI halo (uint8_t)
+#define BILATERAL_MIN_SIGMA 1.0 // bl grid cells are never smaller than a pixel (--sigma) or a luminance level (--sigma-r)
 
 struct files_cfg {
 	char **input_filename;
@@ -25,7 +31,10 @@ enum conv_compute_mode {
 	CONV_COMPUTE_BY_ROW, 
 	CONV_COMPUTE_BY_COLUMN, 
 	CONV_COMPUTE_BY_PIXEL, 
-	CONV_COMPUTE_BY_GRID 
+	CONV_COMPUTE_BY_GRID,
+	CONV_COMPUTE_WORK_STEAL,
+	CONV_COMPUTE_GUIDED,
+	CONV_COMPUTE_AUTO // resolved to one of the above by mt_autotune() before the computation
 };
 
 enum conv_backend {
@@ -48,11 +57,43 @@ enum conv_mpi_mode {
     CONV_MPI_ENABLED
 };
 
+enum conv_affinity {
+	CONV_AFFINITY_NONE,
+	CONV_AFFINITY_COMPACT,
+	CONV_AFFINITY_SCATTER,
+	CONV_AFFINITY_ROLE
+};
+
+enum conv_tile_order {
+	CONV_ORDER_RASTER,
+	CONV_ORDER_MORTON,
+	CONV_ORDER_HILBERT
+};
+
+// order in which queued images are popped in queue mode
+enum conv_queue_policy {
+	CONV_QUEUE_FIFO,
+	CONV_QUEUE_SJF, // smallest (cheapest) image first
+	CONV_QUEUE_LJF // largest first
+};
+
 struct compute_cfg {
 	char *filter_type;
 
-	uint8_t block_size;
+	uint32_t block_size;
 	enum conv_compute_mode compute_mode;
+	uint8_t tiled; // cache-blocked convolution engine
+	uint8_t winograd; // Winograd engine for 3x3 integer kernels
+	uint8_t inplace; // result overwrites the input image
+	double sigma; // standard deviation for parametric filters
+	double sigma_r; // range standard deviation of the bilateral filter, in luminance levels
+	uint8_t accuracy; // compare parametric filter against the direct convolution
+	uint16_t radius; // structuring element radius for morphology filters
+	uint8_t decimate; // output keeps every n-th pixel of every n-th row (1 - full size)
+	uint8_t uniform_skip; // fill windows over flat areas without evaluating them
+	uint8_t gray; // single-channel engines for grayscale inputs
+	enum conv_affinity affinity; // thread pinning and first-touch placement policy
+	enum conv_tile_order order; // order in which by_grid tiles are claimed
 
 	enum conv_backend backend; 
 	enum conv_threadnum threadnum; 
@@ -70,6 +111,9 @@ struct p_args {
 			struct threads_cfg threads_cfg;
 			uint32_t tq_capacity; // max el cnt in queue
 			size_t tq_memory_limit_mb;
+			uint64_t split_px; // images of at least this many pixels are split into pool tasks, smaller ones are computed by their worker
+			uint32_t rebalance_ms; // interval of the reader/worker/writer rebalancer, 0 - fixed roles
+			enum conv_queue_policy policy; // order of the files read and of the queued images popped
 		} qm;
 		int8_t threadnum;
 	} compute_ctx; 
@@ -118,9 +162,24 @@ char *check_filter_arg(char *filter);
  */
 int parse_mandatory_args(int argc, char *argv[], struct p_args *args);
 
+/**
+ * Parses optional tuning arguments shared by both normal and queue modes:
+ * --tile=<0|1>, --winograd=<0|1>, --inplace=<0|1>, --sigma=<S>, --sigma-r=<R>, --accuracy=<0|1>, --radius=<R>, --decimate=<1|2|4|8>,
+ * --uniform-skip=<0|1>, --gray=<0|1>, --affinity=<policy>, --order=<raster|morton|hilbert>.
+ * Stores them in the args structure and marks processed arguments in argv with "_".
+ *
+ * @param argc Argument cnt from main().
+ * @param argv Argument vector from main().
+ * @param args Pointer to the p_args structure to store parsed values.
+ *
+ * @return 0 on success, -1 on parsing or validation error.
+ */
+int parse_optional_args(int argc, char *argv[], struct p_args *args);
+
 /**
  * Parses arguments specific to the queue-based execution mode:
- * --log=<0|1>, --lim=<MB>, --output=<prefix>, --rww=<R,W,T>, and input filenames.
+ * --log=<0|1>, --queue-size=<N>, --queue-mem=<MB>, --queue-split=<px>, --rebalance=<ms>, --queue-policy=<fifo|sjf|ljf>,
+ * --output=<prefix>, --rww=<R,W,T>, and input filenames.
  * Validates the --rww argument format and range. Collects remaining non-option arguments as input filenames. Marks processed arguments in argv with "_".
  *
  * @param argc Argument cnt from main().
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "eventcount.h"
+#include <errno.h>
+
+void ec_init(struct eventcount *ec)
+{
+	ec->epoch = 0;
+	ec->waiters = 0;
+	pthread_mutex_init(&ec->lock, NULL);
+	pthread_cond_init(&ec->cond, NULL);
+}
+
+void ec_destroy(struct eventcount *ec)
+{
+	pthread_mutex_destroy(&ec->lock);
+	pthread_cond_destroy(&ec->cond);
+}
+
+uint32_t ec_prepare_wait(struct eventcount *ec)
+{
+	// seq_cst pairs with the fence in ec_notify(): either the notifier sees the waiter or the waiter's re-check sees the change
+	__atomic_fetch_add(&ec->waiters, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&ec->epoch, __ATOMIC_ACQUIRE);
+}
+
+void ec_cancel_wait(struct eventcount *ec)
+{
+	__atomic_fetch_sub(&ec->waiters, 1, __ATOMIC_RELAXED);
+}
+
+int ec_wait(struct eventcount *ec, uint32_t key, const struct timespec *abstime)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&ec->lock);
+	// the epoch only changes under the lock, so a notification can't slip in between the check and the sleep
+	while (__atomic_load_n(&ec->epoch, __ATOMIC_RELAXED) == key && rc == 0)
+		rc = abstime ? pthread_cond_timedwait(&ec->cond, &ec->lock, abstime) : pthread_cond_wait(&ec->cond, &ec->lock);
+	pthread_mutex_unlock(&ec->lock);
+	__atomic_fetch_sub(&ec->waiters, 1, __ATOMIC_RELAXED);
+
+	return rc == ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+void ec_notify(struct eventcount *ec)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&ec->waiters, __ATOMIC_RELAXED))
+		return;
+
+	pthread_mutex_lock(&ec->lock);
+	__atomic_store_n(&ec->epoch, ec->epoch + 1, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&ec->cond);
+	pthread_mutex_unlock(&ec->lock);
+}
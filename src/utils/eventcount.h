@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Eventcount: lets a thread sleep on a condition of lock-free data without a lost wakeup.
+ * Waiter: key = ec_prepare_wait(), re-check the condition, then ec_cancel_wait() if it holds or ec_wait(key) if it doesn't.
+ * Notifier: change the data, then ec_notify(). The mutex is taken only if somebody is waiting, so the fast paths stay lock-free.
+ */
+struct eventcount {
+	uint32_t epoch; // bumped by every notification that had waiters
+	uint32_t waiters; // threads between ec_prepare_wait() and the end of their wait
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+/**
+ * Initializes the eventcount (no waiters, epoch 0).
+ */
+void ec_init(struct eventcount *ec);
+
+/**
+ * Destroys the mutex and condition variable. No thread may be waiting.
+ */
+void ec_destroy(struct eventcount *ec);
+
+/**
+ * Announces a waiter. The condition must be re-checked after this call.
+ *
+ * @return Key for ec_wait().
+ */
+uint32_t ec_prepare_wait(struct eventcount *ec);
+
+/**
+ * Withdraws a waiter announced by ec_prepare_wait() whose condition turned out to hold.
+ */
+void ec_cancel_wait(struct eventcount *ec);
+
+/**
+ * Sleeps until a notification after ec_prepare_wait() returned `key`, or until `abstime` (CLOCK_REALTIME, NULL for no timeout).
+ *
+ * @return 0 if notified, ETIMEDOUT on timeout.
+ */
+int ec_wait(struct eventcount *ec, uint32_t key, const struct timespec *abstime);
+
+/**
+ * Wakes every waiter. Call after the change the waiters look for is published.
+ */
+void ec_notify(struct eventcount *ec);
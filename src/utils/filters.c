@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 const double motion_blur_arr[9][9] = { { 1, 0, 0, 0, 0, 0, 0, 0, 0 }, { 0, 1, 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 1, 0, 0, 0, 0, 0, 0 },
 				       { 0, 0, 0, 1, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 1, 0, 0, 0 },
@@ -53,6 +54,13 @@ const char* filter_get_name(const char *filter_type) {
     if (strcmp(filter_type, "gg") == 0) return "Large Gaussian Blur"; // big_gaus
     if (strcmp(filter_type, "bo") == 0) return "Box Blur";
     if (strcmp(filter_type, "mg") == 0) return "Medium Gaussian Blur"; // med_gaus
+    if (strcmp(filter_type, "rg") == 0) return "Recursive Gaussian Blur";
+    if (strcmp(filter_type, "pg") == 0) return "Pyramid Gaussian Blur";
+    if (strcmp(filter_type, "bl") == 0) return "Bilateral Filter";
+    if (strcmp(filter_type, "di") == 0) return "Dilate";
+    if (strcmp(filter_type, "er") == 0) return "Erode";
+    if (strcmp(filter_type, "op") == 0) return "Open";
+    if (strcmp(filter_type, "cl") == 0) return "Close";
 
     return "Unknown Filter";
 }
@@ -98,12 +106,7 @@ static void init_filter(struct filter **f, int size, double bias, double factor,
 	}
 }
 
-/**
- * Frees the memory allocated for a filter structure, including its kernel matrix.
- *
- * @param f Pointer to the filter structure to be freed. Assumes `f` and its internal arrays were allocated by `init_filter` or equivalent.
- */
-static void free_filter(struct filter *f)
+void free_filter(struct filter *f)
 {
 	if (!f)
 		return;
@@ -116,6 +119,44 @@ static void free_filter(struct filter *f)
 	free(f);
 }
 
+struct filter *filter_create_gaussian(double sigma)
+{
+	struct filter *f = NULL;
+	int radius, size, x, y;
+	double sum = 0.0;
+
+	radius = (int)ceil(3.0 * sigma);
+	size = 2 * radius + 1;
+
+	f = calloc(1, sizeof(struct filter));
+	if (!f)
+		goto mem_err;
+
+	f->size = size;
+	f->bias = 0.0;
+	f->filter_arr = calloc(size, sizeof(double *));
+	if (!f->filter_arr)
+		goto mem_err;
+
+	for (y = 0; y < size; y++) {
+		f->filter_arr[y] = malloc(size * sizeof(double));
+		if (!f->filter_arr[y])
+			goto mem_err;
+		for (x = 0; x < size; x++) {
+			f->filter_arr[y][x] = exp(-((x - radius) * (x - radius) + (y - radius) * (y - radius)) / (2.0 * sigma * sigma));
+			sum += f->filter_arr[y][x];
+		}
+	}
+	f->factor = 1.0 / sum;
+
+	return f;
+
+mem_err:
+	log_error("Memory allocation failed for %dx%d Gaussian kernel\n", size, size);
+	free_filter(f);
+	return NULL;
+}
+
 void init_filters(struct filter_mix *filters)
 {
 	init_filter(&filters->motion_blur, 9, 0.0, 1.0 / 9.0, motion_blur_arr);
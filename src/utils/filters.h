@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 struct filter {
 	int size;
 	double bias;
@@ -19,6 +21,7 @@ struct filter_mix {
 	struct filter *big_gaus;
 	struct filter *med_gaus;
 	struct filter *box_blur;
+	uint16_t morph_radius; // structuring element radius of the morphology filters (di, er, op, cl)
 };
 
 const char* filter_get_name(const char *filter_type);
@@ -36,3 +39,19 @@ void init_filters(struct filter_mix *filters);
  * @param filters Pointer to the filter_mix structure whose filters need freeing.
  */
 void free_filters(struct filter_mix *filters);
+
+/**
+ * Builds a normalised 2D Gaussian kernel of size 2 * ceil(3 * sigma) + 1.
+ * Used as the direct convolution reference for parametric Gaussian filters.
+ *
+ * @param sigma Gaussian standard deviation in pixels.
+ * @return Newly allocated filter (release with free_filter), or NULL on allocation failure.
+ */
+struct filter *filter_create_gaussian(double sigma);
+
+/**
+ * Frees the memory allocated for a filter structure, including its kernel matrix.
+ *
+ * @param f Pointer to the filter structure to be freed. Assumes `f` and its internal arrays were allocated by `init_filter` or equivalent.
+ */
+void free_filter(struct filter *f);
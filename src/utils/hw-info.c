@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "hw-info.h"
+#include "logger/log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#define SYSFS_CACHE_PATH "/sys/devices/system/cpu/cpu0/cache"
+#define SYSFS_MAX_CACHE_INDEX 8
+#define SYSFS_CPU_PATH "/sys/devices/system/cpu"
+#define PROC_CPUINFO_PATH "/proc/cpuinfo"
+
+static size_t l1d_cache_size = 0;
+static size_t l2_cache_size = 0;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+static int read_sysfs_line(const char *path, char *buf, size_t len)
+{
+	FILE *file = fopen(path, "r");
+
+	if (!file)
+		return -1;
+
+	if (!fgets(buf, len, file)) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+/**
+ * Looks for a cache of the given level in sysfs. Instruction caches are skipped,
+ * so level 1 resolves to L1d and level 2 to the (usually unified) L2.
+ */
+static size_t sysfs_cache_size(int level)
+{
+	char path[128], buf[32];
+	char *end = NULL;
+	size_t size;
+
+	for (int i = 0; i < SYSFS_MAX_CACHE_INDEX; i++) {
+		snprintf(path, sizeof(path), SYSFS_CACHE_PATH "/index%d/level", i);
+		if (read_sysfs_line(path, buf, sizeof(buf)) || atoi(buf) != level)
+			continue;
+
+		snprintf(path, sizeof(path), SYSFS_CACHE_PATH "/index%d/type", i);
+		if (read_sysfs_line(path, buf, sizeof(buf)) || strcmp(buf, "Instruction") == 0)
+			continue;
+
+		snprintf(path, sizeof(path), SYSFS_CACHE_PATH "/index%d/size", i);
+		if (read_sysfs_line(path, buf, sizeof(buf)))
+			continue;
+
+		size = strtoul(buf, &end, 10);
+		if (end && (*end == 'K' || *end == 'k'))
+			size *= 1024;
+		else if (end && (*end == 'M' || *end == 'm'))
+			size *= 1024 * 1024;
+
+		return size;
+	}
+
+	return 0;
+}
+
+static void detect_cache_sizes(void)
+{
+	long rc;
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	rc = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+	if (rc > 0)
+		l1d_cache_size = (size_t)rc;
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	rc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (rc > 0)
+		l2_cache_size = (size_t)rc;
+#endif
+	(void)rc;
+
+	if (!l1d_cache_size)
+		l1d_cache_size = sysfs_cache_size(1);
+	if (!l2_cache_size)
+		l2_cache_size = sysfs_cache_size(2);
+
+#ifdef __APPLE__
+	size_t len = sizeof(size_t);
+	if (!l1d_cache_size)
+		sysctlbyname("hw.l1dcachesize", &l1d_cache_size, &len, NULL, 0);
+	len = sizeof(size_t);
+	if (!l2_cache_size)
+		sysctlbyname("hw.l2cachesize", &l2_cache_size, &len, NULL, 0);
+#endif
+
+	if (!l1d_cache_size)
+		l1d_cache_size = DEFAULT_L1D_CACHE_SIZE;
+	if (!l2_cache_size)
+		l2_cache_size = DEFAULT_L2_CACHE_SIZE;
+
+	log_debug("Detected cache sizes: L1d=%zu bytes, L2=%zu bytes", l1d_cache_size, l2_cache_size);
+}
+
+size_t hw_get_l1d_cache_size(void)
+{
+	pthread_once(&cache_once, detect_cache_sizes);
+	return l1d_cache_size;
+}
+
+size_t hw_get_l2_cache_size(void)
+{
+	pthread_once(&cache_once, detect_cache_sizes);
+	return l2_cache_size;
+}
+
+int hw_get_cpu_node(int cpu)
+{
+	char path[128], buf[32];
+	struct dirent *entry;
+	DIR *dir;
+	int node = -1;
+
+	snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d", cpu);
+	dir = opendir(path);
+	if (dir) {
+		while ((entry = readdir(dir)) != NULL) {
+			if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+				node = atoi(entry->d_name + 4);
+				break;
+			}
+		}
+		closedir(dir);
+	}
+	if (node >= 0)
+		return node;
+
+	snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/physical_package_id", cpu);
+	if (read_sysfs_line(path, buf, sizeof(buf)) == 0 && atoi(buf) >= 0)
+		return atoi(buf);
+
+	return 0;
+}
+
+int hw_get_cpu_model(char *buf, size_t len)
+{
+	char line[256], *value;
+	FILE *file = fopen(PROC_CPUINFO_PATH, "r");
+
+	if (file) {
+		while (fgets(line, sizeof(line), file)) {
+			if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Processor", 9) != 0)
+				continue;
+			value = strchr(line, ':');
+			if (!value)
+				continue;
+			value += strspn(value + 1, " \t") + 1;
+			value[strcspn(value, "\n")] = '\0';
+			snprintf(buf, len, "%s", value);
+			fclose(file);
+			return 0;
+		}
+		fclose(file);
+	}
+#ifdef __APPLE__
+	size_t size = len;
+	if (sysctlbyname("machdep.cpu.brand_string", buf, &size, NULL, 0) == 0)
+		return 0;
+#endif
+	snprintf(buf, len, "unknown");
+
+	return -1;
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stddef.h>
+
+#define DEFAULT_L1D_CACHE_SIZE (32 * 1024)
+#define DEFAULT_L2_CACHE_SIZE (1024 * 1024)
+
+/**
+ * Returns the size of the per-core L1 data cache in bytes.
+ * Tries sysconf() first, then the Linux sysfs cache description, then sysctl on macOS.
+ * The value is detected once and cached for subsequent calls.
+ *
+ * @return L1d size in bytes, or DEFAULT_L1D_CACHE_SIZE if it can't be detected.
+ */
+size_t hw_get_l1d_cache_size(void);
+
+/**
+ * Returns the size of the L2 cache in bytes (same detection order as hw_get_l1d_cache_size).
+ *
+ * @return L2 size in bytes, or DEFAULT_L2_CACHE_SIZE if it can't be detected.
+ */
+size_t hw_get_l2_cache_size(void);
+
+/**
+ * Returns the NUMA node of a CPU: the `nodeN` entry of its sysfs directory, or its physical package (socket) if the kernel has no NUMA information.
+ *
+ * @param cpu CPU number as used by sched_setaffinity().
+ *
+ * @return Node number, 0 if it can't be detected.
+ */
+int hw_get_cpu_node(int cpu);
+
+/**
+ * Writes the CPU model name: the first "model name" (or "Processor" on some ARM kernels) of /proc/cpuinfo on Linux,
+ * machdep.cpu.brand_string on macOS.
+ *
+ * @param buf Destination buffer.
+ * @param len Size of the buffer.
+ *
+ * @return 0 on success, -1 if the model can't be detected ("unknown" is written then).
+ */
+int hw_get_cpu_model(char *buf, size_t len);
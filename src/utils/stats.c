@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "stats.h"
+#include "utils.h"
+#include "logger/log.h"
+#include <stdio.h>
+
+struct run_stats run_stats = { 0 };
+
+void stats_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+void stats_max(uint64_t *counter, uint64_t value)
+{
+	uint64_t cur = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+	while (cur < value && !__atomic_compare_exchange_n(counter, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static FILE *open_stats_file(const struct p_args *args)
+{
+	FILE *file = NULL;
+
+	if (!args->log_enabled)
+		return NULL;
+
+	ensure_log_dir_exists(STATS_LOG_FILE_PATH);
+	file = fopen(STATS_LOG_FILE_PATH, "a");
+	if (!file)
+		log_error("Error: could not open run stats file '%s' for appending.\n", STATS_LOG_FILE_PATH);
+	return file;
+}
+
+void stats_report(const struct p_args *args)
+{
+	uint64_t total = __atomic_load_n(&run_stats.uniform_total_px, __ATOMIC_RELAXED);
+	uint64_t skipped = __atomic_load_n(&run_stats.uniform_skipped_px, __ATOMIC_RELAXED);
+	uint64_t claims = __atomic_load_n(&run_stats.mt_claims, __ATOMIC_RELAXED);
+	uint64_t threads = __atomic_load_n(&run_stats.mt_threads, __ATOMIC_RELAXED);
+	uint64_t claims_max = __atomic_load_n(&run_stats.mt_claims_max, __ATOMIC_RELAXED);
+	uint64_t mem_peak = __atomic_load_n(&run_stats.queue_mem_peak, __ATOMIC_RELAXED);
+	uint64_t mem_budget = __atomic_load_n(&run_stats.queue_mem_budget, __ATOMIC_RELAXED);
+	const char *filter_str = args->compute_cfg.filter_type ? args->compute_cfg.filter_type : "unknown";
+	const char *mode_str = compute_mode_to_str(args->compute_cfg.compute_mode);
+	FILE *file = NULL;
+
+	if (total)
+		log_info("Uniform skip: %llu of %llu pixels (%.2f%%) filled without evaluating the window", (unsigned long long)skipped, (unsigned long long)total,
+			 100.0 * skipped / total);
+	if (threads)
+		log_info("MT claims (%s): %llu over %llu threads, %.1f per thread on average, %llu at most", mode_str, (unsigned long long)claims,
+			 (unsigned long long)threads, (double)claims / threads, (unsigned long long)claims_max);
+
+	if (mem_budget)
+		log_info("Queue memory: peak %llu of %llu bytes (%.2f%% of --queue-mem)", (unsigned long long)mem_peak, (unsigned long long)mem_budget,
+			 100.0 * mem_peak / mem_budget);
+
+	if (!total && !threads && !mem_budget)
+		return;
+	file = open_stats_file(args);
+	if (!file)
+		return;
+
+	// Stat Filter Value Total Fraction
+	if (total)
+		fprintf(file, "uniform_skip %s %llu %llu %.6f\n", filter_str, (unsigned long long)skipped, (unsigned long long)total, (double)skipped / total);
+	// Stat Mode Claims Threads MaxPerThread
+	if (threads)
+		fprintf(file, "mt_claims %s %llu %llu %llu\n", mode_str, (unsigned long long)claims, (unsigned long long)threads, (unsigned long long)claims_max);
+	// Stat Mode PeakBytes BudgetBytes Fraction
+	if (mem_budget)
+		fprintf(file, "queue_mem %s %llu %llu %.6f\n", mode_str, (unsigned long long)mem_peak, (unsigned long long)mem_budget, (double)mem_peak / mem_budget);
+	fclose(file);
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdint.h>
+#include "args-parse.h"
+
+/**
+ * Counters collected over the whole run, on top of the timing results.
+ * Updated with stats_add() from any thread.
+ */
+struct run_stats {
+	uint64_t uniform_total_px; // pixels of images computed with --uniform-skip
+	uint64_t uniform_skipped_px; // of them, pixels filled without evaluating the filter window
+	uint64_t mt_claims; // blocks claimed by the MT workers, one synchronization each
+	uint64_t mt_threads; // MT workers that claimed them
+	uint64_t mt_claims_max; // most blocks claimed by one worker
+	uint64_t queue_mem_peak; // most bytes of images held by the queue pipeline at once
+	uint64_t queue_mem_budget; // its --queue-mem budget in bytes
+};
+
+extern struct run_stats run_stats;
+
+/**
+ * Atomically adds `value` to one of the run_stats counters.
+ */
+void stats_add(uint64_t *counter, uint64_t value);
+
+/**
+ * Atomically raises one of the run_stats counters to `value` if it's lower.
+ */
+void stats_max(uint64_t *counter, uint64_t value);
+
+/**
+ * Logs the collected counters and, if logging is enabled, appends them to STATS_LOG_FILE_PATH.
+ * Does nothing if no counter was touched during the run.
+ *
+ * @param args Pointer to the p_args structure (filter type, log flag).
+ */
+void stats_report(const struct p_args *args);
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "thread-pool.h"
+#include "affinity.h"
+#include "logger/log.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// tasks of one thread_pool_run() call, lives on the caller's stack
+struct pool_batch {
+	pool_task_fn fn;
+	void *ctx;
+	int ntasks;
+	int next; // next task to hand out
+	int done; // finished tasks
+	pthread_cond_t done_cond;
+	struct pool_batch *next_batch;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	struct pool_batch *head, *tail; // batches with tasks not handed out yet
+	struct pool_batch *bound; // batch with one task per thread (thread_pool_run_bound)
+	uint64_t bound_seq; // bumped for every bound batch
+	pthread_mutex_t bound_lock; // one bound batch at a time
+	pthread_t *threads;
+	int size;
+	int stop;
+	int idle_helpers; // helping callers waiting for work, woken on new batches and finished batches
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .work_cond = PTHREAD_COND_INITIALIZER, .bound_lock = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread int in_pool_thread;
+static __thread int helping;
+
+// hands out the next task of the oldest batch, called with pool.lock held
+static struct pool_batch *pool_take_task(int *idx)
+{
+	struct pool_batch *batch = pool.head;
+
+	*idx = batch->next++;
+	if (batch->next == batch->ntasks) {
+		pool.head = batch->next_batch;
+		if (!pool.head)
+			pool.tail = NULL;
+	}
+	return batch;
+}
+
+// runs one task with pool.lock released, called and returns with it held
+static void pool_run_task(struct pool_batch *batch, int idx)
+{
+	pthread_mutex_unlock(&pool.lock);
+	batch->fn(batch->ctx, idx);
+	pthread_mutex_lock(&pool.lock);
+
+	if (++batch->done == batch->ntasks) {
+		pthread_cond_signal(&batch->done_cond);
+		if (pool.idle_helpers)
+			pthread_cond_broadcast(&pool.work_cond);
+	}
+}
+
+static void *pool_thread_function(void *arg)
+{
+	struct pool_batch *batch;
+	uint64_t seen_seq = 0;
+	int self = (int)(intptr_t)arg, idx;
+
+	in_pool_thread = 1;
+	affinity_pin_compute(self);
+
+	pthread_mutex_lock(&pool.lock);
+	while (1) {
+		while (!pool.head && pool.bound_seq == seen_seq && !pool.stop)
+			pthread_cond_wait(&pool.work_cond, &pool.lock);
+
+		if (pool.bound_seq != seen_seq) {
+			seen_seq = pool.bound_seq;
+			batch = pool.bound;
+			idx = self;
+		} else if (pool.head) {
+			batch = pool_take_task(&idx);
+		} else {
+			break;
+		}
+		pool_run_task(batch, idx);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+int thread_pool_init(int threadnum)
+{
+	int i;
+
+	if (threadnum <= 1)
+		return 0;
+
+	pool.threads = malloc(threadnum * sizeof(pthread_t));
+	if (!pool.threads) {
+		log_error("Error: Failed to allocate thread pool.");
+		return -1;
+	}
+	pool.stop = 0;
+	pool.bound_seq = 0;
+
+	for (i = 0; i < threadnum; i++) {
+		if (pthread_create(&pool.threads[i], NULL, pool_thread_function, (void *)(intptr_t)i) != 0) {
+			log_error("Error: Failed to create pool thread %d.", i);
+			pool.size = i;
+			thread_pool_destroy();
+			return -1;
+		}
+	}
+	pool.size = threadnum;
+	log_debug("Thread pool started with %d threads", threadnum);
+
+	return 0;
+}
+
+void thread_pool_destroy(void)
+{
+	int i;
+
+	if (!pool.threads)
+		return;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.work_cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.size; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	free(pool.threads);
+	pool.threads = NULL;
+	pool.size = 0;
+}
+
+int thread_pool_size(void)
+{
+	return pool.size;
+}
+
+void thread_pool_set_helping(int enable)
+{
+	helping = enable;
+}
+
+void thread_pool_run(int ntasks, pool_task_fn fn, void *ctx)
+{
+	struct pool_batch batch = { .fn = fn, .ctx = ctx, .ntasks = ntasks };
+	struct pool_batch *task_batch;
+	int i, idx;
+
+	// a pool thread waiting for its own batch could leave nobody to run it
+	if (!pool.size || in_pool_thread || ntasks <= 1) {
+		for (i = 0; i < ntasks; i++)
+			fn(ctx, i);
+		return;
+	}
+
+	pthread_cond_init(&batch.done_cond, NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.tail)
+		pool.tail->next_batch = &batch;
+	else
+		pool.head = &batch;
+	pool.tail = &batch;
+	pthread_cond_broadcast(&pool.work_cond);
+
+	while (batch.done < ntasks) {
+		if (!helping) {
+			pthread_cond_wait(&batch.done_cond, &pool.lock);
+			continue;
+		}
+		// tasks of any batch, so the waiting callers of small images help with the large ones
+		if (pool.head) {
+			task_batch = pool_take_task(&idx);
+			in_pool_thread = 1;
+			pool_run_task(task_batch, idx);
+			in_pool_thread = 0;
+			continue;
+		}
+		pool.idle_helpers++;
+		pthread_cond_wait(&pool.work_cond, &pool.lock);
+		pool.idle_helpers--;
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	pthread_cond_destroy(&batch.done_cond);
+}
+
+void thread_pool_run_bound(int ntasks, pool_task_fn fn, void *ctx)
+{
+	struct pool_batch batch = { .fn = fn, .ctx = ctx, .ntasks = ntasks };
+
+	if (ntasks != pool.size || in_pool_thread) {
+		thread_pool_run(ntasks, fn, ctx);
+		return;
+	}
+
+	pthread_cond_init(&batch.done_cond, NULL);
+	pthread_mutex_lock(&pool.bound_lock);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.bound = &batch;
+	pool.bound_seq++;
+	pthread_cond_broadcast(&pool.work_cond);
+
+	while (batch.done < ntasks)
+		pthread_cond_wait(&batch.done_cond, &pool.lock);
+	pool.bound = NULL;
+	pthread_mutex_unlock(&pool.lock);
+
+	pthread_mutex_unlock(&pool.bound_lock);
+	pthread_cond_destroy(&batch.done_cond);
+}
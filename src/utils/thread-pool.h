@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+/**
+ * Task callback for thread_pool_run: `idx` is the index of the task in its batch.
+ */
+typedef void (*pool_task_fn)(void *ctx, int idx);
+
+/**
+ * Starts the process-wide worker pool, which all CPU execution paths submit their work to.
+ * Created once by the CPU backend, so the threads (and their caches) survive between images.
+ * With threadnum <= 1 no threads are started and thread_pool_run() runs tasks in the caller.
+ *
+ * @param threadnum Number of worker threads.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int thread_pool_init(int threadnum);
+
+/**
+ * Stops and joins the pool threads. Must not race with thread_pool_run().
+ */
+void thread_pool_destroy(void);
+
+/**
+ * @return Number of pool threads (0 if the pool isn't running).
+ */
+int thread_pool_size(void);
+
+/**
+ * Makes the calling thread run pool tasks while it waits in thread_pool_run(): tasks of any batch, oldest first.
+ * Used by queue workers, so a worker waiting for its image helps with the others instead of sleeping.
+ *
+ * @param enable 1 to help, 0 to sleep until the own batch is done (default).
+ */
+void thread_pool_set_helping(int enable);
+
+/**
+ * Runs fn(ctx, 0) .. fn(ctx, ntasks - 1) on the pool and waits for all of them.
+ * Batches from different callers (e.g. queue workers with different images) are served in submission order and may overlap.
+ * Runs the tasks in the calling thread if the pool isn't running or if called from a pool thread.
+ * A helping caller (see thread_pool_set_helping()) takes tasks from the pool until its batch is done.
+ *
+ * @param ntasks Number of tasks.
+ * @param fn Task callback.
+ * @param ctx Opaque context passed to the callback.
+ */
+void thread_pool_run(int ntasks, pool_task_fn fn, void *ctx);
+
+/**
+ * Same as thread_pool_run(), but if `ntasks` equals the pool size, task i runs on pool thread i.
+ * With pinned threads (see affinity_init()) this keeps the data a task places (first touch) local to the thread that computes it.
+ * Bound batches run one at a time and are taken by every thread before its next ordinary task.
+ *
+ * @param ntasks Number of tasks.
+ * @param fn Task callback.
+ * @param ctx Opaque context passed to the callback.
+ */
+void thread_pool_run_bound(int ntasks, pool_task_fn fn, void *ctx);
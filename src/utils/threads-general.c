@@ -6,6 +6,16 @@
 #include "utils.h"
 #include "args-parse.h"
 #include "filters.h"
+#include "backend/cpu/compute/tiled-conv.h"
+#include "backend/cpu/compute/winograd.h"
+#include "backend/cpu/compute/morphology.h"
+#include "backend/cpu/compute/decimate.h"
+#include "backend/cpu/compute/iir-gauss.h"
+#include "backend/cpu/compute/pyramid.h"
+#include "backend/cpu/compute/uniform.h"
+#include "backend/cpu/compute/gray.h"
+#include "backend/cpu/compute/bilateral.h"
+#include "thread-pool.h"
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
@@ -58,22 +68,31 @@ struct img_spec *setup_img_spec(struct p_args *args)
 		return NULL;
 	}
 
-	img_result = malloc(sizeof(bmp_img));
-	if (!img_result) {
-		log_error("Error: Failed to allocate memory for output image.\n");
-		free(dim);
-		bmp_img_free(img);
-		free(img);
-		return NULL;
-	}
+	if (args->compute_cfg.inplace && args->compute_cfg.backend == CONV_BACKEND_CPU) {
+		// result overwrites the source image, no second buffer is needed
+		img_result = img;
+		init_output_header(&img_result->img_header, &img->img_header, dim->width, dim->height);
+	} else {
+		img_result = malloc(sizeof(bmp_img));
+		if (!img_result) {
+			log_error("Error: Failed to allocate memory for output image.\n");
+			free(dim);
+			bmp_img_free(img);
+			free(img);
+			return NULL;
+		}
 
-	bmp_img_init_df(img_result, dim->width, dim->height);
+		bmp_img_init_df(img_result, DECIMATED_SIZE(dim->width, args->compute_cfg.decimate), DECIMATED_SIZE(dim->height, args->compute_cfg.decimate));
+		init_output_header(&img_result->img_header, &img->img_header, img_result->img_header.biWidth, img_result->img_header.biHeight);
+	}
 
 	img_spec = init_img_spec(img, img_result, dim);
 	if (!img_spec) {
 		log_error("Error: Failed to initialize image spec.\n");
-		bmp_img_free(img_result);
-		free(img_result);
+		if (img_result != img) {
+			bmp_img_free(img_result);
+			free(img_result);
+		}
 		free(dim);
 		bmp_img_free(img);
 		free(img);
@@ -94,11 +113,12 @@ struct filter_mix *setup_filters(struct p_args *args)
 	}
 
 	init_filters(filters);
+	filters->morph_radius = args->compute_cfg.radius;
 
 	return filters;
 }
 
-struct img_dim *init_dimensions(uint16_t width, uint16_t height)
+struct img_dim *init_dimensions(uint32_t width, uint32_t height)
 {
 	struct img_dim *dim;
 
@@ -129,6 +149,10 @@ struct img_spec *init_img_spec(bmp_img *input, bmp_img *output, struct img_dim *
 	spec->input = input;
 	spec->output = output;
 	spec->dim = dim;
+	spec->uniform = NULL;
+	spec->bilateral = NULL;
+	spec->gray_input = NULL;
+	spec->gray_output = NULL;
 
 	return spec;
 }
@@ -175,10 +199,10 @@ void apply_filter(struct thread_spec *spec, struct filter cfilter)
 	int padding = cfilter.size / 2;
 	int32_t potential_imageY = 0, potential_imageX = 0;
 
-	log_trace("Applying filter size %d to region R[%d-%d) C[%d-%d)", cfilter.size, spec->start_row, spec->end_row, spec->start_column, spec->end_column);
+	log_trace("Applying filter size %d to region R[%u-%u) C[%u-%u)", cfilter.size, spec->start_row, spec->end_row, spec->start_column, spec->end_column);
 
-	for (y = spec->start_row; y < spec->end_row; y++) {
-		for (x = spec->start_column; x < spec->end_column; x++) {
+	for (y = spec->start_row; y < (int32_t)spec->end_row; y++) {
+		for (x = spec->start_column; x < (int32_t)spec->end_column; x++) {
 			red_acc = 0.0;
 			green_acc = 0.0;
 			blue_acc = 0.0;
@@ -189,7 +213,7 @@ void apply_filter(struct thread_spec *spec, struct filter cfilter)
 					potential_imageX = x + filterX - padding;
 					if (potential_imageX < 0) {
 						imageX = 0;
-					} else if (potential_imageX >= dim->width) {
+					} else if (potential_imageX >= (int32_t)dim->width) {
 						imageX = dim->width - 1;
 					} else {
 						imageX = potential_imageX;
@@ -198,14 +222,14 @@ void apply_filter(struct thread_spec *spec, struct filter cfilter)
 					potential_imageY = y + filterY - padding;
 					if (potential_imageY < 0) {
 						imageY = 0;
-					} else if (potential_imageY >= dim->height) {
+					} else if (potential_imageY >= (int32_t)dim->height) {
 						imageY = dim->height - 1;
 					} else {
 						imageY = potential_imageY;
 					}
 
-					if (imageY < 0 || imageY >= dim->height || imageX < 0 || imageX >= dim->width) {
-						log_error("apply_filter: Calculated index out of bounds after clamping! Y=%d (H=%d), X=%d (W=%d)", imageY, dim->height,
+					if (imageY < 0 || imageY >= (int32_t)dim->height || imageX < 0 || imageX >= (int32_t)dim->width) {
+						log_error("apply_filter: Calculated index out of bounds after clamping! Y=%d (H=%u), X=%d (W=%u)", imageY, dim->height,
 							  imageX, dim->width);
 						continue;
 					}
@@ -250,10 +274,10 @@ void apply_median_filter(struct thread_spec *spec, uint16_t filter_size)
 		goto mem_err;
 	}
 
-	log_trace("Applying median filter size %u to region R[%d-%d) C[%d-%d)", filter_size, spec->start_row, spec->end_row, spec->start_column, spec->end_column);
+	log_trace("Applying median filter size %u to region R[%u-%u) C[%u-%u)", filter_size, spec->start_row, spec->end_row, spec->start_column, spec->end_column);
 
-	for (int y = spec->start_row; y < spec->end_row; y++) {
-		for (int x = spec->start_column; x < spec->end_column; x++) {
+	for (int y = spec->start_row; y < (int32_t)spec->end_row; y++) {
+		for (int x = spec->start_column; x < (int32_t)spec->end_column; x++) {
 			int n = 0; // Index for neighborhood arrays
 
 			// Collect neighboring pixel values
@@ -285,39 +309,68 @@ mem_err:
 	free(blue);
 }
 
-void filter_part_computation(struct thread_spec *spec)
+static void filter_region_computation(struct thread_spec *spec)
 {
 	char *filter_type = spec->st_gen_info->args->compute_cfg.filter_type;
 	struct filter_mix *filters = spec->st_gen_info->filters;
+	struct filter *cfilter = NULL;
+	uint8_t step;
 
 	if (!filter_type || !filters || !spec) {
-		log_error("NULL parameter passed to filter_part_computation.");
+		log_error("NULL parameter passed to filter_region_computation.");
 		return;
 	}
 
-	if (strcmp(filter_type, "mb") == 0) {
-		apply_filter(spec, *filters->motion_blur);
-	} else if (strcmp(filter_type, "bb") == 0) {
-		apply_filter(spec, *filters->blur);
-	} else if (strcmp(filter_type, "gb") == 0) {
-		apply_filter(spec, *filters->gaus_blur);
-	} else if (strcmp(filter_type, "co") == 0) {
-		apply_filter(spec, *filters->conv);
-	} else if (strcmp(filter_type, "sh") == 0) {
-		apply_filter(spec, *filters->sharpen);
-	} else if (strcmp(filter_type, "em") == 0) {
-		apply_filter(spec, *filters->emboss);
-	} else if (strcmp(filter_type, "mm") == 0) { // Median Filter
-		apply_median_filter(spec, 15); // Using fixed size 15x15 for "mm"
-	} else if (strcmp(filter_type, "gg") == 0) {
-		apply_filter(spec, *filters->big_gaus);
-	} else if (strcmp(filter_type, "bo") == 0) {
-		apply_filter(spec, *filters->box_blur);
-	} else if (strcmp(filter_type, "mg") == 0) {
-		apply_filter(spec, *filters->med_gaus);
-	} else {
+	step = spec->st_gen_info->args->compute_cfg.decimate;
+
+	if (spec->img->gray_input) { // planes are attached only for "mm" and convolution filters at full size
+		if (strcmp(filter_type, "mm") == 0)
+			apply_median_filter_gray(spec, MEDIAN_FILTER_SIZE);
+		else if ((cfilter = get_filter_by_name(filters, filter_type)))
+			apply_filter_gray(spec, *cfilter);
+		return;
+	}
+
+	if (strcmp(filter_type, "mm") == 0) { // Median Filter
+		if (step > 1)
+			apply_median_filter_decimated(spec, MEDIAN_FILTER_SIZE, step);
+		else
+			apply_median_filter(spec, MEDIAN_FILTER_SIZE);
+		return;
+	}
+
+	if (filter_is_morphology(filter_type)) {
+		apply_morphology(spec, filter_type, filters->morph_radius);
+		return;
+	}
+
+	if (filter_is_bilateral(filter_type)) {
+		apply_bilateral(spec);
+		return;
+	}
+
+	cfilter = get_filter_by_name(filters, filter_type);
+	if (!cfilter) {
 		log_error("Unknown filter type parameter '%s' in filter_part_computation.", filter_type);
+		return;
 	}
+
+	if (step > 1)
+		apply_filter_decimated(spec, *cfilter, step);
+	else if (spec->st_gen_info->args->compute_cfg.winograd && winograd_supported(cfilter))
+		apply_filter_winograd(spec, *cfilter);
+	else if (spec->st_gen_info->args->compute_cfg.tiled)
+		apply_filter_tiled(spec, *cfilter);
+	else
+		apply_filter(spec, *cfilter);
+}
+
+void filter_part_computation(struct thread_spec *spec)
+{
+	if (spec && spec->img->uniform)
+		uniform_part_computation(spec, filter_region_computation);
+	else
+		filter_region_computation(spec);
 }
 
 struct filter* get_filter_by_name(struct filter_mix *filters, const char* name) {
@@ -333,6 +386,109 @@ struct filter* get_filter_by_name(struct filter_mix *filters, const char* name)
     return NULL;
 }
 
+int get_filter_window_size(struct filter_mix *filters, const char *filter_type)
+{
+	struct filter *cfilter = NULL;
+
+	if (strcmp(filter_type, "mm") == 0)
+		return MEDIAN_FILTER_SIZE;
+	if (filter_is_morphology(filter_type))
+		return 2 * morph_get_reach(filter_type, filters->morph_radius) + 1;
+	if (filter_is_bilateral(filter_type))
+		return 1; // the grid is built beforehand, slicing reads the pixel itself
+
+	cfilter = get_filter_by_name(filters, filter_type);
+	return cfilter ? cfilter->size : 0;
+}
+
+uint8_t filter_wraps_borders(const char *filter_type)
+{
+	return strcmp(filter_type, "mm") == 0;
+}
+
+uint8_t filter_is_morphology(const char *filter_type)
+{
+	return strcmp(filter_type, "di") == 0 || strcmp(filter_type, "er") == 0 || strcmp(filter_type, "op") == 0 || strcmp(filter_type, "cl") == 0;
+}
+
+uint8_t filter_is_bilateral(const char *filter_type)
+{
+	return strcmp(filter_type, "bl") == 0;
+}
+
+uint8_t filter_is_whole_image(const char *filter_type)
+{
+	return strcmp(filter_type, "rg") == 0 || strcmp(filter_type, "pg") == 0;
+}
+
+double execute_whole_image_computation(int threadnum, struct img_spec *img_spec, struct p_args *args)
+{
+	const char *filter_type = args->compute_cfg.filter_type;
+	double start_time;
+	int rc = -1;
+
+	start_time = get_time_in_seconds();
+
+	if (strcmp(filter_type, "rg") == 0) {
+		rc = iir_gauss_apply(threadnum, img_spec, args->compute_cfg.sigma);
+	} else if (strcmp(filter_type, "pg") == 0) {
+		rc = pyramid_blur_apply(threadnum, img_spec, args->compute_cfg.sigma);
+	} else {
+		log_error("Unknown whole-image filter '%s'.", filter_type);
+	}
+
+	if (rc != 0)
+		return 0;
+
+	return get_time_in_seconds() - start_time;
+}
+
+struct phased_batch {
+	phase_fn fn;
+	void *ctx;
+	int phase;
+	int nthreads;
+};
+
+static void phased_task(void *ctx, int idx)
+{
+	struct phased_batch *batch = (struct phased_batch *)ctx;
+
+	batch->fn(batch->ctx, batch->phase, idx, batch->nthreads);
+}
+
+int run_phased_parallel(int threadnum, int phases, phase_fn fn, void *ctx)
+{
+	struct phased_batch batch = { .fn = fn, .ctx = ctx, .nthreads = threadnum };
+
+	// one pool batch per phase, the end of a batch is the barrier between phases
+	for (batch.phase = 0; batch.phase < phases; batch.phase++)
+		thread_pool_run(threadnum, phased_task, &batch);
+
+	return 0;
+}
+
+void init_output_header(bmp_header *header, const bmp_header *input_header, uint32_t width, uint32_t height)
+{
+	// read before the header is overwritten, they are the same for in-place results
+	unsigned short bits = input_header->biBitCount;
+
+	if (bits == 8)
+		bmp_header_init_gray(header, width, height);
+	else
+		bmp_header_init_df(header, width, height);
+}
+
+void fit_output_depth(bmp_img *img)
+{
+	uint32_t width = img->img_header.biWidth, height = abs(img->img_header.biHeight);
+
+	if (img->img_header.biBitCount != 8 || gray_image_detect(img, width, height))
+		return;
+	log_info("Result of the 8-bit input has colour pixels, writing it as 24-bit.");
+	bmp_header_init_df(&img->img_header, width, height);
+}
+
 void save_result_image(char *output_filepath, size_t path_len, int threadnum, bmp_img *img_result, struct p_args *args)
 {
 	int8_t status = 0;
@@ -366,6 +522,7 @@ void save_result_image(char *output_filepath, size_t path_len, int threadnum, bm
 	if (!img_result->img_pixels)
 		log_error("Pointer to images pixel array is NULL");
 
+	fit_output_depth(img_result);
 	status = bmp_img_write(img_result, output_filepath);
 	if (status)
 		log_debug("bmp_img_write status:%d", status);
@@ -381,8 +538,10 @@ void free_img_spec(struct img_spec *img_data)
 
 void bmp_free_img_spec(struct img_spec *img_data)
 {
+	// in-place computation shares the pixel buffer between input and output
+	if (img_data->output->img_pixels != img_data->input->img_pixels)
+		bmp_img_free(img_data->output);
 	bmp_img_free(img_data->input);
-	bmp_img_free(img_data->output);
 }
 
 void bmp_img_pixel_free(bmp_pixel **pixels_to_free, const struct img_dim *original_dim)
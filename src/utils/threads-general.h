@@ -8,29 +8,38 @@
 #include "args-parse.h"
 #include "filters.h"
 
+#define MEDIAN_FILTER_SIZE 15
+
 // thread-specific parameters for computation only.
 struct thread_spec {
 	struct img_spec *img;
 	struct st_gen_info *st_gen_info;
-	uint16_t start_column;
-	uint16_t start_row;
-	uint16_t end_row;
-	uint16_t end_column;
+	uint32_t start_column;
+	uint32_t start_row;
+	uint32_t end_row;
+	uint32_t end_column;
 };
 
 // i know that isn't necessary, just a way to make it cleaner
 // (somewhere without 6 '->'), just an alias
 struct img_dim {
-	uint16_t height;
-	uint16_t width;
+	uint32_t height;
+	uint32_t width;
 };
 
+struct uniform_map;
+struct bilateral_grid;
+
 // since thread manages only 1 image computation -> this struct is used.
 struct img_spec {
 	bmp_img *input;
 	bmp_img *output;
 
 	struct img_dim *dim;
+	struct uniform_map *uniform; // flat tiles of the input (--uniform-skip), NULL if not built
+	struct bilateral_grid *bilateral; // grid of the input for "bl", NULL if not built
+	unsigned char *gray_input; // single-channel planes of a grayscale input (--gray), NULL if not attached
+	unsigned char *gray_output;
 };
 
 // simple threads general info
@@ -50,7 +59,7 @@ struct filter_mix *setup_filters(struct p_args *args);
  * @param height The height of the image in pixels.
  * @return Pointer to the newly allocated img_dim structure, or NULL on failure.
  */
-struct img_dim *init_dimensions(uint16_t width, uint16_t height);
+struct img_dim *init_dimensions(uint32_t width, uint32_t height);
 
 /**
  * Allocates and initializes an image specification structure, linking input and output image buffers.
@@ -102,7 +111,8 @@ void apply_filter(struct thread_spec *spec, struct filter cfilter);
 void apply_median_filter(struct thread_spec *spec, uint16_t filter_size);
 
 /**
- * Selects and applies the appropriate filter based on the filter_type string. Compares filter_type against known filter identifiers and calls either `apply_filter` (for convolution filters) or `apply_median_filter`.
+ * Selects and applies the appropriate filter based on the filter_type string. Compares filter_type against known filter identifiers and calls `apply_filter` (or one of its engines) for convolution filters, `apply_median_filter` or `apply_morphology`.
+ * If the image has a uniform map, flat tiles are filled directly and only the rest of the region reaches the engine (see uniform_part_computation).
  *
  * @param spec Pointer to the thread_spec structure containing image data and processing range.
  * @param filters Pointer to the filter_mix structure containing pre-initialized filter data.
@@ -112,6 +122,86 @@ void filter_part_computation(struct thread_spec *spec);
 
 struct filter* get_filter_by_name(struct filter_mix *filters, const char* name);
 
+/**
+ * Returns the side of the square pixel window the filter reads around each output pixel
+ * (kernel size for convolution filters, MEDIAN_FILTER_SIZE for the median, 2 * reach + 1 for morphology).
+ *
+ * @param filters Pointer to the filter_mix structure containing pre-initialized filter data.
+ * @param filter_type Filter identifier.
+ * @return Window size, or 0 for unknown filters.
+ */
+int get_filter_window_size(struct filter_mix *filters, const char *filter_type);
+
+/**
+ * Tells whether the filter resolves out-of-bounds neighbours by wrapping around the image (median)
+ * instead of clamping them to the border (convolution filters).
+ */
+uint8_t filter_wraps_borders(const char *filter_type);
+
+/**
+ * Tells whether the filter is a min/max morphology filter (di, er, op, cl), see apply_morphology.
+ */
+uint8_t filter_is_morphology(const char *filter_type);
+
+/**
+ * Tells whether the filter is the bilateral filter, computed region by region by slicing a grid built beforehand from the whole image.
+ */
+uint8_t filter_is_bilateral(const char *filter_type);
+
+/**
+ * Tells whether the filter needs the whole image at once (e.g. recursive filters) and therefore
+ * can't be computed region by region through filter_part_computation.
+ */
+uint8_t filter_is_whole_image(const char *filter_type);
+
+/**
+ * Applies a whole-image filter (see filter_is_whole_image) using `threadnum` threads.
+ *
+ * @param threadnum Number of threads to use.
+ * @param img_spec Image spec (input, output and dimensions). Output may alias the input.
+ * @param args Pointer to the p_args structure (filter type and its parameters).
+ *
+ * @return Time spent (in seconds) for the computation, or 0 on error.
+ */
+double execute_whole_image_computation(int threadnum, struct img_spec *img_spec, struct p_args *args);
+
+/**
+ * Phase callback for run_phased_parallel: `tid` is the index of the calling thread among `nthreads`.
+ */
+typedef void (*phase_fn)(void *ctx, int phase, int tid, int nthreads);
+
+/**
+ * Runs `fn` for phases 0 .. phases - 1 as `threadnum` tasks on the shared thread pool. All tasks finish a phase before any of them starts the next one.
+ * With threadnum == 1 runs everything in the calling thread.
+ *
+ * @param threadnum Number of threads.
+ * @param phases Number of phases.
+ * @param fn Phase callback.
+ * @param ctx Opaque context passed to the callback.
+ *
+ * @return 0 on success.
+ */
+int run_phased_parallel(int threadnum, int phases, phase_fn fn, void *ctx);
+
+/**
+ * Initializes the header of a width x height result of an image: 8 bits with a grayscale palette if the input header is 8-bit, 24 bits otherwise.
+ * `header` may be `input_header` itself (in-place results).
+ *
+ * @param header Output header.
+ * @param input_header Header the input image was read with.
+ * @param width Output width.
+ * @param height Output height.
+ */
+void init_output_header(bmp_header *header, const bmp_header *input_header, uint32_t width, uint32_t height);
+
+/**
+ * Keeps an 8-bit output header only if every pixel of the result has R = G = B, otherwise switches it to 24 bits.
+ * Called right before a result is written, so the file format depends on the input and the result, not on the engine that computed it.
+ *
+ * @param img Result image.
+ */
+void fit_output_depth(bmp_img *img);
+
 void save_result_image(char *output_filepath, size_t path_len, int threadnum, bmp_img *img_result, struct p_args *args);
 void free_img_spec(struct img_spec *img_data);
 void bmp_free_img_spec(struct img_spec *img_data);
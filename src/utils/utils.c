@@ -15,7 +15,10 @@
 #include <errno.h>
 
 const char *valid_tags[] = { "QPOP", "QPUSH", "READER", "WORKER", "WRITER", NULL };
-const char *valid_modes[] = { "by_row", "by_column", "by_pixel", "by_grid" };
+const char *valid_affinities[] = { "none", "compact", "scatter", "role", NULL };
+const char *valid_orders[] = { "raster", "morton", "hilbert", NULL };
+const char *valid_queue_policies[] = { "fifo", "sjf", "ljf", NULL };
+const char *valid_modes[] = { "by_row", "by_column", "by_pixel", "by_grid", "work_steal", "guided", "auto", NULL };
 
 void swap(int *a, int *b)
 {
@@ -64,7 +67,7 @@ double get_time_in_seconds(void)
 
 const char *compute_mode_to_str(enum conv_compute_mode mode)
 {
-	if ((size_t)mode <= 3) {
+	if ((size_t)mode <= CONV_COMPUTE_AUTO) {
 		return valid_modes[mode];
 	}
 	return "unknown";
@@ -172,14 +175,6 @@ void write_logs(struct p_args *args, double result_time, enum conv_backend backe
 		backend_str, exec_mode_str, filter_str, args->compute_ctx.threadnum, compute_mode_str, args->compute_cfg.block_size, result_time);
 }
 
-void set_wait_time(struct timespec *wait_time)
-{
-	clock_gettime(CLOCK_REALTIME, wait_time);
-	wait_time->tv_nsec += NSEC_OFFSET;
-	wait_time->tv_sec += wait_time->tv_nsec / 1000000000L;
-	wait_time->tv_nsec %= 1000000000L;
-}
-
 int compare_images(const bmp_img *img1, const bmp_img *img2)
 {
 	int width, height;
@@ -17,15 +17,19 @@
 #define MAX_FILTER_SIZE 9
 #define PADDING (cfilter.size / 2)
 #define MAX_FILTERS 10
-#define NSEC_OFFSET (1000 * 1000000) // 1000 ms in nanoseconds
 
 #define CPU_LOG_FILE_PATH "tests/logs/cpu-timing-results.dat"
 #define GPU_LOG_FILE_PATH "tests/logs/gpu-timing-results.dat"
 
 #define CPU_QT_LOG_FILE_PATH "tests/logs/cpu-queue-timings.dat"
+#define ACCURACY_LOG_FILE_PATH "tests/logs/accuracy-results.dat"
+#define STATS_LOG_FILE_PATH "tests/logs/run-stats.dat"
 
 enum LOG_TAG { QPOP, QPUSH, READER, WORKER, WRITER };
 extern const char *valid_modes[];
+extern const char *valid_affinities[];
+extern const char *valid_orders[];
+extern const char *valid_queue_policies[];
 
 /**
  * Swaps the values of two integers using pointers. Takes pointers to the integers
@@ -83,13 +87,11 @@ void qt_write_logs(double result_time, enum LOG_TAG tag, const char *compute_mod
 void write_logs(struct p_args *args, double result_time, enum conv_backend backend);
 
 /**
- * Calculates an absolute time point in the future for use with timed waits.
- * Gets the current real time and adds a fixed nanosecond offset (NSEC_OFFSET).
- * Populates the `timespec` structure pointed to by `wait_time` with the result.
+ * Creates the parent directory of `file_path` if it doesn't exist yet (one level only).
  *
  * @return void.
  */
-void set_wait_time(struct timespec *wait_time);
+void ensure_log_dir_exists(const char *file_path);
 
 /**
  * Compares two BMP images pixel by pixel to check if they are identical.
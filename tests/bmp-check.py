@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Checks bmp-conv outputs against reference computations that don't depend on the engines under test.
+
+Usage: bmp-check.py morph <input.bmp> <output.bmp> <di|er|op|cl> <radius>
+       bmp-check.py decimated <step> <full.bmp> <output.bmp>
+       bmp-check.py same <bits> <reference.bmp> <output.bmp>
+"""
+
+import struct
+import sys
+
+
+def read_bmp_bits(path):
+    """Returns (width, height, bits, rows): rows top-down, each a list of (b, g, r) tuples (8-bit indices expanded)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    offset = struct.unpack_from("<I", data, 10)[0]
+    header_size, width, height, _, bpp = struct.unpack_from("<IiiHH", data, 14)
+    if bpp not in (8, 24):
+        raise ValueError(f"{path}: {bpp}-bit BMP isn't supported")
+    palette = None
+    if bpp == 8:
+        colours = struct.unpack_from("<I", data, 46)[0] or 256
+        palette = [tuple(data[14 + header_size + 4 * i:14 + header_size + 4 * i + 3]) for i in range(colours)]
+    stride = (width * bpp // 8 + 3) // 4 * 4
+    rows = []
+    for y in range(abs(height)):
+        start = offset + y * stride
+        if palette:
+            rows.append([palette[i] for i in data[start:start + width]])
+        else:
+            row = data[start:start + width * 3]
+            rows.append([tuple(row[3 * x:3 * x + 3]) for x in range(width)])
+    if height > 0:
+        rows.reverse()
+    return width, abs(height), bpp, rows
+
+
+def read_bmp(path):
+    """Returns (width, height, rows), as read_bmp_bits()."""
+    width, height, _, rows = read_bmp_bits(path)
+    return width, height, rows
+
+
+def window_pass(lines, r, op):
+    """op (max or min) over a 2r + 1 window along each line, ends clamped."""
+    out = []
+    for line in lines:
+        ext = [line[0]] * r + line + [line[-1]] * r
+        out.append([op(ext[i:i + 2 * r + 1]) for i in range(len(line))])
+    return out
+
+
+def morph_channel(plane, r, op):
+    """Brute-force square structuring element, as two 1D passes (a square window max/min is separable)."""
+    rows = window_pass(plane, r, op)
+    cols = window_pass([list(c) for c in zip(*rows)], r, op)
+    return [list(c) for c in zip(*cols)]
+
+
+def check_morph(in_path, out_path, filter_type, radius):
+    passes = {"di": [max], "er": [min], "op": [min, max], "cl": [max, min]}[filter_type]
+    width, height, rows = read_bmp(in_path)
+    planes = [[[px[c] for px in row] for row in rows] for c in range(3)]
+    for op in passes:
+        planes = [morph_channel(p, radius, op) for p in planes]
+
+    out_width, out_height, out_rows = read_bmp(out_path)
+    if (out_width, out_height) != (width, height):
+        return f"size {out_width}x{out_height}, expected {width}x{height}"
+    for y in range(height):
+        for x in range(width):
+            expected = tuple(planes[c][y][x] for c in range(3))
+            if out_rows[y][x] != expected:
+                return f"pixel ({x}, {y}) is {out_rows[y][x]}, expected {expected}"
+    return None
+
+
+def check_decimated(full_path, out_path, step):
+    """The output must be the full-resolution result sampled at every step-th row and column, from the top-left pixel."""
+    width, height, rows = read_bmp(full_path)
+    out_width, out_height, out_rows = read_bmp(out_path)
+    expected_size = ((width + step - 1) // step, (height + step - 1) // step)
+    if (out_width, out_height) != expected_size:
+        return f"size {out_width}x{out_height}, expected {expected_size[0]}x{expected_size[1]}"
+    for y in range(out_height):
+        for x in range(out_width):
+            if out_rows[y][x] != rows[y * step][x * step]:
+                return f"pixel ({x}, {y}) is {out_rows[y][x]}, expected {rows[y * step][x * step]} from ({x * step}, {y * step})"
+    return None
+
+
+def check_same(bits, ref_path, out_path):
+    """Same pixels whatever the depth of the reference, and an output of `bits` bits per pixel."""
+    ref_width, ref_height, _, ref_rows = read_bmp_bits(ref_path)
+    width, height, out_bits, rows = read_bmp_bits(out_path)
+    if out_bits != bits:
+        return f"{out_bits}-bit, expected {bits}-bit"
+    if (width, height) != (ref_width, ref_height):
+        return f"size {width}x{height}, expected {ref_width}x{ref_height}"
+    for y in range(height):
+        if rows[y] != ref_rows[y]:
+            x = next(x for x in range(width) if rows[y][x] != ref_rows[y][x])
+            return f"pixel ({x}, {y}) is {rows[y][x]}, expected {ref_rows[y][x]}"
+    return None
+
+
+def main():
+    if len(sys.argv) == 6 and sys.argv[1] == "morph":
+        error = check_morph(sys.argv[2], sys.argv[3], sys.argv[4], int(sys.argv[5]))
+    elif len(sys.argv) == 5 and sys.argv[1] == "decimated":
+        error = check_decimated(sys.argv[3], sys.argv[4], int(sys.argv[2]))
+    elif len(sys.argv) == 5 and sys.argv[1] == "same":
+        error = check_same(int(sys.argv[2]), sys.argv[3], sys.argv[4])
+    else:
+        print(__doc__)
+        sys.exit(2)
+
+    if error:
+        print(f"{sys.argv[3 if sys.argv[1] == 'morph' else 4]}: {error}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
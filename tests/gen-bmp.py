@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""Generates a synthetic 24-bit BMP (gradients + noise) for benchmarks and tests.
+
+Usage: gen-bmp.py <output.bmp> <width> <height> [--gray] [--8bit]
+
+--gray writes R = G = B pixels, --8bit the same gray image as an 8-bit BMP with a grayscale palette.
+"""
+
+import random
+import struct
+import sys
+
+PATTERN_ROWS = 64
+
+
+def make_row(width, seed, gray):
+    rnd = random.Random(seed)
+    row = bytearray(width * 3)
+    for x in range(width):
+        base = (x * 255) // max(width - 1, 1)
+        noise = rnd.randint(-24, 24)
+        if gray:
+            v = min(max(base + noise, 0), 255)
+            row[3 * x:3 * x + 3] = bytes((v, v, v))
+        else:
+            row[3 * x] = min(max(base + noise, 0), 255)
+            row[3 * x + 1] = min(max(255 - base + noise, 0), 255)
+            row[3 * x + 2] = (seed * 4 + x // 16) & 0xFF
+    return bytes(row)
+
+
+def main():
+    if len(sys.argv) < 4:
+        print(__doc__)
+        sys.exit(1)
+
+    path, width, height = sys.argv[1], int(sys.argv[2]), int(sys.argv[3])
+    indexed = "--8bit" in sys.argv[4:]
+    gray = indexed or "--gray" in sys.argv[4:]
+    bpp = 8 if indexed else 24
+    padding = (4 - (width * bpp // 8) % 4) % 4
+    image_size = (width * bpp // 8 + padding) * height
+    palette = b"".join(bytes((i, i, i, 0)) for i in range(256)) if indexed else b""
+    offset = 54 + len(palette)
+
+    # rows are taken from a small pattern set, so that huge images are generated fast
+    rows = [make_row(width, i, gray) for i in range(min(PATTERN_ROWS, height))]
+    # one palette index per pixel, the gray level itself
+    rows = [(row[::3] if indexed else row) + b"\0" * padding for row in rows]
+
+    with open(path, "wb") as f:
+        f.write(b"BM")
+        f.write(struct.pack("<IHHI", offset + image_size, 0, 0, offset))
+        f.write(struct.pack("<IiiHHIIiiII", 40, width, height, 1, bpp, 0, image_size, 0, 0, len(palette) // 4, 0))
+        f.write(palette)
+        for y in range(height):
+            f.write(rows[(y * 7) % len(rows)])
+
+
+if __name__ == "__main__":
+    main()
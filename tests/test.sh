@@ -8,12 +8,16 @@ BD="$BASEDIR"
 IMG_FOLDER="$BD/test-img/"
 
 TP_NUM=(2 3 8)
-MODES=("by_row" "by_column" "by_pixel" "by_grid")
+MODES=("by_row" "by_column" "by_pixel" "by_grid" "work_steal" "guided")
 MPI_MODES=("by_row" "by_column")
 FILTERS=("co" "gg" "bo")
 TEST_FILE="image5.bmp"
+GRAY_TEST_FILE="image5-gray.bmp" # generated, R = G = B
+GRAY8_TEST_FILE="image5-gray8.bmp" # generated, the same image as an 8-bit palettised BMP
 BLOCK_SIZE=("4" "128")
 VG_PREFIX=""
+EXTRA_ARGS=""
+VERIFY_CHECK="" # command verify_variant compares with instead of compare_results, called as: $VERIFY_CHECK <reference> <output>
 QMT_INPUT_FILES=("image1.bmp" "image2.bmp" "image3.bmp" "image4.bmp")
 RWW_COMBINATIONS=("1,1,1" "1,3,1" "2,3,2")
 
@@ -59,11 +63,95 @@ run_target() {
     local target=$1
     shift
     # Configure CMake with specific arguments
-    cmake -S "$BD" -B "$BD/build" "$@" 
+    # EXTRA_ARGS is a CMake list, so options separated by spaces become separate arguments
+    cmake -S "$BD" -B "$BD/build" -DEXTRA_ARGS="${EXTRA_ARGS// /;}" "$@"
     # Build the target
     cmake --build "$BD/build" --target "$target"
 }
 
+# === Helper to verify an option against a single-threaded reference ===
+# verify_variant <file> <filter> <block> <ref_extra> <test_extra> <threads> <modes...>
+# The reference is a single-threaded by_row run with <ref_extra> (seq_out_*), every mode is then run with each of
+# <threads> (space-separated, all > 1, rcon_out_*) and <test_extra> and compared with it (or checked by VERIFY_CHECK).
+verify_variant() {
+    local file=$1 fil=$2 bs=$3 ref_extra=$4 test_extra=$5 threads=$6
+    local mode th
+    shift 6
+
+    EXTRA_ARGS="$ref_extra"
+    run_target run \
+        -DINPUT_TF="$file" \
+        -DFILTER_TYPE="$fil" \
+        -DTHREAD_NUM=1 \
+        -DBLOCK_SIZE="$bs" \
+        -DCOMPUTE_MODE="by_row" \
+        -DLOG=0 \
+        -DOUTPUT_FILE=""
+
+    EXTRA_ARGS="$test_extra"
+    for mode in "$@"; do
+        for th in $threads; do
+            run_target run \
+                -DINPUT_TF="$file" \
+                -DFILTER_TYPE="$fil" \
+                -DTHREAD_NUM="$th" \
+                -DBLOCK_SIZE="$bs" \
+                -DCOMPUTE_MODE="$mode" \
+                -DLOG=0 \
+                -DOUTPUT_FILE=""
+            if [[ -n "$VERIFY_CHECK" ]]; then
+                $VERIFY_CHECK "${IMG_FOLDER}seq_out_${file}" "${IMG_FOLDER}rcon_out_${file}"
+                echo "✅ Check passed: $file ($mode, $th threads)"
+            else
+                compare_results "$file" "mt"
+            fi
+        done
+    done
+    EXTRA_ARGS=""
+}
+
+# === Helper to verify queue mode against multi-threaded references ===
+# verify_qmt_variant <filter> <mode> <block> <variant...>, a variant is "R,W,T" optionally followed by options
+# Every QMT_INPUT_FILES image is computed with 4 threads (rcon_out_*), then the batch is run in queue mode once per variant.
+verify_qmt_variant() {
+    local fil=$1 mode=$2 bs=$3
+    local file variant
+    shift 3
+
+    rm -f "${IMG_FOLDER}rcon_out_"*.bmp
+    EXTRA_ARGS=""
+    for file in "${QMT_INPUT_FILES[@]}"; do
+        run_target run \
+            -DINPUT_TF="$file" \
+            -DFILTER_TYPE="$fil" \
+            -DTHREAD_NUM=4 \
+            -DCOMPUTE_MODE="$mode" \
+            -DBLOCK_SIZE="$bs" \
+            -DLOG=0 \
+            -DOUTPUT_FILE=""
+    done
+
+    for variant in "$@"; do
+        EXTRA_ARGS=""
+        [[ "$variant" == *" "* ]] && EXTRA_ARGS="${variant#* }"
+        echo "QMT Test: mode=$mode filter=$fil block_size=$bs rww=${variant%% *} options=(${EXTRA_ARGS}) files=(${QMT_INPUT_FILES[*]})"
+
+        rm -f "${IMG_FOLDER}qmt_out_"*.bmp
+        run_target run-q-mode \
+            -DINPUT_TF="$(IFS=";"; echo "${QMT_INPUT_FILES[*]}")" \
+            -DFILTER_TYPE="$fil" \
+            -DCOMPUTE_MODE="$mode" \
+            -DBLOCK_SIZE="$bs" \
+            -DRWW_MIX="${variant%% *}" \
+            -DLOG=0
+
+        for file in "${QMT_INPUT_FILES[@]}"; do
+            compare_results "$file" "qmt"
+        done
+    done
+    EXTRA_ARGS=""
+}
+
 # === ST tests ===
 echo -e "\n=== Single-threaded verification tests ==="
 for fil in "${FILTERS[@]}"; do
@@ -118,48 +206,123 @@ for mode in "${MODES[@]}"; do
     done
 done
 
+# === Auto-tuning tests ===
+echo -e "\n=== Auto-tuning verification tests ==="
+rm -f "$BD/.bmp-conv-tune.dat"
+for fil in "${FILTERS[@]}"; do
+    # calibrates, then reuses the cached choice
+    verify_variant "$TEST_FILE" "$fil" 32 "" "" 3 auto auto
+done
+
+# === Tile order tests ===
+echo -e "\n=== Tile order verification tests ==="
+for fil in "${FILTERS[@]}"; do
+    for order in "morton" "hilbert"; do
+        verify_variant "$TEST_FILE" "$fil" 32 "" "--order=$order" 3 by_grid
+    done
+done
+
+# === Large image tests ===
+echo -e "\n=== Large image verification tests ==="
+LARGE_TEST_FILE="wide.bmp" # wider than 65535, with blocks over 255
+python3 "$SD/gen-bmp.py" "${IMG_FOLDER}${LARGE_TEST_FILE}" 70000 1000
+verify_variant "$LARGE_TEST_FILE" co 512 "" "" 3 by_row by_column by_grid
+rm -f "${IMG_FOLDER}${LARGE_TEST_FILE}" "${IMG_FOLDER}"*"_out_${LARGE_TEST_FILE}"
+
 # === QMT tests ===
 echo -e "\n=== Queue-mode verification tests ==="
 for mode in "${MODES[@]}"; do
     for fil in "${FILTERS[@]}"; do
         for bs in "${BLOCK_SIZE[@]}"; do
-            # Clean and regenerate reference (rcon_out_*) for this mode/filter/block
-            rm -f "${IMG_FOLDER}rcon_out_"*.bmp
-            # Run all input files first to produce reference outputs
-			for file in "${QMT_INPUT_FILES[@]}"; do
-				run_target run \
-					-DINPUT_TF="$file" \
-					-DFILTER_TYPE="$fil" \
-					-DTHREAD_NUM=4 \
-					-DCOMPUTE_MODE="$mode" \
-					-DBLOCK_SIZE="$bs" \
-					-DLOG=0 \
-					-DOUTPUT_FILE=""
-			done
-
-            # Run queue mode for all RWW combinations
-            for rww in "${RWW_COMBINATIONS[@]}"; do
-                input_files_cmake=$(IFS=";"; echo "${QMT_INPUT_FILES[*]}")
-                input_files_display=$(IFS=" "; echo "${QMT_INPUT_FILES[*]}")
-                echo "QMT Test: mode=$mode filter=$fil block_size=$bs rww=$rww files=(${input_files_display})"
-
-                rm -f "${IMG_FOLDER}qmt_out_"*.bmp
-                run_target run-q-mode \
-                    -DINPUT_TF="$input_files_cmake" \
-                    -DFILTER_TYPE="$fil" \
-                    -DCOMPUTE_MODE="$mode" \
-                    -DBLOCK_SIZE="$bs" \
-                    -DRWW_MIX="$rww" \
-                    -DLOG=0
-
-                for infile in "${QMT_INPUT_FILES[@]}"; do
-                    compare_results "$infile" "qmt"
-                done
-            done
+            verify_qmt_variant "$fil" "$mode" "$bs" "${RWW_COMBINATIONS[@]}"
         done
     done
 done
 
+# === QMT option tests ===
+echo -e "\n=== Queue-mode option verification tests ==="
+for fil in "${FILTERS[@]}"; do
+    # every image split / none split
+    verify_qmt_variant "$fil" by_grid 32 "1,3,1 --queue-split=0" "1,3,1 --queue-split=1000000000"
+    # a 1 ms interval moves threads while they are mid-image or waiting in a pop
+    verify_qmt_variant "$fil" by_row 16 "3,1,3 --rebalance=1" "1,1,1 --rebalance=1"
+    # 1 MB is below every image, so they go through the pipeline one at a time;
+    # with a queue of 1 the policy heap is full most of the time, so pushes wait for pops
+    verify_qmt_variant "$fil" by_row 16 "2,2,2 --queue-mem=1" "2,2,2 --queue-policy=sjf --queue-size=1" "2,2,2 --queue-policy=ljf --queue-size=1"
+done
+
+# === Engine tests ===
+echo -e "\n=== Engine verification tests ==="
+for fil in "${FILTERS[@]}"; do
+    verify_variant "$TEST_FILE" "$fil" 32 "" "--tile=1" 4 "${MODES[@]}"
+    verify_variant "$TEST_FILE" "$fil" 32 "" "--inplace=1" "${TP_NUM[*]}" "${MODES[@]}"
+done
+for fil in sh co; do
+    verify_variant "$TEST_FILE" "$fil" 32 "--winograd=0" "--winograd=1" 4 "${MODES[@]}"
+done
+
+# === Parametric filter tests ===
+echo -e "\n=== Parametric filter verification tests ==="
+for sigma in 1.5 25; do
+    verify_variant "$TEST_FILE" rg 32 "--sigma=$sigma" "--sigma=$sigma" "${TP_NUM[*]}" by_row
+done
+for sigma in 3 20; do
+    verify_variant "$TEST_FILE" pg 32 "--sigma=$sigma" "--sigma=$sigma" "${TP_NUM[*]}" by_row
+done
+for sigma in 4 16; do
+    verify_variant "$TEST_FILE" bl 32 "--sigma=$sigma --sigma-r=30" "--sigma=$sigma --sigma-r=30" 4 "${MODES[@]}"
+done
+
+# === Morphology tests ===
+echo -e "\n=== Morphology verification tests ==="
+MORPH_TEST_FILE="morph.bmp" # wider than two MORPH_STRIP_W column strips, small enough for the brute-force check
+python3 "$SD/gen-bmp.py" "${IMG_FOLDER}${MORPH_TEST_FILE}" 600 70
+for fil in di er op cl; do
+    for radius in 2 20; do
+        verify_variant "$MORPH_TEST_FILE" "$fil" 32 "--radius=$radius" "--radius=$radius" 4 "${MODES[@]}"
+        # the reference itself against a max/min over the whole window
+        python3 "$SD/bmp-check.py" morph "${IMG_FOLDER}${MORPH_TEST_FILE}" "${IMG_FOLDER}seq_out_${MORPH_TEST_FILE}" "$fil" "$radius"
+        echo "✅ Brute-force window matches: $MORPH_TEST_FILE ($fil, radius $radius)"
+    done
+done
+rm -f "${IMG_FOLDER}${MORPH_TEST_FILE}" "${IMG_FOLDER}"*"_out_${MORPH_TEST_FILE}"
+
+# === Decimation tests ===
+echo -e "\n=== Decimated output verification tests ==="
+# a full-resolution pass, point-sampled, must give the decimated output (decimate.h)
+for step in 2 4 8; do
+    VERIFY_CHECK="python3 $SD/bmp-check.py decimated $step"
+    for fil in "${FILTERS[@]}" "mm"; do
+        verify_variant "$TEST_FILE" "$fil" 32 "" "--decimate=$step" 4 "${MODES[@]}"
+    done
+done
+VERIFY_CHECK=""
+
+# === Uniform skip tests ===
+echo -e "\n=== Uniform-region skip verification tests ==="
+for fil in "${FILTERS[@]}" "mm"; do
+    verify_variant "$TEST_FILE" "$fil" 32 "" "--uniform-skip=1" 4 "${MODES[@]}"
+done
+
+# === Grayscale tests ===
+echo -e "\n=== Grayscale fast path verification tests ==="
+python3 "$SD/gen-bmp.py" "${IMG_FOLDER}${GRAY_TEST_FILE}" 640 400 --gray
+python3 "$SD/gen-bmp.py" "${IMG_FOLDER}${GRAY8_TEST_FILE}" 640 400 --8bit
+
+# both outputs of the 8-bit input must be 8-bit files with the pixels of the 24-bit input's result
+check_gray8_outputs() {
+    python3 "$SD/bmp-check.py" same 8 "${IMG_FOLDER}seq_out_${GRAY_TEST_FILE}" "$1"
+    python3 "$SD/bmp-check.py" same 8 "${IMG_FOLDER}seq_out_${GRAY_TEST_FILE}" "$2"
+}
+
+for fil in "${FILTERS[@]}" "mm"; do
+    verify_variant "$GRAY_TEST_FILE" "$fil" 32 "--gray=0" "--gray=1" 4 "${MODES[@]}"
+    VERIFY_CHECK="check_gray8_outputs"
+    verify_variant "$GRAY8_TEST_FILE" "$fil" 32 "--gray=0" "--gray=1" 4 "${MODES[@]}"
+    VERIFY_CHECK=""
+done
+rm -f "${IMG_FOLDER}"*"${GRAY_TEST_FILE}" "${IMG_FOLDER}"*"${GRAY8_TEST_FILE}"
+
 # === MPI tests ===
 echo -e "\n=== MPI-mode verification tests ==="
 for mode in "${MPI_MODES[@]}"; do
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Compares the cache-blocked (--tile=1) convolution engine against the default row-major traversal on 8K-wide images.
+
+SD=$(dirname "$(realpath "$0")")
+BASEDIR=$(dirname "$SD")
+BD="$BASEDIR"
+BUILD_DIR="${BUILD_DIR:-$BD/build}"
+
+CPU_LOG_FILE="$SD/logs/cpu-timing-results.dat"
+LOG_FILE="$SD/logs/tile-timing-results.dat"
+RUN_NUM=3
+HEADER="Engine RunID ProcessNum Backend Mode Filter ThreadNum ComputeMode BlockSize Result"
+
+IMG_WIDTH=7680
+IMG_HEIGHT=4320
+TEST_FILE="image-8k.bmp"
+FILTERS=(sh gb mg gg bo)
+THREADNUM=(1 4)
+MODES=("by_row" "by_grid")
+BLOCK_SIZE=64
+
+if [[ ! -f "$BUILD_DIR/CMakeCache.txt" ]]; then
+    cmake -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release
+fi
+cmake --build "$BUILD_DIR"
+
+BIN="$BUILD_DIR/bmp-conv"
+if [[ ! -x "$BIN" ]]; then
+    echo "Error: executable not found: $BIN"
+    exit 1
+fi
+
+cd "$BD" || exit 1
+mkdir -p "$SD/logs"
+
+if [[ ! -f "test-img/$TEST_FILE" ]]; then
+    echo "Generating ${IMG_WIDTH}x${IMG_HEIGHT} test image"
+    python3 "$SD/gen-bmp.py" "test-img/$TEST_FILE" "$IMG_WIDTH" "$IMG_HEIGHT"
+fi
+
+echo "$HEADER" > "$LOG_FILE"
+
+for fil in "${FILTERS[@]}"; do
+	for th in "${THREADNUM[@]}"; do
+		for mode in "${MODES[@]}"; do
+			for tile in 0 1; do
+				engine=$([[ "$tile" == 1 ]] && echo "tiled" || echo "direct")
+				for i in $(seq 1 "$RUN_NUM"); do
+					"$BIN" -cpu "$TEST_FILE" --filter="$fil" --threadnum="$th" --block="$BLOCK_SIZE" --mode="$mode" --tile="$tile" --log=1 > /dev/null
+					echo "$engine $i 1 $(tail -n 1 "$CPU_LOG_FILE")" >> "$LOG_FILE"
+				done
+			done
+		done
+	done
+done
+
+echo -e "\nAverage time (s):"
+awk 'NR > 1 { key = $6 " " $7 " " $8 " " $1; sum[key] += $10; cnt[key]++ }
+     END { for (k in sum) printf "%-30s %.4f\n", k, sum[k] / cnt[k] }' "$LOG_FILE" | sort